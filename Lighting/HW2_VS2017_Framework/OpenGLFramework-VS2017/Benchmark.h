@@ -0,0 +1,50 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// frames rendered before the measured ones of each model, so shader compilation,
+// buffer uploads and cold caches do not show up in the statistics
+constexpr int BENCHMARK_WARMUP_FRAMES = 10;
+
+// frame times of one model
+struct BenchmarkResult
+{
+    std::string model;
+    std::vector<double> cpu_ms; // wall clock time of every frame, presenting included
+    std::vector<double> gpu_ms; // GL_TIME_ELAPSED of every frame
+};
+
+// Measures the CPU and GPU time of consecutive frames. The GPU times are only read back by finish(),
+// so measuring never waits for the GPU on its own.
+class FrameTimer
+{
+public:
+    FrameTimer() = default;
+    ~FrameTimer();
+    FrameTimer(const FrameTimer &) = delete;
+    FrameTimer &operator=(const FrameTimer &) = delete;
+
+    // GL thread, around the rendering and presenting of one frame
+    void begin();
+    void end();
+
+    // wait for the queries of the frames since the last finish() and move their times into result
+    void finish(BenchmarkResult &result);
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    std::vector<double> cpu_ms_;
+    std::vector<GLuint> queries_; // one per frame, reused by the next finish()
+    size_t frame_ = 0;
+};
+
+// Writes min, median and p99 of the CPU and GPU frame times of every model as JSON to path
+// and prints them. Returns false if the file cannot be written.
+bool WriteBenchmarkReport(const std::string &path, const std::string &app, int frames, const std::vector<BenchmarkResult> &results);
+
+#endif
@@ -0,0 +1,155 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr float PI_F = 3.14159265358979323846f;
+
+// squared distance of v to the interval [lo, hi]
+static inline float IntervalDistance2(float v, float lo, float hi)
+{
+    float d = v < lo ? lo - v : (v > hi ? v - hi : 0.0f);
+    return d * d;
+}
+
+LightClusters::LightClusters(unsigned int thread_count) : pool_(thread_count)
+{
+    grid_.resize(size_t(CLUSTER_X) * CLUSTER_Y * CLUSTER_Z * 2);
+    slice_indices_.resize(CLUSTER_Z);
+}
+
+void LightClusters::parallel(int jobs, const std::function<void(int)> &job)
+{
+    for (int i = 0; i < jobs; i++)
+    {
+        pool_.enqueue([this, &job, i]() {
+            job(i);
+            done_.push(i);
+        });
+    }
+    for (int i = 0; i < jobs; i++)
+        done_.pop();
+}
+
+void LightClusters::build(const LightListBlock &block, const Matrix4 &view, const ClusterFrustum &frustum)
+{
+    // the lights as view space spheres, the depth counted positive in front of the camera
+    light_count_ = std::min(std::max(block.lightCount, 0), MAX_LIGHTS);
+    lights_.resize(size_t(light_count_) * 4);
+    for (int i = 0; i < light_count_; i++)
+    {
+        const LightSourceBlock &light = block.lights[i];
+        Vector4 v = view * Vector4(light.position[0], light.position[1], light.position[2], 1.0f);
+        lights_[i * 4 + 0] = v.x;
+        lights_[i * 4 + 1] = v.y;
+        lights_[i * 4 + 2] = -v.z;
+        lights_[i * 4 + 3] = light.range;
+    }
+
+    float depth_range = logf(frustum.farClip / frustum.nearClip);
+    slice_scale_ = CLUSTER_Z / depth_range;
+    slice_bias_ = -CLUSTER_Z * logf(frustum.nearClip) / depth_range;
+
+    int jobs = std::min(static_cast<int>(pool_.size()), CLUSTER_Z);
+    parallel(jobs, [&](int job) {
+        for (int slice = CLUSTER_Z * job / jobs; slice < CLUSTER_Z * (job + 1) / jobs; slice++)
+            buildSlice(slice, frustum);
+    });
+
+    // the slices one after the other, offsets made absolute
+    indices_.clear();
+    for (int slice = 0; slice < CLUSTER_Z; slice++)
+    {
+        GLuint base = static_cast<GLuint>(indices_.size());
+        size_t first = size_t(slice) * CLUSTER_X * CLUSTER_Y;
+        for (size_t cluster = first; cluster < first + CLUSTER_X * CLUSTER_Y; cluster++)
+            grid_[cluster * 2] += base;
+        indices_.insert(indices_.end(), slice_indices_[slice].begin(), slice_indices_[slice].end());
+    }
+}
+
+void LightClusters::buildSlice(int slice, const ClusterFrustum &frustum)
+{
+    float ratio = frustum.farClip / frustum.nearClip;
+    float d0 = frustum.nearClip * powf(ratio, float(slice) / CLUSTER_Z);
+    float d1 = frustum.nearClip * powf(ratio, float(slice + 1) / CLUSTER_Z);
+    float tan_y = tanf(frustum.fovy * PI_F / 360.0f);
+    float tan_x = tan_y * frustum.aspect;
+
+    // lights reaching the depth range of the slice
+    std::vector<int> slice_lights;
+    for (int i = 0; i < light_count_; i++)
+    {
+        float depth = lights_[i * 4 + 2], range = lights_[i * 4 + 3];
+        if (depth + range >= d0 && depth - range <= d1)
+            slice_lights.push_back(i);
+    }
+
+    std::vector<GLubyte> &indices = slice_indices_[slice];
+    indices.clear();
+    std::vector<int> row_lights;
+    for (int y = 0; y < CLUSTER_Y; y++)
+    {
+        // view space bounding box of the row, from the tile edges at both ends of the slice
+        float e0 = (-1.0f + 2.0f * y / CLUSTER_Y) * tan_y;
+        float e1 = (-1.0f + 2.0f * (y + 1) / CLUSTER_Y) * tan_y;
+        float lo_y = std::min(e0 * d0, e0 * d1), hi_y = std::max(e1 * d0, e1 * d1);
+
+        row_lights.clear();
+        for (int i : slice_lights)
+        {
+            const float *l = &lights_[i * 4];
+            if (IntervalDistance2(l[1], lo_y, hi_y) + IntervalDistance2(l[2], d0, d1) <= l[3] * l[3])
+                row_lights.push_back(i);
+        }
+
+        for (int x = 0; x < CLUSTER_X; x++)
+        {
+            float f0 = (-1.0f + 2.0f * x / CLUSTER_X) * tan_x;
+            float f1 = (-1.0f + 2.0f * (x + 1) / CLUSTER_X) * tan_x;
+            float lo_x = std::min(f0 * d0, f0 * d1), hi_x = std::max(f1 * d0, f1 * d1);
+
+            size_t cluster = (size_t(slice) * CLUSTER_Y + y) * CLUSTER_X + x;
+            size_t offset = indices.size();
+            for (int i : row_lights)
+            {
+                const float *l = &lights_[i * 4];
+                float d2 = IntervalDistance2(l[0], lo_x, hi_x) + IntervalDistance2(l[1], lo_y, hi_y) + IntervalDistance2(l[2], d0, d1);
+                if (d2 <= l[3] * l[3])
+                    indices.push_back(static_cast<GLubyte>(i));
+            }
+            grid_[cluster * 2 + 0] = static_cast<GLuint>(offset);
+            grid_[cluster * 2 + 1] = static_cast<GLuint>(indices.size() - offset);
+        }
+    }
+}
+
+void LightClusters::upload(GLuint grid_unit, GLuint indices_unit)
+{
+    if (buffers_[0] == 0)
+    {
+        glGenBuffers(2, buffers_);
+        glGenTextures(2, textures_);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers_[0]);
+        glBufferData(GL_TEXTURE_BUFFER, grid_.size() * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers_[1]);
+        glBufferData(GL_TEXTURE_BUFFER, 1, NULL, GL_STREAM_DRAW);
+
+        glBindTexture(GL_TEXTURE_BUFFER, textures_[0]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, buffers_[0]);
+        glBindTexture(GL_TEXTURE_BUFFER, textures_[1]);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, buffers_[1]);
+    }
+
+    // orphan the storage of the last frame instead of waiting for the draws still reading it
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers_[0]);
+    glBufferData(GL_TEXTURE_BUFFER, grid_.size() * sizeof(GLuint), grid_.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers_[1]);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices_.size(), 1), indices_.empty() ? NULL : indices_.data(), GL_STREAM_DRAW);
+
+    glActiveTexture(GL_TEXTURE0 + grid_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, textures_[0]);
+    glActiveTexture(GL_TEXTURE0 + indices_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, textures_[1]);
+    glActiveTexture(GL_TEXTURE0);
+}
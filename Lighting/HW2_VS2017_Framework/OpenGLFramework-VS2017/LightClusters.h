@@ -0,0 +1,81 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <functional>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "LightList.h"
+#include "Matrices.h"
+#include "ThreadPool.h"
+
+// Clustered forward lighting for the per pixel light list. The view frustum is cut into
+// CLUSTER_X x CLUSTER_Y tiles on screen and CLUSTER_Z slices in depth, spaced exponentially
+// between the near and far plane, and every cluster keeps the lights whose range reaches it.
+// A fragment then only loops over the list of its own cluster.
+//
+// The lists are built on the CPU, one job per group of depth slices on a thread pool, and
+// uploaded into two buffer textures, since GL 3.3 has no storage buffers:
+//     grid     GL_RG32UI, offset into the indices and light count of every cluster
+//     indices  GL_R8UI, indices into the lights of the LightListBlock
+// with the cluster of tile (x, y) in slice z at (z * CLUSTER_Y + y) * CLUSTER_X + x.
+
+constexpr int CLUSTER_X = 16;
+constexpr int CLUSTER_Y = 16;
+constexpr int CLUSTER_Z = 24;
+
+// view frustum the clusters are cut from, of a perspective projection
+struct ClusterFrustum
+{
+    float fovy;   // degrees
+    float aspect; // of the viewport the clusters cover
+    float nearClip;
+    float farClip;
+};
+
+class LightClusters
+{
+public:
+    // thread_count = 0 uses one worker per hardware thread
+    explicit LightClusters(unsigned int thread_count = 0);
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    // assign the lightCount lights of block, in world space, to the clusters of a camera with the view matrix view
+    void build(const LightListBlock &block, const Matrix4 &view, const ClusterFrustum &frustum);
+
+    // upload the lists of the last build and bind the grid and index textures to these texture units, GL thread
+    void upload(GLuint grid_unit, GLuint indices_unit);
+
+    // log(view depth) * scale + bias is the depth slice, for the shaders
+    float sliceScale() const { return slice_scale_; }
+    float sliceBias() const { return slice_bias_; }
+
+    // light indices of all clusters, the size of the last build
+    size_t indexCount() const { return indices_.size(); }
+
+private:
+    // runs job(0 .. jobs - 1) on the pool and waits for all of them
+    void parallel(int jobs, const std::function<void(int)> &job);
+    void buildSlice(int slice, const ClusterFrustum &frustum);
+
+    ThreadPool pool_;
+    BlockingQueue<int> done_;
+
+    // view space lights of the current build: x, y, depth along the view direction, range
+    std::vector<float> lights_;
+    int light_count_ = 0;
+
+    std::vector<GLuint> grid_;                        // offset and count of every cluster
+    std::vector<std::vector<GLubyte>> slice_indices_; // light indices of every slice, offsets relative to the slice
+    std::vector<GLubyte> indices_;
+    float slice_scale_ = 0;
+    float slice_bias_ = 0;
+
+    // grid and indices, created by the first upload and kept as long as the context
+    GLuint buffers_[2] = {0, 0};
+    GLuint textures_[2] = {0, 0};
+};
+
+#endif
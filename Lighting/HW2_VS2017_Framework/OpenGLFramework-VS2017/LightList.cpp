@@ -0,0 +1,112 @@
+#include "LightList.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+static constexpr float PI_F = 3.14159265358979323846f;
+
+float LightRange(const SceneLight &light)
+{
+    // solve constant + linear * d + quadratic * d^2 = 256 * intensity, the shaders use 1 / attenuation
+    float intensity = std::max(light.color.x, std::max(light.color.y, light.color.z));
+    float c = light.attenuationConstant - 256.0f * intensity;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.attenuationQuadratic > 0.0f)
+    {
+        float l = light.attenuationLinear, q = light.attenuationQuadratic;
+        return (-l + sqrtf(l * l - 4.0f * q * c)) / (2.0f * q);
+    }
+    if (light.attenuationLinear > 0.0f)
+        return -c / light.attenuationLinear;
+    return FLT_MAX;
+}
+
+std::vector<SceneLight> GenerateLights(int count, float extent)
+{
+    std::mt19937 rng(2021);
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> channel(0.5f, 1.0f);
+    std::uniform_real_distribution<float> reach(0.15f, 0.3f);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> cutoff(20.0f, 45.0f);
+
+    std::vector<SceneLight> lights(count);
+    for (int i = 0; i < count; i++)
+    {
+        SceneLight &light = lights[i];
+        light.position = Vector3(position(rng), position(rng), position(rng));
+        light.color = Vector3(channel(rng), channel(rng), channel(rng));
+
+        // at half brightness after reach
+        float r = reach(rng);
+        light.attenuationConstant = 1.0f;
+        light.attenuationLinear = 0.0f;
+        light.attenuationQuadratic = 1.0f / (r * r);
+
+        light.spotDirection = Vector3(jitter(rng), jitter(rng), jitter(rng)) - light.position;
+        light.spotDirection.normalize();
+        light.spotExponent = 8.0f;
+        light.spotCutoff = (i % 3 == 2) ? cutoff(rng) : 180.0f;
+        light.range = LightRange(light);
+    }
+    return lights;
+}
+
+// sphere against the cone of a spot light, closed at range (Wronski, "Cull that cone!")
+static bool SpotReaches(const SceneLight &light, const Vector3 &center, float radius)
+{
+    float angle = light.spotCutoff * PI_F / 180.0f;
+    Vector3 v = center - light.position;
+    float along = v.dot(light.spotDirection);
+    float across = sqrtf(std::max(v.dot(v) - along * along, 0.0f));
+    float distance = cosf(angle) * across - sinf(angle) * along;
+    return distance <= radius && along <= light.range + radius && along >= -radius;
+}
+
+int CullLights(const std::vector<SceneLight> &lights, const Vector3 &center, float radius, LightListBlock &block,
+               int *reaching)
+{
+    int n = 0, found = 0;
+    for (const auto &light : lights)
+    {
+        if (n == MAX_LIGHTS && reaching == nullptr)
+            break;
+
+        Vector3 v = center - light.position;
+        float reach = light.range + radius;
+        if (v.dot(v) > reach * reach)
+            continue;
+
+        bool spot = light.spotCutoff < 90.0f;
+        if (spot && !SpotReaches(light, center, radius))
+            continue;
+
+        // only counted once the block is full
+        if (found++ >= MAX_LIGHTS)
+            continue;
+
+        LightSourceBlock &dst = block.lights[n++];
+        dst.position[0] = light.position.x;
+        dst.position[1] = light.position.y;
+        dst.position[2] = light.position.z;
+        dst.color[0] = light.color.x;
+        dst.color[1] = light.color.y;
+        dst.color[2] = light.color.z;
+        dst.spotDirection[0] = light.spotDirection.x;
+        dst.spotDirection[1] = light.spotDirection.y;
+        dst.spotDirection[2] = light.spotDirection.z;
+        dst.attenuationConstant = light.attenuationConstant;
+        dst.attenuationLinear = light.attenuationLinear;
+        dst.attenuationQuadratic = light.attenuationQuadratic;
+        dst.spotCosCutoff = spot ? cosf(light.spotCutoff * PI_F / 180.0f) : -1.0f;
+        dst.spotExponent = light.spotExponent;
+        dst.range = light.range;
+    }
+    block.lightCount = n;
+    if (reaching != nullptr)
+        *reaching = found;
+    return n;
+}
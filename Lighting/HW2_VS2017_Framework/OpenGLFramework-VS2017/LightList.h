@@ -0,0 +1,69 @@
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Vectors.h"
+
+// Many point and spot lights for the light list mode of shader.vs / shader.fs. The lights reaching
+// a model are picked on the CPU by testing their range against its bounding sphere, so the shaders
+// only loop over those, with the count in the block.
+
+// 16 bytes of header and 64 per light fit the 16KB every GL 3.3 driver offers a uniform block
+constexpr int MAX_LIGHTS = 255;
+
+// std140 mirror of LightSource in the shaders
+struct LightSourceBlock
+{
+    GLfloat position[3];
+    GLfloat attenuationConstant;
+    GLfloat color[3];
+    GLfloat attenuationLinear;
+    GLfloat spotDirection[3];
+    GLfloat attenuationQuadratic;
+    GLfloat spotCosCutoff; // -1 for a point light
+    GLfloat spotExponent;
+    GLfloat range; // of the SceneLight, for the light clusters
+    GLfloat pad;
+};
+
+// std140 mirror of the LightList uniform block, only the first lightCount lights are uploaded
+struct LightListBlock
+{
+    GLfloat ambient[3];
+    GLint lightCount;
+    LightSourceBlock lights[MAX_LIGHTS];
+};
+
+static_assert(sizeof(LightSourceBlock) == 64 && sizeof(LightListBlock) == 16 + 64 * MAX_LIGHTS, "std140 layout");
+
+// a point light, or a spot light when spotCutoff is below 90 degrees
+struct SceneLight
+{
+    Vector3 position;
+    Vector3 color; // diffuse and specular
+    GLfloat attenuationConstant;
+    GLfloat attenuationLinear;
+    GLfloat attenuationQuadratic;
+    Vector3 spotDirection; // normalized
+    GLfloat spotExponent;
+    GLfloat spotCutoff; // degrees
+    GLfloat range;      // set by LightRange()
+};
+
+// distance beyond which the attenuated light adds less than 1/256 to any channel, FLT_MAX if it never fades
+float LightRange(const SceneLight &light);
+
+// count lights spread over the cube [-extent, extent]^3, every third a spot light pointing at the origin.
+// The sequence is the same on every call, so fewer lights are the first ones of more.
+std::vector<SceneLight> GenerateLights(int count, float extent);
+
+// Writes the lights reaching the sphere (center, radius) into block and sets its lightCount,
+// the first MAX_LIGHTS of them if there are more. Returns the count, and in reaching, if given,
+// the number of lights reaching the sphere, which is larger when the list was truncated.
+int CullLights(const std::vector<SceneLight> &lights, const Vector3 &center, float radius, LightListBlock &block,
+               int *reaching = nullptr);
+
+#endif
@@ -20,6 +20,17 @@
 #include <algorithm>
 #include "Matrices.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MATRIX_TARGET_AVX
+#else
+#define MATRIX_TARGET_AVX __attribute__((target("avx")))
+#endif
+#define MATH_MATRICES_AVX
+#endif
+
 const float DEG2RAD = 3.141593f / 180;
 
 
@@ -544,3 +555,134 @@ Matrix4& Matrix4::rotateZ(float angle)
 
     return *this;
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// kernels of Matrix4::transformPoints(), m is row major
+// All of them add the columns in the order of operator*(Vector4), so every
+// kernel gives the same result.
+///////////////////////////////////////////////////////////////////////////////
+typedef void (*TransformPointsKernel)(const float* m, const float* in, float* out, size_t count);
+
+#if !defined(MATH_MATRICES_SSE) && !defined(MATH_MATRICES_NEON)
+static void transformPointsScalar(const float* m, const float* in, float* out, size_t count)
+{
+    for(size_t i = 0; i < count; ++i, in += 3, out += 4)
+    {
+        out[0] = m[0]*in[0]  + m[1]*in[1]  + m[2]*in[2]  + m[3];
+        out[1] = m[4]*in[0]  + m[5]*in[1]  + m[6]*in[2]  + m[7];
+        out[2] = m[8]*in[0]  + m[9]*in[1]  + m[10]*in[2] + m[11];
+        out[3] = m[12]*in[0] + m[13]*in[1] + m[14]*in[2] + m[15];
+    }
+}
+#endif
+
+#if defined(MATH_MATRICES_SSE)
+static void transformPointsSSE(const float* m, const float* in, float* out, size_t count)
+{
+    __m128 c0 = _mm_loadu_ps(&m[0]);
+    __m128 c1 = _mm_loadu_ps(&m[4]);
+    __m128 c2 = _mm_loadu_ps(&m[8]);
+    __m128 c3 = _mm_loadu_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    for(size_t i = 0; i < count; ++i, in += 3, out += 4)
+    {
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(in[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[2])));
+        _mm_storeu_ps(out, _mm_add_ps(r, c3));
+    }
+}
+#endif
+
+#if defined(MATH_MATRICES_AVX)
+// two points per iteration, one in each 128-bit half
+MATRIX_TARGET_AVX static void transformPointsAVX(const float* m, const float* in, float* out, size_t count)
+{
+    __m128 c0 = _mm_loadu_ps(&m[0]);
+    __m128 c1 = _mm_loadu_ps(&m[4]);
+    __m128 c2 = _mm_loadu_ps(&m[8]);
+    __m128 c3 = _mm_loadu_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m256 cc0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c0, 1);
+    __m256 cc1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c1), c1, 1);
+    __m256 cc2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c2), c2, 1);
+    __m256 cc3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c3), c3, 1);
+
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2, in += 6, out += 8)
+    {
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[0])), _mm_set1_ps(in[3]), 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[1])), _mm_set1_ps(in[4]), 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[2])), _mm_set1_ps(in[5]), 1);
+        __m256 r = _mm256_mul_ps(cc0, x);
+        r = _mm256_add_ps(r, _mm256_mul_ps(cc1, y));
+        r = _mm256_add_ps(r, _mm256_mul_ps(cc2, z));
+        _mm256_storeu_ps(out, _mm256_add_ps(r, cc3));
+    }
+    if(i < count)
+    {
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(in[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[2])));
+        _mm_storeu_ps(out, _mm_add_ps(r, c3));
+    }
+}
+
+static bool cpuHasAVX()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // the OS must save the YMM registers too
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+#if defined(MATH_MATRICES_NEON)
+static void transformPointsNEON(const float* m, const float* in, float* out, size_t count)
+{
+    float32x4x4_t c = vld4q_f32(m);
+    for(size_t i = 0; i < count; ++i, in += 3, out += 4)
+    {
+        float32x4_t r = vmulq_n_f32(c.val[0], in[0]);
+        r = vmlaq_n_f32(r, c.val[1], in[1]);
+        r = vmlaq_n_f32(r, c.val[2], in[2]);
+        vst1q_f32(out, vaddq_f32(r, c.val[3]));
+    }
+}
+#endif
+
+static TransformPointsKernel selectTransformPoints()
+{
+#if defined(MATH_MATRICES_AVX)
+    if(cpuHasAVX())
+        return transformPointsAVX;
+#endif
+#if defined(MATH_MATRICES_SSE)
+    return transformPointsSSE;
+#elif defined(MATH_MATRICES_NEON)
+    return transformPointsNEON;
+#else
+    return transformPointsScalar;
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// transform count points (x, y, z) to M * (x, y, z, 1)
+// in holds 3 floats per point and out 4 floats per point, they must not overlap.
+///////////////////////////////////////////////////////////////////////////////
+void Matrix4::transformPoints(const float* in, float* out, size_t count) const
+{
+    static const TransformPointsKernel kernel = selectTransformPoints();
+    kernel(m, in, out, count);
+}
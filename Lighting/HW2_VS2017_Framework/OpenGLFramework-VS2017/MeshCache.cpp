@@ -0,0 +1,340 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const unsigned char *>(view);
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(mapping_);
+    if (file_ != nullptr)
+        CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+#else
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    data_ = static_cast<const unsigned char *>(view);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<unsigned char *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
+
+uint64_t HashBytes(const unsigned char *data, size_t size, uint64_t seed)
+{
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool HashFileContent(const std::string &path, uint64_t *hash)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    *hash = HashBytes(file.data(), file.size());
+    return true;
+}
+
+bool HashModelContent(const std::string &obj_path, uint64_t *hash)
+{
+    MappedFile obj;
+    if (!obj.open(obj_path))
+        return false;
+    uint64_t h = HashBytes(obj.data(), obj.size());
+
+    size_t slash = obj_path.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? std::string() : obj_path.substr(0, slash + 1);
+
+    // the materials are cached with the shapes, so an edited .mtl has to invalidate the cache as well
+    const char *p = reinterpret_cast<const char *>(obj.data());
+    const char *end = p + obj.size();
+    while (p < end)
+    {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (eol == nullptr)
+            eol = end;
+        while (p < eol && (*p == ' ' || *p == '\t'))
+            p++;
+        if (eol - p > 7 && strncmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t'))
+        {
+            // one or more file names, separated by spaces
+            for (p += 7; p < eol;)
+            {
+                const char *name = p;
+                while (p < eol && *p != ' ' && *p != '\t' && *p != '\r')
+                    p++;
+                if (p > name)
+                {
+                    MappedFile mtl;
+                    if (mtl.open(dir + std::string(name, p)))
+                        h = HashBytes(mtl.data(), mtl.size(), h);
+                }
+                while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+                    p++;
+            }
+        }
+        p = eol + 1;
+    }
+
+    *hash = h;
+    return true;
+}
+
+static size_t Align4(size_t n)
+{
+    return (n + 3) & ~size_t(3);
+}
+
+// bounds-checked sequential reads over the mapped cache
+struct CacheCursor
+{
+    const unsigned char *p;
+    const unsigned char *end;
+
+    bool read(void *dst, size_t n)
+    {
+        if (static_cast<size_t>(end - p) < n)
+            return false;
+        memcpy(dst, p, n);
+        p += n;
+        return true;
+    }
+
+    bool skip(size_t n)
+    {
+        if (static_cast<size_t>(end - p) < n)
+            return false;
+        p += n;
+        return true;
+    }
+};
+
+bool MeshCacheReader::open(const std::string &cache_path, uint64_t source_hash)
+{
+    materials_.clear();
+    shapes_.clear();
+    if (!file_.open(cache_path))
+        return false;
+
+    if (!parse(source_hash))
+    {
+        // stale or corrupt cache, release the mapping so the cache can be rewritten
+        file_.close();
+        materials_.clear();
+        shapes_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCacheReader::parse(uint64_t source_hash)
+{
+    CacheCursor in{file_.data(), file_.data() + file_.size()};
+    uint32_t magic = 0, version = 0, material_count = 0, shape_count = 0;
+    uint64_t hash = 0;
+    if (!in.read(&magic, 4) || !in.read(&version, 4) || !in.read(&hash, 8) ||
+        !in.read(&material_count, 4) || !in.read(&shape_count, 4))
+        return false;
+    if (magic != MESH_CACHE_MAGIC || version != MESH_CACHE_VERSION || hash != source_hash)
+        return false;
+
+    materials_.resize(material_count);
+    for (auto &material : materials_)
+    {
+        uint32_t name_length = 0;
+        if (!in.read(material.ambient, sizeof(material.ambient)) ||
+            !in.read(material.diffuse, sizeof(material.diffuse)) ||
+            !in.read(material.specular, sizeof(material.specular)) ||
+            !in.read(&name_length, 4))
+            return false;
+        const char *name = reinterpret_cast<const char *>(in.p);
+        if (!in.skip(Align4(name_length)))
+            return false;
+        material.diffuse_texname.assign(name, name_length);
+    }
+
+    shapes_.resize(shape_count);
+    for (auto &shape : shapes_)
+    {
+        int32_t material_id = 0;
+        if (!in.read(&material_id, 4) || !in.read(shape.length, sizeof(shape.length)) ||
+            !in.read(&shape.index_count, 4))
+            return false;
+        shape.material_id = material_id;
+    }
+
+    // streams are referenced in place, the mapping stays alive with the reader
+    for (auto &shape : shapes_)
+    {
+        for (int s = 0; s < MESH_STREAM_COUNT; s++)
+        {
+            shape.stream[s] = shape.length[s] ? reinterpret_cast<const float *>(in.p) : nullptr;
+            if (!in.skip(size_t(shape.length[s]) * sizeof(float)))
+                return false;
+        }
+        shape.indices = reinterpret_cast<const uint32_t *>(in.p);
+        if (!in.skip(size_t(shape.index_count) * sizeof(uint32_t)))
+            return false;
+    }
+    return true;
+}
+
+static void Append(std::vector<unsigned char> &out, const void *src, size_t n)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(src);
+    out.insert(out.end(), p, p + n);
+}
+
+bool WriteMeshCache(const std::string &cache_path, uint64_t source_hash,
+                    const std::vector<CachedMaterial> &materials, const std::vector<CachedShape> &shapes)
+{
+    std::vector<unsigned char> header;
+    uint32_t magic = MESH_CACHE_MAGIC, version = MESH_CACHE_VERSION;
+    uint32_t material_count = static_cast<uint32_t>(materials.size());
+    uint32_t shape_count = static_cast<uint32_t>(shapes.size());
+    Append(header, &magic, 4);
+    Append(header, &version, 4);
+    Append(header, &source_hash, 8);
+    Append(header, &material_count, 4);
+    Append(header, &shape_count, 4);
+
+    for (const auto &material : materials)
+    {
+        uint32_t name_length = static_cast<uint32_t>(material.diffuse_texname.size());
+        Append(header, material.ambient, sizeof(material.ambient));
+        Append(header, material.diffuse, sizeof(material.diffuse));
+        Append(header, material.specular, sizeof(material.specular));
+        Append(header, &name_length, 4);
+        Append(header, material.diffuse_texname.data(), name_length);
+        header.resize(Align4(header.size()), 0);
+    }
+
+    for (const auto &shape : shapes)
+    {
+        int32_t material_id = shape.material_id;
+        Append(header, &material_id, 4);
+        Append(header, shape.length, sizeof(shape.length));
+        Append(header, &shape.index_count, 4);
+    }
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string tmp_path = cache_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (fp == NULL)
+        return false;
+
+    bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+    for (const auto &shape : shapes)
+    {
+        for (int s = 0; s < MESH_STREAM_COUNT && ok; s++)
+        {
+            if (shape.length[s] > 0)
+                ok = fwrite(shape.stream[s], sizeof(float), shape.length[s], fp) == shape.length[s];
+        }
+        if (shape.index_count > 0 && ok)
+            ok = fwrite(shape.indices, sizeof(uint32_t), shape.index_count, fp) == shape.index_count;
+    }
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok)
+    {
+        remove(cache_path.c_str());
+        ok = rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+    }
+    if (!ok)
+        remove(tmp_path.c_str());
+    return ok;
+}
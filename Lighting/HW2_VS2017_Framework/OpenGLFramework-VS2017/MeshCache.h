@@ -0,0 +1,111 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary cache of the normalized, material-split and welded vertex streams built from an .obj file.
+// A cache file lives next to its model ("<model>.meshcache") and is only used when the
+// hash stored in its header matches the current content of the source .obj file and its .mtl files.
+//
+// Layout (all fields are 4-byte aligned, native endian):
+//   header   : magic, version, source hash (64 bit), material count, shape count
+//   material : Ka[3], Kd[3], Ks[3], texture name length, texture name (padded to 4 bytes)
+//   shape    : material id, float count of each stream, index count
+//   data     : the float streams and then the indices of every shape, in shape order
+
+constexpr uint32_t MESH_CACHE_MAGIC = 0x4348534d; // "MSHC"
+constexpr uint32_t MESH_CACHE_VERSION = 3; // 3: indices reordered for the vertex cache and overdraw
+
+enum MeshStream
+{
+    MESH_POSITION = 0,
+    MESH_COLOR,
+    MESH_NORMAL,
+    MESH_TEXCOORD,
+    MESH_STREAM_COUNT
+};
+
+struct CachedMaterial
+{
+    float ambient[3];
+    float diffuse[3];
+    float specular[3];
+    std::string diffuse_texname;
+};
+
+// Non-owning view of one shape; streams point either into a mapped cache file or into
+// vectors owned by the caller.
+struct CachedShape
+{
+    int material_id = -1;
+    const float *stream[MESH_STREAM_COUNT] = {};
+    uint32_t length[MESH_STREAM_COUNT] = {}; // in floats
+    const uint32_t *indices = nullptr;        // triangle list into the streams
+    uint32_t index_count = 0;
+};
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const unsigned char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
+
+class MeshCacheReader
+{
+public:
+    // map the cache and validate it against the hash of the source file
+    bool open(const std::string &cache_path, uint64_t source_hash);
+
+    const std::vector<CachedMaterial> &materials() const { return materials_; }
+    const std::vector<CachedShape> &shapes() const { return shapes_; }
+
+private:
+    bool parse(uint64_t source_hash);
+
+    MappedFile file_;
+    std::vector<CachedMaterial> materials_;
+    std::vector<CachedShape> shapes_;
+};
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+// FNV-1a hash of a block of memory, continuing the hash seed of the blocks before
+uint64_t HashBytes(const unsigned char *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS);
+
+// FNV-1a hash of the file content
+bool HashFileContent(const std::string &path, uint64_t *hash);
+
+// The cache key of a model: the hash of the .obj file followed by every .mtl file its mtllib lines name,
+// looked up in the directory of the .obj like the loader does. Material files that do not exist are skipped.
+bool HashModelContent(const std::string &obj_path, uint64_t *hash);
+
+bool WriteMeshCache(const std::string &cache_path, uint64_t source_hash,
+                    const std::vector<CachedMaterial> &materials, const std::vector<CachedShape> &shapes);
+
+inline std::string GetMeshCachePath(const std::string &model_path)
+{
+    return model_path + ".meshcache";
+}
+
+#endif
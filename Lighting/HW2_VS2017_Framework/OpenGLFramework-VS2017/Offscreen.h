@@ -0,0 +1,54 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// A GL 3.3 core context without any window or display, for rendering on machines without a GPU
+// (Mesa llvmpipe) through EGL surfaceless or OSMesa, rendering into a framebuffer object.
+// The EGL and OSMesa libraries are opened at run time, so the windowed build does not depend on them.
+// Only one context can exist at a time.
+class OffscreenContext
+{
+public:
+    OffscreenContext() = default;
+    ~OffscreenContext();
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    // backend is "egl" or "osmesa". Makes the context current, loads the GL functions through glad
+    // and binds a width x height framebuffer object. Prints the reason and returns false on failure.
+    bool create(const std::string &backend, int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // read the framebuffer back and write it to path as a binary PPM
+    bool writeImage(const std::string &path) const;
+
+private:
+    bool createEGL();
+    bool createOSMesa();
+    bool createFramebuffer();
+    void destroy();
+
+    std::string backend_;
+    void *library_ = nullptr;
+    void *display_ = nullptr; // EGLDisplay
+    void *context_ = nullptr; // EGLContext or OSMesaContext
+    std::vector<unsigned char> osmesa_buffer_; // OSMesa needs a default framebuffer in client memory
+
+    int width_ = 0;
+    int height_ = 0;
+    GLuint fbo_ = 0;
+    GLuint color_ = 0;
+    GLuint depth_ = 0;
+};
+
+// Writes width x height RGBA8 pixels, rows from bottom to top as glReadPixels returns them,
+// to path as a binary PPM.
+bool WriteImagePPM(const std::string &path, int width, int height, const unsigned char *rgba);
+
+#endif
@@ -0,0 +1,139 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+// FNV-1a, continued from h and closed by a 0xff byte so that consecutive strings cannot run into each other
+static uint64_t HashString(uint64_t h, const char *s)
+{
+    for (; s != NULL && *s != '\0'; s++)
+    {
+        h ^= static_cast<unsigned char>(*s);
+        h *= 1099511628211ull;
+    }
+    h ^= 0xff;
+    h *= 1099511628211ull;
+    return h;
+}
+
+// glGetProgramBinary needs GL 4.1 and a driver offering at least one binary format
+static bool ProgramBinarySupported()
+{
+    if (glGetProgramBinary == NULL || glProgramBinary == NULL || glProgramParameteri == NULL)
+        return false;
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+uint64_t ProgramCacheKey(const char *vertex_source, const char *fragment_source)
+{
+    uint64_t h = 14695981039346656037ull;
+    h = HashString(h, vertex_source);
+    h = HashString(h, fragment_source);
+    h = HashString(h, reinterpret_cast<const char *>(glGetString(GL_VENDOR)));
+    h = HashString(h, reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    h = HashString(h, reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+    return h;
+}
+
+bool LoadProgramBinary(const std::string &cache_path, uint64_t key, GLuint program)
+{
+    if (!ProgramBinarySupported())
+    {
+        std::cout << "ProgramCache: program binaries are not supported, compiling from source" << std::endl;
+        return false;
+    }
+
+    FILE *fp = fopen(cache_path.c_str(), "rb");
+    if (fp == NULL)
+    {
+        std::cout << "ProgramCache: miss " << cache_path << ", compiling from source" << std::endl;
+        return false;
+    }
+
+    ProgramCacheHeader header = {};
+    std::vector<unsigned char> binary;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == PROGRAM_CACHE_MAGIC &&
+                 header.version == PROGRAM_CACHE_VERSION && header.key == key && header.length > 0;
+    if (valid)
+    {
+        binary.resize(header.length);
+        valid = fread(binary.data(), 1, binary.size(), fp) == binary.size();
+    }
+    fclose(fp);
+    if (!valid)
+    {
+        std::cout << "ProgramCache: stale " << cache_path << ", compiling from source" << std::endl;
+        return false;
+    }
+
+    // a driver update can still reject a binary under the same version string
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        std::cout << "ProgramCache: " << cache_path << " rejected by the driver, compiling from source" << std::endl;
+        return false;
+    }
+
+    std::cout << "ProgramCache: hit " << cache_path << std::endl;
+    return true;
+}
+
+void PrepareProgramBinary(GLuint program)
+{
+    if (ProgramBinarySupported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool SaveProgramBinary(const std::string &cache_path, uint64_t key, GLuint program)
+{
+    if (!ProgramBinarySupported())
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    std::vector<unsigned char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramCacheHeader header = {PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, key, format, static_cast<uint32_t>(length)};
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string tmp_path = cache_path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    bool ok = fp != NULL;
+    if (ok)
+    {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(binary.data(), 1, length, fp) == static_cast<size_t>(length);
+        ok = (fclose(fp) == 0) && ok;
+    }
+
+    if (ok)
+    {
+        remove(cache_path.c_str());
+        ok = rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+    }
+    if (!ok)
+    {
+        remove(tmp_path.c_str());
+        std::cout << "ProgramCache: cannot write " << cache_path << std::endl;
+    }
+    return ok;
+}
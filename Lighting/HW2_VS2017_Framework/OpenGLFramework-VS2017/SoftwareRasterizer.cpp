@@ -0,0 +1,523 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTER_SSE2
+#endif
+
+constexpr int RASTER_TILE_SIZE = SoftwareRasterizer::TILE_SIZE;
+constexpr float RASTER_PI = 3.14159265358979323846f;
+
+// four lanes of float, one pixel each
+#ifdef RASTER_SSE2
+struct Float4
+{
+    __m128 v;
+};
+
+static inline Float4 Splat4(float a) { return {_mm_set1_ps(a)}; }
+static inline Float4 Ramp4(float a) { return {_mm_setr_ps(a, a + 1, a + 2, a + 3)}; }
+static inline Float4 Load4(const float *p) { return {_mm_loadu_ps(p)}; }
+static inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+static inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+static inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+static inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+static inline Float4 Sqrt4(Float4 a) { return {_mm_sqrt_ps(a.v)}; }
+// std::max and std::min of every lane, NaN in a is kept as they keep it
+static inline Float4 Max4(Float4 a, Float4 b) { return {_mm_max_ps(b.v, a.v)}; }
+static inline Float4 Min4(Float4 a, Float4 b) { return {_mm_min_ps(b.v, a.v)}; }
+// bit i is set where a[i] > b[i]
+static inline int Greater4(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a.v, b.v)); }
+static inline void Store4(float *p, Float4 a) { _mm_storeu_ps(p, a.v); }
+#else
+struct Float4
+{
+    float v[4];
+};
+
+static inline Float4 Splat4(float a) { return {{a, a, a, a}}; }
+static inline Float4 Ramp4(float a) { return {{a, a + 1, a + 2, a + 3}}; }
+static inline Float4 Load4(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+static inline Float4 operator+(Float4 a, Float4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+static inline Float4 operator-(Float4 a, Float4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+static inline Float4 operator*(Float4 a, Float4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+static inline Float4 operator/(Float4 a, Float4 b) { return {{a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]}}; }
+static inline Float4 Sqrt4(Float4 a) { return {{sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3])}}; }
+static inline Float4 Max4(Float4 a, Float4 b)
+{
+    return {{std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3])}};
+}
+static inline Float4 Min4(Float4 a, Float4 b)
+{
+    return {{std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3])}};
+}
+static inline int Greater4(Float4 a, Float4 b)
+{
+    return (a.v[0] > b.v[0]) | (a.v[1] > b.v[1]) << 1 | (a.v[2] > b.v[2]) << 2 | (a.v[3] > b.v[3]) << 3;
+}
+static inline void Store4(float *p, Float4 a) { p[0] = a.v[0], p[1] = a.v[1], p[2] = a.v[2], p[3] = a.v[3]; }
+#endif
+
+// SSE2 has no pow, one powf per lane
+static inline Float4 Pow4(Float4 a, float b)
+{
+    float v[4];
+    Store4(v, a);
+    for (int lane = 0; lane < 4; lane++)
+        v[lane] = powf(v[lane], b);
+    return Load4(v);
+}
+
+// four vectors in structure of arrays layout, one pixel per lane
+struct Vector3x4
+{
+    Float4 x, y, z;
+};
+
+static inline Vector3x4 Splat3x4(const Vector3 &a) { return {Splat4(a.x), Splat4(a.y), Splat4(a.z)}; }
+static inline Vector3x4 operator+(const Vector3x4 &a, const Vector3x4 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+static inline Vector3x4 operator-(const Vector3x4 &a, const Vector3x4 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+static inline Vector3x4 operator*(Float4 s, const Vector3x4 &a) { return {s * a.x, s * a.y, s * a.z}; }
+static inline Float4 Dot4(const Vector3x4 &a, const Vector3x4 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+static inline Vector3x4 Normalized4(const Vector3x4 &a)
+{
+    Float4 inv_length = Splat4(1.0f) / Sqrt4(Dot4(a, a));
+    return {a.x * inv_length, a.y * inv_length, a.z * inv_length};
+}
+
+// s * a * b of every lane, the order of the scalar terms in Shade
+static inline Vector3x4 Scaled4(Float4 s, const Vector3 &a, const Vector3 &b)
+{
+    return {s * Splat4(a.x) * Splat4(b.x), s * Splat4(a.y) * Splat4(b.y), s * Splat4(a.z) * Splat4(b.z)};
+}
+
+static inline Vector3 Normalized(Vector3 v)
+{
+    return v.normalize();
+}
+
+// directionalLight / positionLight / spotLight of shader.vs and shader.fs
+static Vector3 Shade(const RasterLight &light, const RasterMaterial &material, const Vector3 &camera_position,
+                     const Vector3 &position, const Vector3 &normal)
+{
+    Vector3 L = light.mode == 0 ? Normalized(light.position) : Normalized(light.position - position);
+    Vector3 V = Normalized(camera_position - position);
+    Vector3 H = Normalized(L + V);
+    Vector3 N = Normalized(normal);
+
+    Vector3 ambient = light.ambient * material.Ka;
+    Vector3 diffuse = std::max(L.dot(N), 0.0f) * light.diffuse * material.Kd;
+    Vector3 specular = powf(std::max(H.dot(N), 0.0f), light.shininess) * light.specular * material.Ks;
+    if (light.mode == 0)
+        return ambient + diffuse + specular;
+
+    float dist = (light.position - position).length();
+    float attenuation = light.attenuationConstant +
+                        light.attenuationLinear * dist +
+                        light.attenuationQuadratic * dist * dist;
+    float f_att = std::min(1.0f / attenuation, 1.0f);
+    if (light.mode == 1)
+        return ambient + f_att * (diffuse + specular);
+
+    Vector3 v = Normalized(position - light.position);
+    Vector3 d = Normalized(light.spotDirection);
+    float vd = v.dot(d);
+    float spotEffect = 0;
+    if (vd > cosf(light.spotCutoff * RASTER_PI / 180.0f))
+        spotEffect = powf(std::max(vd, 0.0f), light.spotExponent);
+    return ambient + spotEffect * f_att * (diffuse + specular);
+}
+
+// Shade for four pixels at once, with the same operations in the same order so every lane gets exactly
+// the color Shade would give it
+static Vector3x4 Shade4(const RasterLight &light, const RasterMaterial &material, const Vector3 &camera_position,
+                        const Vector3x4 &position, const Vector3x4 &normal)
+{
+    Vector3x4 to_light = Splat3x4(light.position) - position;
+    Vector3x4 L = light.mode == 0 ? Splat3x4(Normalized(light.position)) : Normalized4(to_light);
+    Vector3x4 V = Normalized4(Splat3x4(camera_position) - position);
+    Vector3x4 H = Normalized4(L + V);
+    Vector3x4 N = Normalized4(normal);
+
+    Vector3x4 ambient = Splat3x4(light.ambient * material.Ka);
+    Vector3x4 diffuse = Scaled4(Max4(Dot4(L, N), Splat4(0.0f)), light.diffuse, material.Kd);
+    Vector3x4 specular = Scaled4(Pow4(Max4(Dot4(H, N), Splat4(0.0f)), light.shininess), light.specular, material.Ks);
+    if (light.mode == 0)
+        return ambient + diffuse + specular;
+
+    Float4 dist = Sqrt4(Dot4(to_light, to_light));
+    Float4 attenuation = Splat4(light.attenuationConstant) +
+                         Splat4(light.attenuationLinear) * dist +
+                         Splat4(light.attenuationQuadratic) * dist * dist;
+    Float4 f_att = Min4(Splat4(1.0f) / attenuation, Splat4(1.0f));
+    if (light.mode == 1)
+        return ambient + f_att * (diffuse + specular);
+
+    Vector3x4 v = Normalized4(position - Splat3x4(light.position));
+    Float4 vd = Dot4(v, Splat3x4(Normalized(light.spotDirection)));
+    float cos_cutoff = cosf(light.spotCutoff * RASTER_PI / 180.0f);
+    float spot[4];
+    Store4(spot, vd);
+    for (int lane = 0; lane < 4; lane++)
+        spot[lane] = spot[lane] > cos_cutoff ? powf(std::max(spot[lane], 0.0f), light.spotExponent) : 0.0f;
+    return ambient + (Load4(spot) * f_att) * (diffuse + specular);
+}
+
+// unorm conversion of the color buffer, NaN goes to 0
+static inline unsigned char ToUnorm8(float c)
+{
+    c = c > 0.0f ? (c < 1.0f ? c : 1.0f) : 0.0f;
+    return static_cast<unsigned char>(c * 255.0f + 0.5f);
+}
+
+// Sutherland-Hodgman against the plane w + sign * z >= 0: sign 1 is the near plane, -1 the far plane
+static int ClipPolygon(const SoftwareRasterizer::ClipVertex *in, int count, SoftwareRasterizer::ClipVertex *out, float sign)
+{
+    int out_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const SoftwareRasterizer::ClipVertex &a = in[i];
+        const SoftwareRasterizer::ClipVertex &b = in[(i + 1) % count];
+        float da = a.clip[3] + sign * a.clip[2];
+        float db = b.clip[3] + sign * b.clip[2];
+        if (da >= 0)
+            out[out_count++] = a;
+        if ((da >= 0) != (db >= 0))
+        {
+            float t = da / (da - db);
+            SoftwareRasterizer::ClipVertex &v = out[out_count++];
+            for (int c = 0; c < 4; c++)
+                v.clip[c] = a.clip[c] + t * (b.clip[c] - a.clip[c]);
+            for (int c = 0; c < 6; c++)
+                v.varying[c] = a.varying[c] + t * (b.varying[c] - a.varying[c]);
+        }
+    }
+    return out_count;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned int thread_count) : pool_(thread_count)
+{
+    triangles_.resize(pool_.size());
+    bins_.resize(pool_.size());
+}
+
+void SoftwareRasterizer::resize(int width, int height)
+{
+    width_ = width;
+    height_ = height;
+    tiles_x_ = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    tiles_y_ = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    color_.assign(size_t(width) * size_t(height) * 4, 0);
+    depth_.assign(size_t(width) * size_t(height), 1.0f);
+    for (auto &bins : bins_)
+        bins.assign(size_t(tiles_x_) * size_t(tiles_y_), std::vector<uint32_t>());
+    setViewport(0, 0, width, height);
+}
+
+void SoftwareRasterizer::setViewport(int x, int y, int width, int height)
+{
+    viewport_[0] = x;
+    viewport_[1] = y;
+    viewport_[2] = width;
+    viewport_[3] = height;
+}
+
+void SoftwareRasterizer::setLight(const Vector3 &camera_position, const RasterLight &light)
+{
+    camera_position_ = camera_position;
+    light_ = light;
+}
+
+void SoftwareRasterizer::clear(float r, float g, float b)
+{
+    const unsigned char rgba[4] = {ToUnorm8(r), ToUnorm8(g), ToUnorm8(b), 255};
+    for (size_t i = 0; i < color_.size(); i += 4)
+        memcpy(&color_[i], rgba, 4);
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+}
+
+void SoftwareRasterizer::parallel(int jobs, const std::function<void(int)> &job)
+{
+    for (int i = 0; i < jobs; i++)
+    {
+        pool_.enqueue([this, &job, i]() {
+            job(i);
+            done_.push(i);
+        });
+    }
+    for (int i = 0; i < jobs; i++)
+        done_.pop();
+}
+
+void SoftwareRasterizer::draw(const RasterMesh &mesh, const RasterMaterial &material, const Matrix4 &mvp, const Matrix4 &model,
+                              const Matrix3 &normal_matrix, bool per_pixel)
+{
+    size_t vertex_count = mesh.positions.size() / 3;
+    if (vertex_count == 0 || mesh.indices.empty() || viewport_[2] <= 0 || viewport_[3] <= 0)
+        return;
+
+    const float *n = normal_matrix.get();
+
+    // vertex stage, positions go through the batched Matrix4 kernels
+    vertices_.resize(vertex_count);
+    clip_positions_.resize(vertex_count * 4);
+    world_positions_.resize(vertex_count * 4);
+    int jobs = static_cast<int>(pool_.size());
+    parallel(jobs, [&](int job) {
+        size_t begin = vertex_count * job / jobs;
+        size_t end = vertex_count * (job + 1) / jobs;
+        mvp.transformPoints(mesh.positions.data() + begin * 3, clip_positions_.data() + begin * 4, end - begin);
+        model.transformPoints(mesh.positions.data() + begin * 3, world_positions_.data() + begin * 4, end - begin);
+        for (size_t i = begin; i < end; i++)
+        {
+            Vector3 normal;
+            if (i * 3 + 2 < mesh.normals.size())
+                normal = Vector3(mesh.normals[i * 3], mesh.normals[i * 3 + 1], mesh.normals[i * 3 + 2]);
+
+            ClipVertex &v = vertices_[i];
+            const float *clip = &clip_positions_[i * 4];
+            Vector3 world(world_positions_[i * 4], world_positions_[i * 4 + 1], world_positions_[i * 4 + 2]);
+            Vector3 world_normal(n[0] * normal.x + n[1] * normal.y + n[2] * normal.z,
+                                 n[3] * normal.x + n[4] * normal.y + n[5] * normal.z,
+                                 n[6] * normal.x + n[7] * normal.y + n[8] * normal.z);
+            for (int c = 0; c < 4; c++)
+                v.clip[c] = clip[c];
+            if (per_pixel)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    v.varying[c] = world[c];
+                    v.varying[3 + c] = world_normal[c];
+                }
+            }
+            else
+            {
+                Vector3 color = Shade(light_, material, camera_position_, world, world_normal);
+                for (int c = 0; c < 3; c++)
+                    v.varying[c] = color[c];
+            }
+        }
+    });
+
+    // setup and binning stage, every job bins its own range of triangles
+    parallel(jobs, [&](int job) { setupTriangles(job, jobs, mesh, per_pixel); });
+
+    // raster stage, one tile per worker at a time
+    std::atomic<int> next_tile(0);
+    int tile_count = tiles_x_ * tiles_y_;
+    parallel(jobs, [&](int) {
+        for (int tile = next_tile++; tile < tile_count; tile = next_tile++)
+            rasterizeTile(tile, material, per_pixel);
+    });
+}
+
+void SoftwareRasterizer::setupTriangles(int job, int jobs, const RasterMesh &mesh, bool per_pixel)
+{
+    triangles_[job].clear();
+    for (auto &bin : bins_[job])
+        bin.clear();
+
+    int varying_count = per_pixel ? 6 : 3;
+    size_t triangle_count = mesh.indices.size() / 3;
+    size_t begin = triangle_count * job / jobs;
+    size_t end = triangle_count * (job + 1) / jobs;
+    for (size_t t = begin; t < end; t++)
+    {
+        ClipVertex polygon[3] = {vertices_[mesh.indices[t * 3]], vertices_[mesh.indices[t * 3 + 1]], vertices_[mesh.indices[t * 3 + 2]]};
+        bool inside = true;
+        for (const ClipVertex &v : polygon)
+            inside = inside && v.clip[3] + v.clip[2] >= 0 && v.clip[3] - v.clip[2] >= 0;
+        if (inside)
+        {
+            setupTriangle(job, polygon, varying_count);
+            continue;
+        }
+
+        // each plane adds at most one vertex
+        ClipVertex near_clipped[4], clipped[5];
+        int count = ClipPolygon(polygon, 3, near_clipped, 1.0f);
+        count = ClipPolygon(near_clipped, count, clipped, -1.0f);
+        for (int i = 1; i + 1 < count; i++)
+        {
+            ClipVertex fan[3] = {clipped[0], clipped[i], clipped[i + 1]};
+            setupTriangle(job, fan, varying_count);
+        }
+    }
+}
+
+void SoftwareRasterizer::setupTriangle(int job, const ClipVertex *v, int varying_count)
+{
+    Triangle tri;
+    float x[3], y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        float w = v[i].clip[3];
+        if (!(w > 0.0f))
+            return;
+        float inv_w = 1.0f / w;
+        // window coordinates snapped to 1/256 pixel, so shared edges give the same edge functions
+        x[i] = roundf((viewport_[0] + (v[i].clip[0] * inv_w * 0.5f + 0.5f) * viewport_[2]) * 256.0f) / 256.0f;
+        y[i] = roundf((viewport_[1] + (v[i].clip[1] * inv_w * 0.5f + 0.5f) * viewport_[3]) * 256.0f) / 256.0f;
+        tri.z[i] = v[i].clip[2] * inv_w * 0.5f + 0.5f;
+        tri.invW[i] = inv_w;
+        for (int c = 0; c < varying_count; c++)
+            tri.varying[i][c] = v[i].varying[c] * inv_w;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f || !std::isfinite(area))
+        return;
+    // no face culling: flip clockwise triangles so the inside is where every edge function is positive
+    if (area < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(tri.z[1], tri.z[2]);
+        std::swap(tri.invW[1], tri.invW[2]);
+        std::swap(tri.varying[1], tri.varying[2]);
+        area = -area;
+    }
+    tri.invArea = 1.0f / area;
+    tri.z[1] = (tri.z[1] - tri.z[0]) * tri.invArea;
+    tri.z[2] = (tri.z[2] - tri.z[0]) * tri.invArea;
+
+    // pixel centers inside the bounding box and the viewport
+    float min_x = std::min(std::min(x[0], x[1]), x[2]), max_x = std::max(std::max(x[0], x[1]), x[2]);
+    float min_y = std::min(std::min(y[0], y[1]), y[2]), max_y = std::max(std::max(y[0], y[1]), y[2]);
+    tri.minX = std::max(static_cast<int>(ceilf(min_x - 0.5f)), std::max(viewport_[0], 0));
+    tri.minY = std::max(static_cast<int>(ceilf(min_y - 0.5f)), std::max(viewport_[1], 0));
+    tri.maxX = std::min(static_cast<int>(floorf(max_x - 0.5f)), std::min(viewport_[0] + viewport_[2], width_) - 1);
+    tri.maxY = std::min(static_cast<int>(floorf(max_y - 0.5f)), std::min(viewport_[1] + viewport_[3], height_) - 1);
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+        return;
+
+    float origin_x = tri.minX + 0.5f, origin_y = tri.minY + 0.5f;
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        tri.A[i] = y[a] - y[b];
+        tri.B[i] = x[b] - x[a];
+        tri.C[i] = tri.A[i] * (origin_x - x[a]) + tri.B[i] * (origin_y - y[a]);
+        // of the two triangles sharing an edge, only the one seeing it with A > 0 (or A == 0 and B > 0) owns it
+        bool owns_edge = tri.A[i] > 0.0f || (tri.A[i] == 0.0f && tri.B[i] > 0.0f);
+        tri.bias[i] = owns_edge ? -FLT_MIN : 0.0f;
+    }
+
+    uint32_t index = static_cast<uint32_t>(triangles_[job].size());
+    triangles_[job].push_back(tri);
+    for (int ty = tri.minY / RASTER_TILE_SIZE; ty <= tri.maxY / RASTER_TILE_SIZE; ty++)
+        for (int tx = tri.minX / RASTER_TILE_SIZE; tx <= tri.maxX / RASTER_TILE_SIZE; tx++)
+            bins_[job][ty * tiles_x_ + tx].push_back(index);
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile, const RasterMaterial &material, bool per_pixel)
+{
+    int x0 = (tile % tiles_x_) * RASTER_TILE_SIZE;
+    int y0 = (tile / tiles_x_) * RASTER_TILE_SIZE;
+    int x1 = std::min(x0 + RASTER_TILE_SIZE, width_) - 1;
+    int y1 = std::min(y0 + RASTER_TILE_SIZE, height_) - 1;
+
+    // jobs binned consecutive ranges of triangles, so walking them in job order keeps the draw order
+    for (size_t job = 0; job < bins_.size(); job++)
+        for (uint32_t index : bins_[job][tile])
+            rasterizeTriangle(triangles_[job][index], x0, y0, x1, y1, material, per_pixel);
+}
+
+void SoftwareRasterizer::rasterizeTriangle(const Triangle &tri, int x0, int y0, int x1, int y1, const RasterMaterial &material, bool per_pixel)
+{
+    int min_x = std::max(tri.minX, x0), max_x = std::min(tri.maxX, x1);
+    int min_y = std::max(tri.minY, y0), max_y = std::min(tri.maxY, y1);
+    if (min_x > max_x || min_y > max_y)
+        return;
+
+    int varying_count = per_pixel ? 6 : 3;
+    Float4 A[3], bias[3], z[3], inv_w[3], varying[3][6];
+    for (int i = 0; i < 3; i++)
+    {
+        A[i] = Splat4(tri.A[i]);
+        bias[i] = Splat4(tri.bias[i]);
+        z[i] = Splat4(tri.z[i]);
+        inv_w[i] = Splat4(tri.invW[i]);
+        for (int c = 0; c < varying_count; c++)
+            varying[i][c] = Splat4(tri.varying[i][c]);
+    }
+    Float4 inv_area = Splat4(tri.invArea);
+
+    float depth[4];
+    float color[3][4];
+    for (int y = min_y; y <= max_y; y++)
+    {
+        float py = static_cast<float>(y - tri.minY);
+        Float4 row[3];
+        for (int i = 0; i < 3; i++)
+            row[i] = Splat4(tri.B[i] * py + tri.C[i]);
+
+        for (int x = min_x; x <= max_x; x += 4)
+        {
+            Float4 px = Ramp4(static_cast<float>(x - tri.minX));
+            Float4 e0 = A[0] * px + row[0];
+            Float4 e1 = A[1] * px + row[1];
+            Float4 e2 = A[2] * px + row[2];
+            int mask = Greater4(e0, bias[0]) & Greater4(e1, bias[1]) & Greater4(e2, bias[2]);
+            if (max_x - x < 3)
+                mask &= (1 << (max_x - x + 1)) - 1;
+            if (mask == 0)
+                continue;
+
+            // depth test, GL_LESS
+            size_t offset = size_t(y) * width_ + x;
+            Float4 pixel_z = z[0] + e1 * z[1] + e2 * z[2];
+            if (max_x - x >= 3)
+            {
+                mask &= Greater4(Load4(&depth_[offset]), pixel_z);
+                if (mask == 0)
+                    continue;
+            }
+            // the depth test of the last pixels of a row, which may lie outside the buffer, and the depth writes
+            Store4(depth, pixel_z);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(mask & (1 << lane)))
+                    continue;
+                if (depth[lane] < depth_[offset + lane])
+                    depth_[offset + lane] = depth[lane];
+                else
+                    mask &= ~(1 << lane);
+            }
+            if (mask == 0)
+                continue;
+
+            // perspective correct interpolation of the varyings and the lighting, of all four pixels at once
+            Float4 l0 = e0 * inv_area, l1 = e1 * inv_area, l2 = e2 * inv_area;
+            Float4 w = Splat4(1.0f) / (l0 * inv_w[0] + l1 * inv_w[1] + l2 * inv_w[2]);
+            Float4 pixel[6];
+            for (int c = 0; c < varying_count; c++)
+                pixel[c] = (l0 * varying[0][c] + l1 * varying[1][c] + l2 * varying[2][c]) * w;
+
+            Vector3x4 rgb = {pixel[0], pixel[1], pixel[2]};
+            if (per_pixel)
+                rgb = Shade4(light_, material, camera_position_, rgb, {pixel[3], pixel[4], pixel[5]});
+            Store4(color[0], rgb.x);
+            Store4(color[1], rgb.y);
+            Store4(color[2], rgb.z);
+
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(mask & (1 << lane)))
+                    continue;
+                unsigned char *dst = &color_[(offset + lane) * 4];
+                dst[0] = ToUnorm8(color[0][lane]);
+                dst[1] = ToUnorm8(color[1][lane]);
+                dst[2] = ToUnorm8(color[2][lane]);
+                dst[3] = 255;
+            }
+        }
+    }
+}
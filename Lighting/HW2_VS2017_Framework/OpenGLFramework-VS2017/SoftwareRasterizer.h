@@ -0,0 +1,127 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Matrices.h"
+#include "ThreadPool.h"
+#include "Vectors.h"
+
+// vertex streams of one shape, kept in client memory for the software rasterizer
+struct RasterMesh
+{
+    std::vector<float> positions; // 3 floats per vertex
+    std::vector<float> normals;   // 3 floats per vertex, may be short for shapes without normals
+    std::vector<uint32_t> indices;
+};
+
+struct RasterMaterial
+{
+    Vector3 Ka;
+    Vector3 Kd;
+    Vector3 Ks;
+};
+
+// the Light uniform block of shader.vs / shader.fs
+struct RasterLight
+{
+    int mode; // curLightMode: 0 directional, 1 position, 2 spot light
+    Vector3 position;
+    Vector3 ambient;
+    Vector3 diffuse;
+    Vector3 specular;
+    float attenuationConstant;
+    float attenuationLinear;
+    float attenuationQuadratic;
+    Vector3 spotDirection;
+    float spotExponent;
+    float spotCutoff; // degrees
+    float shininess;
+};
+
+// Renders indexed triangle lists on the CPU with the lighting of shader.vs (per vertex) and
+// shader.fs (per pixel), for machines without any GL driver.
+//
+// Every draw runs in three parallel stages on a thread pool: vertices are transformed and lit,
+// triangles are clipped against the near and far planes, set up and binned into TILE_SIZE tiles,
+// and finally each worker rasterizes one tile at a time, testing 4 pixels per step against the
+// edge functions and the depth buffer with SSE2 and then interpolating and lighting the 4 of them
+// together. Triangles keep their submission order within a tile.
+class SoftwareRasterizer
+{
+public:
+    static constexpr int TILE_SIZE = 64;
+
+    // thread_count = 0 uses one worker per hardware thread
+    explicit SoftwareRasterizer(unsigned int thread_count = 0);
+
+    void resize(int width, int height);
+    void setViewport(int x, int y, int width, int height);
+    void setLight(const Vector3 &camera_position, const RasterLight &light);
+
+    // clear the color buffer to rgb and the depth buffer to 1
+    void clear(float r, float g, float b);
+
+    // mvp, model and its normal matrix as in RenderScene; per_pixel selects the lighting of shader.fs over the vertex colors
+    void draw(const RasterMesh &mesh, const RasterMaterial &material, const Matrix4 &mvp, const Matrix4 &model,
+              const Matrix3 &normal_matrix, bool per_pixel);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // RGBA8, rows from bottom to top as glReadPixels returns them
+    const unsigned char *pixels() const { return color_.data(); }
+
+    // clip space position and the attributes interpolated across a triangle: the vertex color,
+    // or the world position and normal for per pixel lighting
+    struct ClipVertex
+    {
+        float clip[4];
+        float varying[6];
+    };
+
+    // screen space triangle, edge function i is E_i(x, y) = A[i] (x - minX) + B[i] (y - minY) + C[i] at pixel centers,
+    // zero on the edge opposite vertex i. Relative to the bounding box the terms stay small enough for float.
+    struct Triangle
+    {
+        float A[3], B[3], C[3];
+        float bias[3]; // pixels on an edge are inside if E_i > bias[i], the tie-break rule of shared edges
+        float invArea;
+        float z[3]; // depth of vertex 0, and the depth of vertices 1 and 2 relative to it over the area
+        float invW[3];
+        float varying[3][6]; // divided by w
+        int minX, minY, maxX, maxY;
+    };
+
+private:
+    // runs job(0 .. jobs - 1) on the pool and waits for all of them
+    void parallel(int jobs, const std::function<void(int)> &job);
+    void setupTriangles(int job, int jobs, const RasterMesh &mesh, bool per_pixel);
+    void setupTriangle(int job, const ClipVertex *v, int varying_count);
+    void rasterizeTile(int tile, const RasterMaterial &material, bool per_pixel);
+    void rasterizeTriangle(const Triangle &tri, int x0, int y0, int x1, int y1, const RasterMaterial &material, bool per_pixel);
+
+    ThreadPool pool_;
+    BlockingQueue<int> done_;
+
+    int width_ = 0;
+    int height_ = 0;
+    int tiles_x_ = 0;
+    int tiles_y_ = 0;
+    int viewport_[4] = {0, 0, 0, 0};
+    std::vector<unsigned char> color_;
+    std::vector<float> depth_;
+
+    Vector3 camera_position_;
+    RasterLight light_ = {};
+
+    std::vector<ClipVertex> vertices_;
+    std::vector<float> clip_positions_;  // MVP * position, 4 floats per vertex
+    std::vector<float> world_positions_; // M * position, 4 floats per vertex
+    std::vector<std::vector<Triangle>> triangles_;          // per job
+    std::vector<std::vector<std::vector<uint32_t>>> bins_; // per job and tile, indices into triangles_[job]
+};
+
+#endif
@@ -1,12 +1,28 @@
+#include <cfloat>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <math.h>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "textfile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Benchmark.h"
+#include "CommandLine.h"
+#include "DepthPrepass.h"
+#include "GBuffer.h"
+#include "LightClusters.h"
+#include "LightList.h"
+#include "Offscreen.h"
+#include "ShaderPermutations.h"
+#include "SoftwareRasterizer.h"
 
 #include "Matrices.h"
 #include "Vectors.h"
@@ -60,6 +76,8 @@ typedef struct
     PhongMaterial material;
     int indexCount;
     GLuint m_texture;
+    GLintptr materialOffset; // of its MaterialBlock in the model's material buffer
+    RasterMesh raster;       // client copy of the streams, only with the software rasterizer
 } Shape;
 
 struct model
@@ -68,11 +86,39 @@ struct model
     Vector3 scale = Vector3(1, 1, 1);
     Vector3 rotation = Vector3(0, 0, 0); // Euler form
 
+    // translate(position) * rotate(rotation) * scaling(scale) and transpose(inverse()) of its upper 3x3,
+    // rebuilt by UpdateModelMatrix() after the callbacks marked them dirty
+    Matrix4 matrix;
+    Matrix3 normalMatrix;
+    bool dirty = true;
+
+    // bounding sphere of the shapes in model space, for culling the light list
+    Vector3 boundCenter = Vector3(0, 0, 0);
+    float boundRadius = 0;
+
     vector<Shape> shapes;
+    GLuint materialBuffer = 0; // MaterialBlock of every shape
 };
 vector<model> models;
+
+// interleaved vertex of the packed vertex format, 20 bytes instead of 36 in three float buffers
+struct PackedVertex
+{
+    GLfloat position[3];
+    GLubyte color[4]; // normalized
+    GLuint normal;    // GL_INT_2_10_10_10_REV
+};
+
+// upload shapes as one buffer of PackedVertex instead of one float buffer per attribute
+bool usePackedVertices = true;
+
+// keep shapes in client memory for SoftwareRasterizer instead of uploading them, set by --headless=software
+bool useSoftwareRasterizer = false;
+
 int cur_idx = 0; // represent which model should be rendered now
 
+vector<string> model_list{"../NormalModels/bunny5KN.obj", "../NormalModels/dragon10KN.obj", "../NormalModels/lucy25KN.obj", "../NormalModels/teapot4KN.obj", "../NormalModels/dolphinN.obj"};
+
 struct camera
 {
     Vector3 position;
@@ -113,47 +159,105 @@ struct SpotLightInfo
 };
 SpotLightInfo spotLightInfo;
 
+// light mode of the scene lights, after the three of lightInfo and only offered with --lights
+constexpr int LIGHT_LIST_MODE = 3;
+constexpr float LIGHT_EXTENT = 4.0f; // the scene lights fill [-LIGHT_EXTENT, LIGHT_EXTENT]^3
+vector<SceneLight> sceneLights;
+// lights in the light list of the last frame, and the model last warned about reaching more than MAX_LIGHTS
+int lightListCount = 0;
+int lightListWarnedModel = -1;
+
+// per pixel lighting of the light list through the froxel lists of lightClusters, created with the scene lights
+unique_ptr<LightClusters> lightClusters;
+bool useClusteredLighting = true;
+
 int curLightMode = 0;
 GLfloat shininess;
 
-struct UniformPhongMaterial
+// std140 mirrors of the uniform blocks in shader.vs / shader.fs
+struct FrameBlock
 {
-    GLint Ka;
-    GLint Kd;
-    GLint Ks;
+    GLfloat MVP[16];
+    GLfloat M[16];
+    GLfloat normalMatrix[12]; // mat3, rows padded to vec4
+    GLfloat cameraPosition[3];
+    GLfloat pad0;
 };
 
-struct UniformLightInfo
+struct LightBlock
 {
-    GLint position;
-    GLint ambient;
-    GLint diffuse;
-    GLint specular;
-    GLint attenuationConstant;
-    GLint attenuationLinear;
-    GLint attenuationQuadratic;
+    // LightInfo lightInfo
+    GLfloat position[3], pad0;
+    GLfloat ambient[3], pad1;
+    GLfloat diffuse[3], pad2;
+    GLfloat specular[3];
+    GLfloat attenuationConstant;
+    GLfloat attenuationLinear;
+    GLfloat attenuationQuadratic;
+    GLfloat pad3[2];
+    // SpotLightInfo spotLightInfo
+    GLfloat direction[3];
+    GLfloat exponent;
+    GLfloat cutoff;
+    GLfloat pad4[3];
+
+    GLfloat shininess;
+    GLfloat pad5[3];
 };
 
-struct UniformSpotLightInfo
+struct MaterialBlock
 {
-    GLint direction;
-    GLint exponent;
-    GLint cutoff;
+    GLfloat Ka[3], pad0;
+    GLfloat Kd[3], pad1;
+    GLfloat Ks[3], pad2;
 };
 
-struct Uniform
-{
-    GLint iLocMVP;
-    GLint iLocM;
-    GLint iLocCameraPosition;
-    UniformPhongMaterial iLocMaterial;
-    UniformLightInfo iLocLightInfo;
-    UniformSpotLightInfo iLocSpotLightInfo; 
-    GLint iLocCurLightMode;
-    GLint iLocShininess;
-    GLint iLocIsPerPixelLighting;
+static_assert(sizeof(FrameBlock) == 192 && sizeof(LightBlock) == 128 && sizeof(MaterialBlock) == 48, "std140 layout");
+
+// binding points of the uniform blocks
+enum UniformBinding
+{
+    FRAME_BINDING = 0,
+    LIGHT_BINDING = 1,
+    MATERIAL_BINDING = 2,
+    LIGHT_LIST_BINDING = 3
 };
-Uniform uniform;
+
+// texture units of the light cluster buffer textures
+enum TextureUnit
+{
+    CLUSTER_GRID_UNIT = 0,
+    CLUSTER_LIGHTS_UNIT = 1,
+    GBUFFER_UNIT = 2 // the first of GBUFFER_TARGETS
+};
+
+// uniforms of the programs, in the order passed to ShaderPermutations::load
+enum ShaderUniform
+{
+    UNIFORM_CLUSTER_VIEWPORT = 0,
+    UNIFORM_CLUSTER_DEPTH
+};
+
+GLuint frameUniformBuffer;
+GLuint lightUniformBuffer;
+GLuint lightListUniformBuffer;
+LightListBlock lightList; // rebuilt for the model every frame of the light list mode
+GLint uniformBufferAlignment = 256; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+// one program per light mode and per vertex / per pixel lighting
+ShaderPermutations shaders;
+
+// shade the per pixel view in a geometry and a lighting pass instead of while rasterizing, set by --deferred
+bool useDeferredShading = false;
+GBuffer gbuffer;
+
+// draw the depth of the per pixel view first, so its program shades every pixel once, set by --prepass
+bool useDepthPrepass = false;
+DepthPrepass depthPrepass;
+constexpr int PREPASS_REPORT_FRAMES = 100; // between the statistics printed by the window
+
+// draw both views in one pass over the shapes instead of a pass each, set by --single-pass
+bool useSinglePass = false;
 
 static GLvoid Normalize(GLfloat v[3])
 {
@@ -171,7 +275,7 @@ static GLvoid Cross(GLfloat u[3], GLfloat v[3], GLfloat n[3])
 }
 
 // [TODO] given a translation vector then output a Matrix4 (Translation Matrix)
-Matrix4 translate(Vector3 vec)
+constexpr Matrix4 translate(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -186,7 +290,7 @@ Matrix4 translate(Vector3 vec)
 }
 
 // [TODO] given a scaling vector then output a Matrix4 (Scaling Matrix)
-Matrix4 scaling(Vector3 vec)
+constexpr Matrix4 scaling(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -255,6 +359,38 @@ Matrix4 rotate(Vector3 vec)
     return rotateX(vec.x) * rotateY(vec.y) * rotateZ(vec.z);
 }
 
+// translate * rotate * scaling written out, one sine and cosine per axis instead of three matrix products.
+// The normal matrix of R * S is R * inverse(S), R being orthonormal
+void UpdateModelMatrix(model &m)
+{
+    if (!m.dirty)
+        return;
+
+    float sx = sinf(m.rotation.x), cx = cosf(m.rotation.x);
+    float sy = sinf(m.rotation.y), cy = cosf(m.rotation.y);
+    float sz = sinf(m.rotation.z), cz = cosf(m.rotation.z);
+    float R[9] = {
+                        cy * cz,                -cy * sz,       sy,
+         sx * sy * cz + cx * sz, -sx * sy * sz + cx * cz, -sx * cy,
+        -cx * sy * cz + sx * sz,  cx * sy * sz + sx * cz,  cx * cy
+    };
+
+    const Vector3 &s = m.scale;
+    const Vector3 &t = m.position;
+    m.matrix.set(
+        R[0] * s.x, R[1] * s.y, R[2] * s.z, t.x,
+        R[3] * s.x, R[4] * s.y, R[5] * s.z, t.y,
+        R[6] * s.x, R[7] * s.y, R[8] * s.z, t.z,
+                 0,          0,          0,   1
+    );
+    m.normalMatrix.set(
+        R[0] / s.x, R[1] / s.y, R[2] / s.z,
+        R[3] / s.x, R[4] / s.y, R[5] / s.z,
+        R[6] / s.x, R[7] / s.y, R[8] / s.z
+    );
+    m.dirty = false;
+}
+
 // [TODO] compute viewing matrix accroding to the setting of main_camera
 void setViewingMatrix()
 {
@@ -308,14 +444,6 @@ void setPerspective()
     project_matrix[0] = f / (proj.aspect / 2);
 }
 
-void setGLMatrix(GLfloat *glm, Matrix4 &m)
-{
-    glm[0] = m[0];  glm[4] = m[1];  glm[8] = m[2];   glm[12] = m[3];
-    glm[1] = m[4];  glm[5] = m[5];  glm[9] = m[6];   glm[13] = m[7];
-    glm[2] = m[8];  glm[6] = m[9];  glm[10] = m[10]; glm[14] = m[11];
-    glm[3] = m[12]; glm[7] = m[13]; glm[11] = m[14]; glm[15] = m[15];
-}
-
 // Call back function for window reshape
 void ChangeSize(GLFWwindow *window, int width, int height)
 {
@@ -331,9 +459,90 @@ void ChangeSize(GLFWwindow *window, int width, int height)
     curWindowHeight = height;
 }
 
-inline void transferVector3(GLint location, const Vector3 &v)
+inline void copyVector3(GLfloat *dst, const Vector3 &v)
+{
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
+}
+
+// std140 keeps every row of a row_major mat3 in a vec4
+inline void copyMatrix3(GLfloat *dst, const Matrix3 &m)
 {
-    glUniform3f(location, v.x, v.y, v.z);
+    for (int row = 0; row < 3; row++)
+        memcpy(dst + row * 4, m.get() + row * 3, 3 * sizeof(GLfloat));
+}
+
+// every shape of the model with its material, by the program in use, instances times each
+void DrawShapes(const model &cur_model, int instances = 1)
+{
+    for (const auto &shape : cur_model.shapes)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BINDING, cur_model.materialBuffer, shape.materialOffset, sizeof(MaterialBlock));
+        glBindVertexArray(shape.vao);
+        if (instances == 1)
+            glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, 0);
+        else
+            glDrawElementsInstanced(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, 0, instances);
+    }
+}
+
+// the clusters of the per pixel view, in the right half of the window, for a clustered program in use
+void SetClusterUniforms(const ShaderProgram *program)
+{
+    glUniform4f(program->locations[UNIFORM_CLUSTER_VIEWPORT], curWindowWidth / 2, 0, curWindowWidth / 2, curWindowHeight);
+    glUniform4f(program->locations[UNIFORM_CLUSTER_DEPTH], proj.nearClip, proj.farClip, lightClusters->sliceScale(), lightClusters->sliceBias());
+}
+
+// Both views in a single pass: every shape is drawn once with two instances over the whole window, the
+// first one moved into the left half and lit per vertex, the second into the right half and lit per pixel.
+// GL 3.3 has no viewport arrays, so the vertex shader does the viewport transform of the halves itself.
+void RenderSplitView(const model &cur_model)
+{
+    int clustered = curLightMode == LIGHT_LIST_MODE && useClusteredLighting;
+    const ShaderProgram *program = shaders.program({curLightMode, 0, clustered, DEFERRED_FORWARD, 0, 1});
+    if (program == nullptr)
+        return;
+    glUseProgram(program->id);
+    glViewport(0, 0, curWindowWidth, curWindowHeight);
+    if (clustered)
+        SetClusterUniforms(program);
+
+    glEnable(GL_CLIP_DISTANCE0);
+    glEnable(GL_CLIP_DISTANCE1);
+    DrawShapes(cur_model, 2);
+    glDisable(GL_CLIP_DISTANCE0);
+    glDisable(GL_CLIP_DISTANCE1);
+}
+
+// print the fragments the depth pre-pass saved shading since the last report, waiting for them if wait
+void ReportDepthPrepass(const string &label, bool wait)
+{
+    PrepassStatistics stats;
+    if (!depthPrepass.statistics(stats, wait))
+        return;
+    printf("DepthPrepass: %s, %.0f fragments pass the depth test, %.0f shaded, %.2fx fewer (%d frames)\n", label.c_str(),
+           stats.depth_fragments, stats.shaded_fragments, stats.depth_fragments / max(stats.shaded_fragments, 1.0), stats.views);
+}
+
+// Deferred shading of the per pixel view, in the current viewport: the shapes write their surfaces into
+// the G-buffer, then one fullscreen pass lights each covered pixel once. The light list is not clustered
+// here, the lighting pass has no depth of the surface in gl_FragCoord.
+void RenderDeferred(const model &cur_model)
+{
+    // the G-buffer holds the same for every light mode
+    const ShaderProgram *geometry = shaders.program({0, 1, 0, DEFERRED_GEOMETRY});
+    const ShaderProgram *lighting = shaders.program({curLightMode, 1, 0, DEFERRED_LIGHTING});
+    if (geometry == nullptr || lighting == nullptr)
+        return;
+
+    gbuffer.begin();
+    glUseProgram(geometry->id);
+    DrawShapes(cur_model);
+    gbuffer.end();
+
+    glUseProgram(lighting->id);
+    gbuffer.drawLighting(GBUFFER_UNIT);
 }
 
 // Render function for display rendering
@@ -342,63 +551,108 @@ void RenderScene(void)
     // clear canvas
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    Matrix4 T, R, S;
     // [TODO] update translation, rotation and scaling
-    T = translate(models.at(cur_idx).position);
-    R = rotate(models.at(cur_idx).rotation);
-    S = scaling(models.at(cur_idx).scale);
+    UpdateModelMatrix(models.at(cur_idx));
+    const Matrix4 &M = models.at(cur_idx).matrix;
 
-    Matrix4 MVP, M;
     // [TODO] multiply all the matrix
-    MVP = project_matrix * view_matrix * T * R * S;
-    M = T * R * S;
-
-    GLfloat mvp[16], m[16];
-    // row-major ---> column-major
-    setGLMatrix(mvp, MVP);
-    setGLMatrix(m, M);
-
-    // use uniform to send mvp to vertex shader
-    glUniformMatrix4fv(uniform.iLocMVP, 1, GL_FALSE, mvp);
-    glUniformMatrix4fv(uniform.iLocM, 1, GL_FALSE, m);
-    transferVector3(uniform.iLocCameraPosition, main_camera.position);
-
-    transferVector3(uniform.iLocLightInfo.position, lightInfo[curLightMode].position);
-    transferVector3(uniform.iLocLightInfo.ambient, lightInfo[curLightMode].ambient);
-    transferVector3(uniform.iLocLightInfo.diffuse, lightInfo[curLightMode].diffuse);
-    transferVector3(uniform.iLocLightInfo.specular, lightInfo[curLightMode].specular);
-    glUniform1f(uniform.iLocLightInfo.attenuationConstant, lightInfo[curLightMode].attenuationConstant);
-    glUniform1f(uniform.iLocLightInfo.attenuationLinear, lightInfo[curLightMode].attenuationLinear);
-    glUniform1f(uniform.iLocLightInfo.attenuationQuadratic, lightInfo[curLightMode].attenuationQuadratic);
-
-    transferVector3(uniform.iLocSpotLightInfo.direction, spotLightInfo.direction);
-    glUniform1f(uniform.iLocSpotLightInfo.exponent, spotLightInfo.exponent);
-    glUniform1f(uniform.iLocSpotLightInfo.cutoff, spotLightInfo.cutoff);
-
-    glUniform1i(uniform.iLocCurLightMode, curLightMode);
-    glUniform1f(uniform.iLocShininess, shininess);
-
-    for (int i = 0; i < models[cur_idx].shapes.size(); i++)
-    {
-        // set glViewport and draw twice ...
-        const auto &shape = models.at(cur_idx).shapes.at(i);
-        transferVector3(uniform.iLocMaterial.Ka, shape.material.Ka);
-        transferVector3(uniform.iLocMaterial.Kd, shape.material.Kd);
-        transferVector3(uniform.iLocMaterial.Ks, shape.material.Ks);
-
-        /* draw left */
-        glUniform1i(uniform.iLocIsPerPixelLighting, 0);
-        glViewport(0, 0, curWindowWidth / 2, curWindowHeight);
+    Matrix4 MVP = project_matrix * view_matrix * M;
+
+    // the whole frame and light state goes to the shaders in two buffer updates
+    FrameBlock frame = {};
+    // the Frame block is row_major, so the matrices are copied as they are
+    memcpy(frame.MVP, MVP.get(), sizeof(frame.MVP));
+    memcpy(frame.M, M.get(), sizeof(frame.M));
+    copyMatrix3(frame.normalMatrix, models.at(cur_idx).normalMatrix);
+    copyVector3(frame.cameraPosition, main_camera.position);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+
+    LightBlock lightBlock = {};
+    if (curLightMode < LIGHT_LIST_MODE)
+    {
+        const LightInfo &light = lightInfo[curLightMode];
+        copyVector3(lightBlock.position, light.position);
+        copyVector3(lightBlock.ambient, light.ambient);
+        copyVector3(lightBlock.diffuse, light.diffuse);
+        copyVector3(lightBlock.specular, light.specular);
+        lightBlock.attenuationConstant = light.attenuationConstant;
+        lightBlock.attenuationLinear = light.attenuationLinear;
+        lightBlock.attenuationQuadratic = light.attenuationQuadratic;
+        copyVector3(lightBlock.direction, spotLightInfo.direction);
+        lightBlock.exponent = spotLightInfo.exponent;
+        lightBlock.cutoff = spotLightInfo.cutoff;
+    }
+    lightBlock.shininess = shininess;
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lightBlock), &lightBlock);
 
-        glBindVertexArray(shape.vao);
-        glDrawArrays(GL_TRIANGLES, 0, shape.vertex_count);
+    if (curLightMode == LIGHT_LIST_MODE)
+    {
+        // only the lights reaching the bounding sphere of the model in world space, and only their part of the block
+        const model &m = models.at(cur_idx);
+        Vector3 center = M * m.boundCenter + m.position;
+        float radius = m.boundRadius * max(fabsf(m.scale.x), max(fabsf(m.scale.y), fabsf(m.scale.z)));
+        copyVector3(lightList.ambient, lightInfo[0].ambient);
+        int reaching = 0;
+        int count = CullLights(sceneLights, center, radius, lightList, &reaching);
+        lightListCount = count;
+        if (reaching > count && lightListWarnedModel != cur_idx)
+        {
+            cout << "LightList: " << reaching << " lights reach " << model_list[cur_idx] << ", only the first " << MAX_LIGHTS
+                 << " are shaded" << endl;
+            lightListWarnedModel = cur_idx;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, lightListUniformBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(LightListBlock, lights) + count * sizeof(LightSourceBlock), &lightList);
+
+        // the clusters cover the per pixel view, half as wide as the window
+        if (useClusteredLighting && !useDeferredShading)
+        {
+            lightClusters->build(lightList, view_matrix, {proj.fovy, proj.aspect / 2, proj.nearClip, proj.farClip});
+            lightClusters->upload(CLUSTER_GRID_UNIT, CLUSTER_LIGHTS_UNIT);
+        }
+    }
+
+    // the left view is lit per vertex and the right view per pixel, each by its own program, or both in a
+    // single pass unless the per pixel view is drawn in passes of its own
+    const model &cur_model = models.at(cur_idx);
+    if (useSinglePass && !useDeferredShading && !useDepthPrepass)
+    {
+        RenderSplitView(cur_model);
+        return;
+    }
+    for (int per_pixel = 0; per_pixel < 2; per_pixel++)
+    {
+        glViewport(per_pixel ? curWindowWidth / 2 : 0, 0, curWindowWidth / 2, curWindowHeight);
+        if (per_pixel && useDeferredShading && gbuffer.resize(curWindowWidth, curWindowHeight))
+        {
+            RenderDeferred(cur_model);
+            continue;
+        }
 
-        /* draw right */
-        glUniform1i(uniform.iLocIsPerPixelLighting, 1);
-        glViewport(curWindowWidth / 2, 0, curWindowWidth / 2, curWindowHeight);
+        int clustered = per_pixel && curLightMode == LIGHT_LIST_MODE && useClusteredLighting;
+        const ShaderProgram *program = shaders.program({curLightMode, per_pixel, clustered, DEFERRED_FORWARD});
+        if (program == nullptr)
+            continue;
 
-        glBindVertexArray(shape.vao);
-        glDrawArrays(GL_TRIANGLES, 0, shape.vertex_count);
+        // the depth only program is the same for every light mode
+        const ShaderProgram *depth = per_pixel && useDepthPrepass ? shaders.program({0, 0, 0, DEFERRED_FORWARD, 1}) : nullptr;
+        if (depth != nullptr)
+        {
+            glUseProgram(depth->id);
+            depthPrepass.beginDepth();
+            DrawShapes(cur_model);
+            depthPrepass.beginShading();
+        }
+
+        glUseProgram(program->id);
+        if (clustered)
+            SetClusterUniforms(program);
+
+        DrawShapes(cur_model);
+        if (depth != nullptr)
+            depthPrepass.end();
     }
 }
 
@@ -425,7 +679,7 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
             cur_trans_mode = TransMode::GeoRotation;
             break;
         case GLFW_KEY_L:
-            curLightMode = (curLightMode == 2) ? 0 : curLightMode + 1;
+            curLightMode = (curLightMode == (sceneLights.empty() ? LIGHT_LIST_MODE - 1 : LIGHT_LIST_MODE)) ? 0 : curLightMode + 1;
             break;
         case GLFW_KEY_K:
             cur_trans_mode = TransMode::LightEdit;
@@ -433,6 +687,18 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
         case GLFW_KEY_J:
             cur_trans_mode = TransMode::ShininessEdit;
             break;
+        case GLFW_KEY_C:
+            useClusteredLighting = !useClusteredLighting;
+            break;
+        case GLFW_KEY_D:
+            useDeferredShading = !useDeferredShading;
+            break;
+        case GLFW_KEY_V:
+            useDepthPrepass = !useDepthPrepass;
+            break;
+        case GLFW_KEY_A:
+            useSinglePass = !useSinglePass;
+            break;
         default:
             break;
         }
@@ -447,12 +713,15 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     {
     case TransMode::GeoTranslation:
         models.at(cur_idx).position.z += diff / 10;
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::GeoScaling:
         models.at(cur_idx).scale.z += diff / 10;
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::GeoRotation:
         models.at(cur_idx).rotation.z += degree2radian(diff);
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::LightEdit:
         if (curLightMode == 0 || curLightMode == 1)
@@ -500,18 +769,24 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
         case TransMode::GeoTranslation:
             models.at(cur_idx).position.x += diff_x / 200;
             models.at(cur_idx).position.y -= diff_y / 200;
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::GeoScaling:
             models.at(cur_idx).scale.x += diff_x / 200;
             models.at(cur_idx).scale.y -= diff_y / 200;
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::GeoRotation:
             models.at(cur_idx).rotation.x -= degree2radian(diff_y / 2);
             models.at(cur_idx).rotation.y -= degree2radian(diff_x / 2);
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::LightEdit:
-            lightInfo[curLightMode].position.x += diff_x / 200;
-            lightInfo[curLightMode].position.y -= diff_y / 200;
+            if (curLightMode < LIGHT_LIST_MODE)
+            {
+                lightInfo[curLightMode].position.x += diff_x / 200;
+                lightInfo[curLightMode].position.y -= diff_y / 200;
+            }
             break;
         default:
             break;
@@ -523,94 +798,37 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
 
 void setShaders()
 {
-    GLuint v, f, p;
-    char *vs = NULL;
-    char *fs = NULL;
-
-    v = glCreateShader(GL_VERTEX_SHADER);
-    f = glCreateShader(GL_FRAGMENT_SHADER);
-
-    vs = textFileRead("shader.vs");
-    fs = textFileRead("shader.fs");
-
-    glShaderSource(v, 1, (const GLchar **)&vs, NULL);
-    glShaderSource(f, 1, (const GLchar **)&fs, NULL);
-
-    free(vs);
-    free(fs);
-
-    GLint success;
-    char infoLog[1000];
-    // compile vertex shader
-    glCompileShader(v);
-    // check for shader compile errors
-    glGetShaderiv(v, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(v, 1000, NULL, infoLog);
-        std::cout << "ERROR: VERTEX SHADER COMPILATION FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    // compile fragment shader
-    glCompileShader(f);
-    // check for shader compile errors
-    glGetShaderiv(f, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(f, 1000, NULL, infoLog);
-        std::cout << "ERROR: FRAGMENT SHADER COMPILATION FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    // create program object
-    p = glCreateProgram();
-
-    // attach shaders to program object
-    glAttachShader(p, f);
-    glAttachShader(p, v);
-
-    // link program
-    glLinkProgram(p);
-    // check for linking errors
-    glGetProgramiv(p, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(p, 1000, NULL, infoLog);
-        std::cout << "ERROR: SHADER PROGRAM LINKING FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    glDeleteShader(v);
-    glDeleteShader(f);
-
-    uniform.iLocMVP =            glGetUniformLocation(p, "MVP");
-    uniform.iLocM =              glGetUniformLocation(p, "M");
-    uniform.iLocCameraPosition = glGetUniformLocation(p, "cameraPosition");
-
-    uniform.iLocMaterial.Ka = glGetUniformLocation(p, "material.Ka");
-    uniform.iLocMaterial.Kd = glGetUniformLocation(p, "material.Kd");
-    uniform.iLocMaterial.Ks = glGetUniformLocation(p, "material.Ks");
-
-    uniform.iLocLightInfo.position =             glGetUniformLocation(p, "lightInfo.position");
-    uniform.iLocLightInfo.ambient =              glGetUniformLocation(p, "lightInfo.ambient");
-    uniform.iLocLightInfo.diffuse =              glGetUniformLocation(p, "lightInfo.diffuse");
-    uniform.iLocLightInfo.specular =             glGetUniformLocation(p, "lightInfo.specular");
-    uniform.iLocLightInfo.attenuationConstant =  glGetUniformLocation(p, "lightInfo.attenuationConstant");
-    uniform.iLocLightInfo.attenuationLinear =    glGetUniformLocation(p, "lightInfo.attenuationLinear");
-    uniform.iLocLightInfo.attenuationQuadratic = glGetUniformLocation(p, "lightInfo.attenuationQuadratic");
-
-    uniform.iLocSpotLightInfo.direction = glGetUniformLocation(p, "spotLightInfo.direction");
-    uniform.iLocSpotLightInfo.exponent =  glGetUniformLocation(p, "spotLightInfo.exponent");
-    uniform.iLocSpotLightInfo.cutoff =    glGetUniformLocation(p, "spotLightInfo.cutoff");
-
-    uniform.iLocCurLightMode =       glGetUniformLocation(p, "curLightMode");
-    uniform.iLocShininess =          glGetUniformLocation(p, "shininess");
-    uniform.iLocIsPerPixelLighting = glGetUniformLocation(p, "isPerPixelLighting");
+    vector<ShaderOption> options = {{"LIGHT_MODE", 4}, {"PER_PIXEL_LIGHTING", 2}, {"CLUSTERED_LIGHTING", 2}, {"DEFERRED_PASS", 3}, {"DEPTH_ONLY", 2}, {"SPLIT_VIEW", 2}};
+    bool loaded = shaders.load("shader.vs", "shader.fs", options, {"clusterViewport", "clusterDepth"}, [](GLuint p) {
+        // the blocks a permutation uses: the light list only exists in its own light mode,
+        // and the deferred lighting pass reads the material from the G-buffer
+        const pair<const char *, GLuint> blocks[] = {
+            {"Frame", FRAME_BINDING}, {"Light", LIGHT_BINDING}, {"Material", MATERIAL_BINDING}, {"LightList", LIGHT_LIST_BINDING}};
+        for (const auto &block : blocks)
+        {
+            GLuint index = glGetUniformBlockIndex(p, block.first);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(p, index, block.second);
+        }
+        // the samplers of the clusters in the clustered permutations
+        GLint clusterGrid = glGetUniformLocation(p, "clusterGrid");
+        if (clusterGrid != -1)
+        {
+            glUseProgram(p);
+            glUniform1i(clusterGrid, CLUSTER_GRID_UNIT);
+            glUniform1i(glGetUniformLocation(p, "clusterLights"), CLUSTER_LIGHTS_UNIT);
+        }
+        // and of the G-buffer in the deferred lighting pass
+        if (glGetUniformLocation(p, "gbufferPosition") != -1)
+        {
+            glUseProgram(p);
+            GBuffer::setSamplers(p, GBUFFER_UNIT);
+        }
+    });
 
-    if (success)
-        glUseProgram(p);
-    else
+    // the other permutations are compiled when first drawn, the ones of the first frame right away
+    // so that broken shaders still stop here
+    if (!loaded || shaders.program({curLightMode, 0}) == nullptr || shaders.program({curLightMode, 1}) == nullptr)
     {
         system("pause");
         exit(123);
@@ -741,6 +959,28 @@ void normalization(tinyobj::attrib_t *attrib, vector<GLfloat> &vertices, vector<
     }
 }
 
+// replace the triangle soup built by normalization() by its unique vertices and an index list
+void WeldStreams(vector<GLfloat> &vertices, vector<GLfloat> &colors, vector<GLfloat> &normals, vector<uint32_t> &indices)
+{
+    size_t vertex_count = vertices.size() / 3;
+    if (normals.size() != vertices.size())
+    {
+        // some faces have no normals so corners cannot be told apart, keep the soup
+        indices.resize(vertex_count);
+        for (size_t i = 0; i < vertex_count; i++)
+            indices[i] = static_cast<uint32_t>(i);
+        return;
+    }
+
+    VertexStream soup[3] = {{vertices.data(), 3}, {colors.data(), 3}, {normals.data(), 3}};
+    vector<GLfloat> welded[3];
+    WeldVertices(vertex_count, soup, 3, welded, indices);
+
+    vertices.swap(welded[0]);
+    colors.swap(welded[1]);
+    normals.swap(welded[2]);
+}
+
 string GetBaseDir(const string &filepath)
 {
     if (filepath.find_last_of("/\\") != std::string::npos)
@@ -748,6 +988,165 @@ string GetBaseDir(const string &filepath)
     return "";
 }
 
+vector<PackedVertex> PackVertices(const CachedShape &streams)
+{
+    vector<PackedVertex> packed(streams.length[MESH_POSITION] / 3);
+    for (size_t v = 0; v < packed.size(); v++)
+    {
+        memcpy(packed[v].position, streams.stream[MESH_POSITION] + v * 3, sizeof(packed[v].position));
+        PackUnorm8(streams.stream[MESH_COLOR] + v * 3, packed[v].color);
+        // faces without normals leave the normal stream short
+        packed[v].normal = v * 3 < streams.length[MESH_NORMAL] ? PackSnorm10(streams.stream[MESH_NORMAL] + v * 3) : 0;
+    }
+    return packed;
+}
+
+Shape CreateShape(const CachedShape &streams)
+{
+    Shape tmp_shape;
+    if (useSoftwareRasterizer)
+    {
+        tmp_shape.raster.positions.assign(streams.stream[MESH_POSITION], streams.stream[MESH_POSITION] + streams.length[MESH_POSITION]);
+        tmp_shape.raster.normals.assign(streams.stream[MESH_NORMAL], streams.stream[MESH_NORMAL] + streams.length[MESH_NORMAL]);
+        tmp_shape.raster.indices.assign(streams.indices, streams.indices + streams.index_count);
+        tmp_shape.vertex_count = streams.length[MESH_POSITION] / 3;
+        tmp_shape.indexCount = streams.index_count;
+        return tmp_shape;
+    }
+
+    glGenVertexArrays(1, &tmp_shape.vao);
+    glBindVertexArray(tmp_shape.vao);
+    tmp_shape.vertex_count = streams.length[MESH_POSITION] / 3;
+
+    if (usePackedVertices)
+    {
+        vector<PackedVertex> packed = PackVertices(streams);
+        GLsizei stride = sizeof(PackedVertex);
+
+        glGenBuffers(1, &tmp_shape.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(PackedVertex, color));
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, normal));
+    }
+    else
+    {
+        glGenBuffers(1, &tmp_shape.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_POSITION] * sizeof(GLfloat), streams.stream[MESH_POSITION], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glGenBuffers(1, &tmp_shape.p_color);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_color);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_COLOR] * sizeof(GLfloat), streams.stream[MESH_COLOR], GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glGenBuffers(1, &tmp_shape.p_normal);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_normal);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_NORMAL] * sizeof(GLfloat), streams.stream[MESH_NORMAL], GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    }
+
+    glGenBuffers(1, &tmp_shape.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tmp_shape.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, streams.index_count * sizeof(GLuint), streams.indices, GL_STATIC_DRAW);
+    tmp_shape.indexCount = streams.index_count;
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    return tmp_shape;
+}
+
+PhongMaterial ToPhongMaterial(const CachedMaterial &cached)
+{
+    PhongMaterial material;
+    material.Ka = Vector3(cached.ambient[0], cached.ambient[1], cached.ambient[2]);
+    material.Kd = Vector3(cached.diffuse[0], cached.diffuse[1], cached.diffuse[2]);
+    material.Ks = Vector3(cached.specular[0], cached.specular[1], cached.specular[2]);
+    return material;
+}
+
+// pack the materials of all shapes of a model into one uniform buffer, bound per draw with glBindBufferRange
+void CreateMaterialBuffer(model &tmp_model)
+{
+    if (useSoftwareRasterizer)
+        return;
+
+    GLintptr stride = (sizeof(MaterialBlock) + uniformBufferAlignment - 1) / uniformBufferAlignment * uniformBufferAlignment;
+    vector<unsigned char> data(tmp_model.shapes.size() * stride, 0);
+    for (int i = 0; i < tmp_model.shapes.size(); i++)
+    {
+        Shape &shape = tmp_model.shapes[i];
+        shape.materialOffset = i * stride;
+
+        MaterialBlock block = {};
+        copyVector3(block.Ka, shape.material.Ka);
+        copyVector3(block.Kd, shape.material.Kd);
+        copyVector3(block.Ks, shape.material.Ks);
+        memcpy(&data[shape.materialOffset], &block, sizeof(block));
+    }
+
+    glGenBuffers(1, &tmp_model.materialBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, tmp_model.materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+}
+
+// bounding sphere of the normalized positions of all shapes: the center of their bounding box
+// and the farthest vertex from it
+void SetBoundingSphere(model &tmp_model, const vector<CachedShape> &shapes)
+{
+    Vector3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (const auto &streams : shapes)
+    {
+        for (uint32_t i = 0; i + 2 < streams.length[MESH_POSITION]; i += 3)
+        {
+            const GLfloat *p = streams.stream[MESH_POSITION] + i;
+            lo = Vector3(min(lo.x, p[0]), min(lo.y, p[1]), min(lo.z, p[2]));
+            hi = Vector3(max(hi.x, p[0]), max(hi.y, p[1]), max(hi.z, p[2]));
+        }
+    }
+    if (lo.x > hi.x)
+        return;
+
+    Vector3 center = (lo + hi) * 0.5f;
+    float radius = 0;
+    for (const auto &streams : shapes)
+    {
+        for (uint32_t i = 0; i + 2 < streams.length[MESH_POSITION]; i += 3)
+        {
+            const GLfloat *p = streams.stream[MESH_POSITION] + i;
+            radius = max(radius, center.distance(Vector3(p[0], p[1], p[2])));
+        }
+    }
+    tmp_model.boundCenter = center;
+    tmp_model.boundRadius = radius;
+}
+
+// warm start: upload the normalized streams straight from the mapped cache file
+bool LoadModelsFromCache(const string &cache_path, uint64_t source_hash)
+{
+    MeshCacheReader cache;
+    if (!cache.open(cache_path, source_hash))
+        return false;
+
+    printf("Load Models From Cache ! Shapes size %d Material size %d\n", int(cache.shapes().size()), int(cache.materials().size()));
+    model tmp_model;
+    for (const auto &streams : cache.shapes())
+    {
+        Shape tmp_shape = CreateShape(streams);
+        if (streams.material_id >= 0)
+            tmp_shape.material = ToPhongMaterial(cache.materials().at(streams.material_id));
+        tmp_model.shapes.push_back(tmp_shape);
+    }
+    SetBoundingSphere(tmp_model, cache.shapes());
+    CreateMaterialBuffer(tmp_model);
+    models.push_back(tmp_model);
+    return true;
+}
+
 void LoadModels(string model_path)
 {
     vector<tinyobj::shape_t> shapes;
@@ -760,6 +1159,12 @@ void LoadModels(string model_path)
     string err;
     string warn;
 
+    string cache_path = GetMeshCachePath(model_path);
+    uint64_t source_hash = 0;
+    bool hashed = HashModelContent(model_path, &source_hash);
+    if (hashed && LoadModelsFromCache(cache_path, source_hash))
+        return;
+
     string base_dir = GetBaseDir(model_path); // handle .mtl with relative path
 
 #ifdef _WIN32
@@ -768,7 +1173,14 @@ void LoadModels(string model_path)
     base_dir += "/";
 #endif
 
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str(), base_dir.c_str());
+    tinyobj::ObjReaderConfig reader_config;
+    reader_config.mtl_search_path = base_dir;
+    reader_config.num_threads = 0; // split the parse across all hardware threads
+
+    tinyobj::ObjReader reader;
+    bool ret = reader.ParseFromFile(model_path, reader_config);
+    warn = reader.Warning();
+    err = reader.Error();
 
     if (!warn.empty())
     {
@@ -785,19 +1197,31 @@ void LoadModels(string model_path)
         exit(1);
     }
 
+    attrib = reader.TakeAttrib();
+    shapes = reader.TakeShapes();
+    materials = reader.TakeMaterials();
+
     printf("Load Models Success ! Shapes size %d Material size %d\n", int(shapes.size()), int(materials.size()));
     model tmp_model;
 
-    vector<PhongMaterial> allMaterial;
+    vector<CachedMaterial> cachedMaterials;
     for (int i = 0; i < materials.size(); i++)
     {
-        PhongMaterial material;
-        material.Ka = Vector3(materials[i].ambient[0], materials[i].ambient[1], materials[i].ambient[2]);
-        material.Kd = Vector3(materials[i].diffuse[0], materials[i].diffuse[1], materials[i].diffuse[2]);
-        material.Ks = Vector3(materials[i].specular[0], materials[i].specular[1], materials[i].specular[2]);
-        allMaterial.push_back(material);
+        CachedMaterial material;
+        for (int c = 0; c < 3; c++)
+        {
+            material.ambient[c] = materials[i].ambient[c];
+            material.diffuse[c] = materials[i].diffuse[c];
+            material.specular[c] = materials[i].specular[c];
+        }
+        cachedMaterials.push_back(material);
     }
 
+    // keep the normalized streams of every shape alive until the cache is written
+    vector<vector<GLfloat>> shapeStreams(shapes.size() * 3);
+    vector<vector<uint32_t>> shapeIndices(shapes.size());
+    vector<CachedShape> cachedShapes;
+    float faces = 0.0f, missesBefore = 0.0f, missesAfter = 0.0f;
     for (int i = 0; i < shapes.size(); i++)
     {
         vertices.clear();
@@ -805,39 +1229,49 @@ void LoadModels(string model_path)
         normals.clear();
         normalization(&attrib, vertices, colors, normals, &shapes[i]);
         // printf("Vertices size: %d", vertices.size() / 3);
+        WeldStreams(vertices, colors, normals, shapeIndices[i]);
+
+        // reorder the triangles for the vertex cache and then for overdraw
+        float before, after;
+        OptimizeTriangleOrder(shapeIndices[i].data(), shapeIndices[i].size(), vertices.data(), vertices.size() / 3, &before, &after);
+        faces += shapeIndices[i].size() / 3;
+        missesBefore += before * (shapeIndices[i].size() / 3);
+        missesAfter += after * (shapeIndices[i].size() / 3);
+
+        CachedShape streams;
+        shapeStreams[i * 3 + 0].swap(vertices);
+        shapeStreams[i * 3 + 1].swap(colors);
+        shapeStreams[i * 3 + 2].swap(normals);
+        for (int s = 0; s < 3; s++)
+        {
+            streams.stream[s] = shapeStreams[i * 3 + s].data();
+            streams.length[s] = static_cast<uint32_t>(shapeStreams[i * 3 + s].size());
+        }
+        streams.indices = shapeIndices[i].data();
+        streams.index_count = static_cast<uint32_t>(shapeIndices[i].size());
 
-        Shape tmp_shape;
-        glGenVertexArrays(1, &tmp_shape.vao);
-        glBindVertexArray(tmp_shape.vao);
-
-        glGenBuffers(1, &tmp_shape.vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GL_FLOAT), &vertices.at(0), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        tmp_shape.vertex_count = vertices.size() / 3;
-
-        glGenBuffers(1, &tmp_shape.p_color);
-        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_color);
-        glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GL_FLOAT), &colors.at(0), GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        glGenBuffers(1, &tmp_shape.p_normal);
-        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_normal);
-        glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GL_FLOAT), &normals.at(0), GL_STATIC_DRAW);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
+        Shape tmp_shape = CreateShape(streams);
 
         // not support per face material, use material of first face
-        if (allMaterial.size() > 0)
-            tmp_shape.material = allMaterial[shapes[i].mesh.material_ids[0]];
+        if (cachedMaterials.size() > 0)
+        {
+            streams.material_id = shapes[i].mesh.material_ids[0];
+            tmp_shape.material = ToPhongMaterial(cachedMaterials[streams.material_id]);
+        }
+        cachedShapes.push_back(streams);
         tmp_model.shapes.push_back(tmp_shape);
     }
     shapes.clear();
     materials.clear();
+    SetBoundingSphere(tmp_model, cachedShapes);
+    CreateMaterialBuffer(tmp_model);
     models.push_back(tmp_model);
+
+    if (faces > 0.0f)
+        printf("Optimize Models Success ! ACMR %.3f -> %.3f\n", missesBefore / faces, missesAfter / faces);
+
+    if (hashed && !WriteMeshCache(cache_path, source_hash, cachedMaterials, cachedShapes))
+        cout << "LoadModels: Cannot write mesh cache " << cache_path << endl;
 }
 
 void initParameter()
@@ -892,20 +1326,52 @@ void initParameter()
     setPerspective(); // set default projection matrix as perspective matrix
 }
 
+// buffers of the Frame, Light and LightList uniform blocks, rewritten every frame
+void setUniformBuffers()
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
+
+    glGenBuffers(1, &frameUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameUniformBuffer);
+
+    glGenBuffers(1, &lightUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, lightUniformBuffer);
+
+    glGenBuffers(1, &lightListUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightListUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightListBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_LIST_BINDING, lightListUniformBuffer);
+}
+
 void setupRC()
 {
     // setup shaders
     setShaders();
+    setUniformBuffers();
     initParameter();
 
     // OpenGL States and Values
     glClearColor(0.2, 0.2, 0.2, 1.0);
-    vector<string> model_list{"../NormalModels/bunny5KN.obj", "../NormalModels/dragon10KN.obj", "../NormalModels/lucy25KN.obj", "../NormalModels/teapot4KN.obj", "../NormalModels/dolphinN.obj"};
     // [TODO] Load five model at here
     for (const auto &model_path : model_list)
         LoadModels(model_path);
 }
 
+// --lights: start in the light list mode with that many lights around the models
+void setLights(const CommandLineOptions &options)
+{
+    if (options.lights <= 0)
+        return;
+
+    sceneLights = GenerateLights(options.lights, LIGHT_EXTENT);
+    lightClusters.reset(new LightClusters());
+    curLightMode = LIGHT_LIST_MODE;
+}
+
 void glPrintContextInfo(bool printExtension)
 {
     cout << "GL_VENDOR = " << (const char *)glGetString(GL_VENDOR) << endl;
@@ -924,8 +1390,205 @@ void glPrintContextInfo(bool printExtension)
     }
 }
 
+// benchmark camera path: frame i of n on one orbit around the center, at the distance of start
+void SetBenchmarkCamera(const camera &start, int i, int n)
+{
+    float angle = static_cast<float>(2 * PI * i / n);
+    Vector3 offset = start.position - start.center;
+    main_camera = start;
+    main_camera.position = start.center + Vector3(offset.x * cos(angle) + offset.z * sin(angle), offset.y, offset.z * cos(angle) - offset.x * sin(angle));
+    setViewingMatrix();
+}
+
+// render options.frames frames of every model on the benchmark camera path and write the report,
+// window is NULL when rendering offscreen
+int RunBenchmark(const CommandLineOptions &options, GLFWwindow *window)
+{
+    if (window != NULL)
+        glfwSwapInterval(0); // measure the frames, not the display refresh
+
+    // with --lights, every model once per light count 1, 2, 4, ... up to all of them
+    vector<int> light_counts(1, 0);
+    if (options.lights > 0)
+    {
+        light_counts.clear();
+        for (int n = 1; n < options.lights; n *= 2)
+            light_counts.push_back(n);
+        light_counts.push_back(options.lights);
+    }
+
+    camera start = main_camera;
+    vector<BenchmarkResult> results;
+    FrameTimer timer;
+    for (int light_count : light_counts)
+    {
+        if (light_count > 0)
+        {
+            sceneLights = GenerateLights(light_count, LIGHT_EXTENT);
+            lightListWarnedModel = -1;
+        }
+
+        for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+        {
+            // most lights in the list of any measured frame, fewer than light_count after culling
+            int shaded_lights = 0;
+            for (int i = -BENCHMARK_WARMUP_FRAMES; i < options.frames; i++)
+            {
+                SetBenchmarkCamera(start, i, options.frames);
+                if (i >= 0)
+                    timer.begin();
+
+                RenderScene();
+                if (window != NULL)
+                {
+                    glfwSwapBuffers(window);
+                    glfwPollEvents();
+                }
+                else
+                {
+                    glFlush();
+                }
+
+                if (i >= 0)
+                {
+                    timer.end();
+                    shaded_lights = max(shaded_lights, lightListCount);
+                }
+            }
+            BenchmarkResult result;
+            result.model = model_list[cur_idx];
+            if (light_count > 0)
+                result.model += " (" + to_string(light_count) + " lights, " + to_string(shaded_lights) + " shaded)";
+            timer.finish(result);
+            ReportDepthPrepass(result.model, true);
+            results.push_back(result);
+        }
+    }
+
+    main_camera = start;
+    setViewingMatrix();
+    cur_idx = 0;
+    return WriteBenchmarkReport(options.report, "HW2", options.frames, results) ? 0 : -1;
+}
+
+// RenderScene on the CPU: the same matrices, light and split view
+void RenderSceneSoftware(SoftwareRasterizer &rasterizer)
+{
+    rasterizer.clear(0.2f, 0.2f, 0.2f);
+
+    UpdateModelMatrix(models.at(cur_idx));
+    const Matrix4 &M = models.at(cur_idx).matrix;
+    Matrix4 MVP = project_matrix * view_matrix * M;
+
+    const LightInfo &light = lightInfo[curLightMode];
+    RasterLight rasterLight;
+    rasterLight.mode = curLightMode;
+    rasterLight.position = light.position;
+    rasterLight.ambient = light.ambient;
+    rasterLight.diffuse = light.diffuse;
+    rasterLight.specular = light.specular;
+    rasterLight.attenuationConstant = light.attenuationConstant;
+    rasterLight.attenuationLinear = light.attenuationLinear;
+    rasterLight.attenuationQuadratic = light.attenuationQuadratic;
+    rasterLight.spotDirection = spotLightInfo.direction;
+    rasterLight.spotExponent = spotLightInfo.exponent;
+    rasterLight.spotCutoff = spotLightInfo.cutoff;
+    rasterLight.shininess = shininess;
+    rasterizer.setLight(main_camera.position, rasterLight);
+
+    const model &cur_model = models.at(cur_idx);
+    for (const auto &shape : cur_model.shapes)
+    {
+        RasterMaterial material = {shape.material.Ka, shape.material.Kd, shape.material.Ks};
+
+        rasterizer.setViewport(0, 0, curWindowWidth / 2, curWindowHeight);
+        rasterizer.draw(shape.raster, material, MVP, M, cur_model.normalMatrix, false);
+
+        rasterizer.setViewport(curWindowWidth / 2, 0, curWindowWidth / 2, curWindowHeight);
+        rasterizer.draw(shape.raster, material, MVP, M, cur_model.normalMatrix, true);
+    }
+}
+
+// --headless=software: render every model once into an image file without any GL driver
+int RenderSoftware(const CommandLineOptions &options)
+{
+    if (options.benchmark)
+    {
+        cout << "Headless: --benchmark needs a GL backend" << endl;
+        return -1;
+    }
+    if (options.lights > 0 || options.deferred || options.prepass || options.single_pass)
+    {
+        const char *option = options.lights > 0 ? "--lights" : options.deferred ? "--deferred" : options.prepass ? "--prepass" : "--single-pass";
+        cout << "Headless: " << option << " needs a GL backend" << endl;
+        return -1;
+    }
+
+    useSoftwareRasterizer = true;
+    initParameter();
+    for (const auto &model_path : model_list)
+        LoadModels(model_path);
+    ChangeSize(NULL, options.width, options.height);
+
+    SoftwareRasterizer rasterizer;
+    rasterizer.resize(options.width, options.height);
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        RenderSceneSoftware(rasterizer);
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s_%03d.ppm", options.output.c_str(), cur_idx);
+        if (!WriteImagePPM(path, rasterizer.width(), rasterizer.height(), rasterizer.pixels()))
+            return -1;
+        cout << "Headless: wrote " << path << endl;
+    }
+    return 0;
+}
+
+// render every model once into an image file, without any window
+int RenderHeadless(const CommandLineOptions &options)
+{
+    if (options.backend == "software")
+        return RenderSoftware(options);
+
+    OffscreenContext context;
+    if (!context.create(options.backend, options.width, options.height))
+        return -1;
+
+    glEnable(GL_DEPTH_TEST);
+    setLights(options);
+    useDeferredShading = options.deferred;
+    useDepthPrepass = options.prepass;
+    useSinglePass = options.single_pass;
+    setupRC();
+    ChangeSize(NULL, context.width(), context.height());
+    if (options.benchmark)
+        return RunBenchmark(options, NULL);
+
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        RenderScene();
+        ReportDepthPrepass(model_list[cur_idx], true);
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s_%03d.ppm", options.output.c_str(), cur_idx);
+        if (!context.writeImage(path))
+            return -1;
+        cout << "Headless: wrote " << path << endl;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
+    CommandLineOptions options;
+    options.width = WINDOW_WIDTH;
+    options.height = WINDOW_HEIGHT;
+    if (!ParseCommandLine(argc, argv, options, OPTION_LIGHTS | OPTION_DEFERRED | OPTION_PREPASS | OPTION_SINGLE_PASS | OPTION_SOFTWARE))
+        return -1;
+    if (options.headless)
+        return RenderHeadless(options);
+
     // initial glfw
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -962,13 +1625,22 @@ int main(int argc, char **argv)
     glfwSetFramebufferSizeCallback(window, ChangeSize);
     glEnable(GL_DEPTH_TEST);
     // Setup render context
+    setLights(options);
+    useDeferredShading = options.deferred;
+    useDepthPrepass = options.prepass;
+    useSinglePass = options.single_pass;
     setupRC();
 
+    if (options.benchmark)
+        return RunBenchmark(options, window);
+
     // main loop
-    while (!glfwWindowShouldClose(window))
+    for (int frame = 1; !glfwWindowShouldClose(window); frame++)
     {
         // render
         RenderScene();
+        if (frame % PREPASS_REPORT_FRAMES == 0)
+            ReportDepthPrepass(model_list[cur_idx], false);
 
         // swap buffer from back to front
         glfwSwapBuffers(window);
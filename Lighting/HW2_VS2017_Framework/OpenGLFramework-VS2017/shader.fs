@@ -1,14 +1,37 @@
 #version 330 core
 
+#if PER_PIXEL_LIGHTING || SPLIT_VIEW
 in vec3 vertex_pos;
-in vec3 vertex_color;
 in vec3 vertex_normal;
+#endif
+#if !PER_PIXEL_LIGHTING || SPLIT_VIEW
+in vec3 vertex_color;
+#endif
+#if SPLIT_VIEW
+flat in int view;
+#endif
 
+#if DEFERRED_PASS == 1
+// the G-buffer targets, at the locations of GBufferTarget in GBuffer.h
+layout(location = 0) out vec4 gPosition;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 gAmbient;
+layout(location = 3) out vec4 gDiffuse;
+layout(location = 4) out vec4 gSpecular;
+#else
 out vec4 FragColor;
+#endif
 
 const float PI = 3.14159265358979323846;
 
-uniform vec3 cameraPosition;
+// uniform blocks, shared by both shader stages and mirrored by the *Block structs in main.cpp
+layout(std140, row_major) uniform Frame
+{
+    mat4 MVP;
+    mat4 M;
+    mat3 normalMatrix; // transpose(inverse(mat3(M))), computed once per model on the CPU
+    vec3 cameraPosition;
+};
 
 struct PhongMaterial
 {
@@ -16,7 +39,22 @@ struct PhongMaterial
     vec3 Kd;
     vec3 Ks;
 };
-uniform PhongMaterial material;
+
+#if DEFERRED_PASS == 2
+// the G-buffer, and the material of the pixel read from it by main()
+uniform sampler2D gbufferPosition;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferAmbient;
+uniform sampler2D gbufferDiffuse;
+uniform sampler2D gbufferSpecular;
+
+PhongMaterial material;
+#else
+layout(std140) uniform Material
+{
+    PhongMaterial material;
+};
+#endif
 
 struct LightInfo
 {
@@ -28,7 +66,6 @@ struct LightInfo
     float attenuationLinear;
     float attenuationQuadratic;
 };
-uniform LightInfo lightInfo;
 
 struct SpotLightInfo
 {
@@ -36,11 +73,61 @@ struct SpotLightInfo
     float exponent;
     float cutoff;
 };
-uniform SpotLightInfo spotLightInfo;
 
-uniform int curLightMode;
-uniform float shininess;
-uniform int isPerPixelLighting;
+layout(std140) uniform Light
+{
+    LightInfo lightInfo;
+    SpotLightInfo spotLightInfo;
+    float shininess;
+};
+
+#if LIGHT_MODE == 3
+// the lights reaching the model, picked on the CPU and mirrored by LightListBlock in LightList.h
+#define MAX_LIGHTS 255
+
+struct LightSource
+{
+    vec3 position;
+    float attenuationConstant;
+    vec3 color;
+    float attenuationLinear;
+    vec3 spotDirection;
+    float attenuationQuadratic;
+    float spotCosCutoff; // -1 for a point light
+    float spotExponent;
+    float range;
+};
+
+layout(std140) uniform LightList
+{
+    vec3 ambientLight;
+    int lightCount;
+    LightSource lights[MAX_LIGHTS];
+};
+
+#if CLUSTERED_LIGHTING
+// the light lists of the froxels, built and described by LightClusters.h
+#define CLUSTER_X 16
+#define CLUSTER_Y 16
+#define CLUSTER_Z 24
+
+uniform usamplerBuffer clusterGrid;   // offset and count of every cluster
+uniform usamplerBuffer clusterLights; // indices into lights
+uniform vec4 clusterViewport;         // x, y, width, height of the viewport the clusters cover
+uniform vec4 clusterDepth;            // near, far, slice scale and bias of log(view depth)
+
+int clusterIndex()
+{
+    ivec2 tile = ivec2((gl_FragCoord.xy - clusterViewport.xy) / clusterViewport.zw * vec2(CLUSTER_X, CLUSTER_Y));
+    float n = clusterDepth.x, f = clusterDepth.y;
+    float depth = 2.0f * n * f / (f + n - (2.0f * gl_FragCoord.z - 1.0f) * (f - n));
+    int slice = int(log(depth) * clusterDepth.z + clusterDepth.w);
+    tile = clamp(tile, ivec2(0), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    slice = clamp(slice, 0, CLUSTER_Z - 1);
+    return (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
+}
+#endif
+#endif
 
 vec3 directionalLight(vec3 vertexPosition, vec3 vertexNormal)
 {
@@ -100,15 +187,87 @@ vec3 spotLight(vec3 vertexPosition, vec3 vertexNormal)
     return ambient + spotEffect * f_att * (diffuse + specular);
 }
 
+#if LIGHT_MODE == 3
+// one light of the list without the ambient term, which the list adds once
+vec3 listLight(LightSource light, vec3 vertexPosition, vec3 vertexNormal)
+{
+    vec3 L = normalize(light.position - vertexPosition);
+    vec3 V = normalize(cameraPosition - vertexPosition);
+    vec3 H = normalize(L + V);
+    vec3 N = normalize(vertexNormal);
+
+    vec3 diffuse = max(dot(L, N), 0.0f) * light.color * material.Kd;
+    vec3 specular = pow(max(dot(H, N), 0.0f), shininess) * light.color * material.Ks;
+
+    float dist = length(light.position - vertexPosition);
+    float attenuation = light.attenuationConstant +
+                        light.attenuationLinear * dist +
+                        light.attenuationQuadratic * dist * dist;
+    float f_att = min(1.0f / attenuation, 1.0f);
+
+    float spotEffect = 1.0f;
+    if (light.spotCosCutoff > -1.0f)
+    {
+        float vd = dot(-L, light.spotDirection);
+        spotEffect = vd > light.spotCosCutoff ? pow(max(vd, 0.0f), light.spotExponent) : 0.0f;
+    }
+    return spotEffect * f_att * (diffuse + specular);
+}
+#endif
+
+// LIGHT_MODE picks the light type of the permutation: 0 directional, 1 position, 2 spot light,
+// 3 the light list, or with CLUSTERED_LIGHTING the part of it in the cluster of the fragment
+vec3 lighting(vec3 vertexPosition, vec3 vertexNormal)
+{
+#if LIGHT_MODE == 0
+    return directionalLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 1
+    return positionLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 2
+    return spotLight(vertexPosition, vertexNormal);
+#else
+    vec3 color = ambientLight * material.Ka;
+#if CLUSTERED_LIGHTING
+    uvec2 cluster = texelFetch(clusterGrid, clusterIndex()).xy;
+    for (uint i = 0u; i < cluster.y; i++)
+        color += listLight(lights[texelFetch(clusterLights, int(cluster.x + i)).x], vertexPosition, vertexNormal);
+#else
+    for (int i = 0; i < lightCount; i++)
+        color += listLight(lights[i], vertexPosition, vertexNormal);
+#endif
+    return color;
+#endif
+}
+
 void main()
 {
+#if DEFERRED_PASS == 1
+    // geometry pass: the inputs of lighting() instead of its result
+    gPosition = vec4(vertex_pos, 1.0f);
+    gNormal = vec4(vertex_normal, 0.0f);
+    gAmbient = vec4(material.Ka, 1.0f);
+    gDiffuse = vec4(material.Kd, 1.0f);
+    gSpecular = vec4(material.Ks, 1.0f);
+#elif DEFERRED_PASS == 2
+    // lighting pass: once for every pixel a surface covers
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gbufferPosition, pixel, 0);
+    if (position.w == 0.0f)
+        discard;
+    material.Ka = texelFetch(gbufferAmbient, pixel, 0).rgb;
+    material.Kd = texelFetch(gbufferDiffuse, pixel, 0).rgb;
+    material.Ks = texelFetch(gbufferSpecular, pixel, 0).rgb;
+    FragColor = vec4(lighting(position.xyz, texelFetch(gbufferNormal, pixel, 0).xyz), 1.0f);
+#elif DEPTH_ONLY
+    // depth pre-pass: the depth of the fragment is all that is written
+#elif SPLIT_VIEW
+    FragColor = view == 1 ? vec4(lighting(vertex_pos, vertex_normal), 1.0f) : vec4(vertex_color, 1.0f);
+#else
     // [TODO]
-    vec3 color;
-    if (curLightMode == 0)
-        color = directionalLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 1)
-        color = positionLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 2)
-        color = spotLight(vertex_pos, vertex_normal);
-    FragColor = (isPerPixelLighting == 1) ? vec4(color, 1.0f) : vec4(vertex_color, 1.0f);
+#if PER_PIXEL_LIGHTING
+    FragColor = vec4(lighting(vertex_pos, vertex_normal), 1.0f);
+#else
+    FragColor = vec4(vertex_color, 1.0f);
+#endif
+#endif
 }
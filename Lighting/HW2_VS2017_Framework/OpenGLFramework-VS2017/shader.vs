@@ -4,15 +4,33 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec3 aNormal;
 
+// LIGHT_MODE, PER_PIXEL_LIGHTING, CLUSTERED_LIGHTING, DEFERRED_PASS, DEPTH_ONLY and SPLIT_VIEW are #defined for
+// every program by ShaderPermutations, per pixel lighting, its light clusters and the G-buffer are left to shader.fs
+#if PER_PIXEL_LIGHTING || SPLIT_VIEW
 out vec3 vertex_pos;
-out vec3 vertex_color;
 out vec3 vertex_normal;
+#endif
+#if !PER_PIXEL_LIGHTING || SPLIT_VIEW
+out vec3 vertex_color;
+#endif
+#if SPLIT_VIEW
+// both views in one instanced draw: instance 0 is the left view, lit per vertex, instance 1 the right one, lit per pixel
+flat out int view;
+#endif
+
+// the depth only program of the pre-pass and the full ones have to agree exactly for its GL_EQUAL depth test
+invariant gl_Position;
 
 const float PI = 3.14159265358979323846;
 
-uniform mat4 MVP;
-uniform mat4 M;
-uniform vec3 cameraPosition;
+// uniform blocks, shared by both shader stages and mirrored by the *Block structs in main.cpp
+layout(std140, row_major) uniform Frame
+{
+    mat4 MVP;
+    mat4 M;
+    mat3 normalMatrix; // transpose(inverse(mat3(M))), computed once per model on the CPU
+    vec3 cameraPosition;
+};
 
 struct PhongMaterial
 {
@@ -20,7 +38,11 @@ struct PhongMaterial
     vec3 Kd;
     vec3 Ks;
 };
-uniform PhongMaterial material;
+
+layout(std140) uniform Material
+{
+    PhongMaterial material;
+};
 
 struct LightInfo
 {
@@ -32,7 +54,6 @@ struct LightInfo
     float attenuationLinear;
     float attenuationQuadratic;
 };
-uniform LightInfo lightInfo;
 
 struct SpotLightInfo
 {
@@ -40,10 +61,38 @@ struct SpotLightInfo
     float exponent;
     float cutoff;
 };
-uniform SpotLightInfo spotLightInfo;
 
-uniform int curLightMode;
-uniform float shininess;
+layout(std140) uniform Light
+{
+    LightInfo lightInfo;
+    SpotLightInfo spotLightInfo;
+    float shininess;
+};
+
+#if LIGHT_MODE == 3
+// the lights reaching the model, picked on the CPU and mirrored by LightListBlock in LightList.h
+#define MAX_LIGHTS 255
+
+struct LightSource
+{
+    vec3 position;
+    float attenuationConstant;
+    vec3 color;
+    float attenuationLinear;
+    vec3 spotDirection;
+    float attenuationQuadratic;
+    float spotCosCutoff; // -1 for a point light
+    float spotExponent;
+    float range;
+};
+
+layout(std140) uniform LightList
+{
+    vec3 ambientLight;
+    int lightCount;
+    LightSource lights[MAX_LIGHTS];
+};
+#endif
 
 vec3 directionalLight(vec3 vertexPosition, vec3 vertexNormal)
 {
@@ -103,20 +152,80 @@ vec3 spotLight(vec3 vertexPosition, vec3 vertexNormal)
     return ambient + spotEffect * f_att * (diffuse + specular);
 }
 
+#if LIGHT_MODE == 3
+// one light of the list without the ambient term, which the list adds once
+vec3 listLight(LightSource light, vec3 vertexPosition, vec3 vertexNormal)
+{
+    vec3 L = normalize(light.position - vertexPosition);
+    vec3 V = normalize(cameraPosition - vertexPosition);
+    vec3 H = normalize(L + V);
+    vec3 N = normalize(vertexNormal);
+
+    vec3 diffuse = max(dot(L, N), 0.0f) * light.color * material.Kd;
+    vec3 specular = pow(max(dot(H, N), 0.0f), shininess) * light.color * material.Ks;
+
+    float dist = length(light.position - vertexPosition);
+    float attenuation = light.attenuationConstant +
+                        light.attenuationLinear * dist +
+                        light.attenuationQuadratic * dist * dist;
+    float f_att = min(1.0f / attenuation, 1.0f);
+
+    float spotEffect = 1.0f;
+    if (light.spotCosCutoff > -1.0f)
+    {
+        float vd = dot(-L, light.spotDirection);
+        spotEffect = vd > light.spotCosCutoff ? pow(max(vd, 0.0f), light.spotExponent) : 0.0f;
+    }
+    return spotEffect * f_att * (diffuse + specular);
+}
+#endif
+
+// LIGHT_MODE picks the light type of the permutation: 0 directional, 1 position, 2 spot light,
+// 3 the light list
+vec3 lighting(vec3 vertexPosition, vec3 vertexNormal)
+{
+#if LIGHT_MODE == 0
+    return directionalLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 1
+    return positionLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 2
+    return spotLight(vertexPosition, vertexNormal);
+#else
+    vec3 color = ambientLight * material.Ka;
+    for (int i = 0; i < lightCount; i++)
+        color += listLight(lights[i], vertexPosition, vertexNormal);
+    return color;
+#endif
+}
+
 void main()
 {
+#if DEFERRED_PASS == 2
+    // one triangle covering the viewport, the lighting pass of deferred shading needs no vertices
+    gl_Position = vec4(gl_VertexID == 1 ? 3.0f : -1.0f, gl_VertexID == 2 ? 3.0f : -1.0f, 0.0f, 1.0f);
+#else
     // [TODO]
     gl_Position = MVP * vec4(aPos, 1.0f);
 
-    vertex_pos = vec3(M * vec4(aPos, 1.0f));
-    vertex_normal = mat3(transpose(inverse(M))) * aNormal;
-
-    vec3 color;
-    if (curLightMode == 0)
-        color = directionalLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 1)
-        color = positionLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 2)
-        color = spotLight(vertex_pos, vertex_normal);
-    vertex_color = color;
+#if !DEPTH_ONLY
+    vec3 position = vec3(M * vec4(aPos, 1.0f));
+    vec3 normal = normalMatrix * aNormal;
+#if SPLIT_VIEW
+    view = gl_InstanceID;
+    vertex_pos = position;
+    vertex_normal = normal;
+    vertex_color = view == 0 ? lighting(position, normal) : vec3(0.0f);
+
+    // into the half of the window of the view, whose edges clip like those of a viewport of its own
+    gl_ClipDistance[0] = gl_Position.w + gl_Position.x;
+    gl_ClipDistance[1] = gl_Position.w - gl_Position.x;
+    gl_Position.x = 0.5f * gl_Position.x + (float(view) - 0.5f) * gl_Position.w;
+#elif PER_PIXEL_LIGHTING
+    vertex_pos = position;
+    vertex_normal = normal;
+#else
+    vertex_color = lighting(position, normal);
+#endif
+#endif
+#endif
 }
@@ -0,0 +1,125 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+FrameTimer::~FrameTimer()
+{
+    if (!queries_.empty())
+        glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+void FrameTimer::begin()
+{
+    if (frame_ == queries_.size())
+    {
+        queries_.push_back(0);
+        glGenQueries(1, &queries_.back());
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries_[frame_]);
+    start_ = std::chrono::steady_clock::now();
+}
+
+void FrameTimer::end()
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_;
+    cpu_ms_.push_back(elapsed.count());
+    glEndQuery(GL_TIME_ELAPSED);
+    frame_++;
+}
+
+void FrameTimer::finish(BenchmarkResult &result)
+{
+    result.cpu_ms = std::move(cpu_ms_);
+    result.gpu_ms.resize(frame_);
+    for (size_t i = 0; i < frame_; i++)
+    {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries_[i], GL_QUERY_RESULT, &ns);
+        result.gpu_ms[i] = ns / 1e6;
+    }
+    cpu_ms_.clear();
+    frame_ = 0;
+}
+
+struct FrameStatistics
+{
+    double min = 0;
+    double median = 0;
+    double p99 = 0;
+};
+
+static FrameStatistics ComputeStatistics(std::vector<double> times)
+{
+    FrameStatistics statistics;
+    if (times.empty())
+        return statistics;
+
+    std::sort(times.begin(), times.end());
+    size_t n = times.size();
+    statistics.min = times.front();
+    statistics.median = n % 2 == 1 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+    statistics.p99 = times[(n * 99 + 99) / 100 - 1]; // nearest rank
+    return statistics;
+}
+
+static std::string JsonString(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void WriteStatistics(FILE *file, const char *name, const FrameStatistics &statistics)
+{
+    fprintf(file, "\"%s\": {\"min\": %.4f, \"median\": %.4f, \"p99\": %.4f}", name, statistics.min, statistics.median, statistics.p99);
+}
+
+bool WriteBenchmarkReport(const std::string &path, const std::string &app, int frames, const std::vector<BenchmarkResult> &results)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL)
+    {
+        std::cout << "Benchmark: cannot write " << path << std::endl;
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"app\": %s,\n", JsonString(app).c_str());
+    fprintf(file, "  \"renderer\": %s,\n", JsonString(reinterpret_cast<const char *>(glGetString(GL_RENDERER))).c_str());
+    fprintf(file, "  \"version\": %s,\n", JsonString(reinterpret_cast<const char *>(glGetString(GL_VERSION))).c_str());
+    fprintf(file, "  \"frames\": %d,\n", frames);
+    fprintf(file, "  \"warmup_frames\": %d,\n", BENCHMARK_WARMUP_FRAMES);
+    fprintf(file, "  \"models\": [\n");
+
+    printf("Benchmark: %d frames per model, times in ms (min / median / p99)\n", frames);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        FrameStatistics cpu = ComputeStatistics(results[i].cpu_ms);
+        FrameStatistics gpu = ComputeStatistics(results[i].gpu_ms);
+
+        fprintf(file, "    {\"model\": %s, ", JsonString(results[i].model).c_str());
+        WriteStatistics(file, "cpu_ms", cpu);
+        fprintf(file, ", ");
+        WriteStatistics(file, "gpu_ms", gpu);
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+
+        printf("  %-40s cpu %8.3f / %8.3f / %8.3f   gpu %8.3f / %8.3f / %8.3f\n", results[i].model.c_str(),
+               cpu.min, cpu.median, cpu.p99, gpu.min, gpu.median, gpu.p99);
+    }
+
+    fprintf(file, "  ]\n}\n");
+    bool written = !ferror(file);
+    fclose(file);
+    if (written)
+        std::cout << "Benchmark: wrote " << path << std::endl;
+    return written;
+}
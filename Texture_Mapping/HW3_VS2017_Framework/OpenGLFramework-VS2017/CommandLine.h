@@ -0,0 +1,56 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <string>
+
+// Options of the non-interactive modes:
+//     --headless[=egl|osmesa|software] [--output prefix] [--size WxH]
+//         render every model once into prefix_000.ppm, prefix_001.ppm, ... without a window;
+//         software, HW2 only, renders on the CPU without any GL driver
+//     --benchmark[=frames] [--report path]
+//         render every model on a fixed camera path and write the frame times as JSON,
+//         in the window or, with --headless, offscreen
+//     --lights count
+//         HW2 only: light the models by count point and spot lights, culled per model, instead of
+//         one; with --benchmark, every model is measured with 1, 2, 4, ... up to count lights.
+//         At most 255 of the lights reaching a model are shaded, the report names how many were
+//     --deferred
+//         HW2 and HW3: shade the per pixel lighting in a deferred pass over a G-buffer
+//     --prepass
+//         HW2 and HW3: draw the depth of the per pixel view before shading it and print the
+//         fragments this saves, per model or, in the window, every 100 frames
+//     --single-pass
+//         HW2 and HW3: draw both views of the split screen in one instanced pass over the shapes
+struct CommandLineOptions
+{
+    bool headless = false;
+    std::string backend = "egl";
+    std::string output = "thumbnail";
+    int width = 0;  // the window size unless --size is given
+    int height = 0;
+
+    bool benchmark = false;
+    int frames = 100; // measured frames per model
+    std::string report = "benchmark.json";
+
+    int lights = 0; // scene lights of the light list, none without --lights
+    bool deferred = false;
+    bool prepass = false;
+    bool single_pass = false;
+};
+
+// options only some of the apps implement, the others reject them
+enum CommandLineOption
+{
+    OPTION_LIGHTS = 1 << 0,      // --lights, HW2
+    OPTION_DEFERRED = 1 << 1,    // --deferred, HW2 and HW3
+    OPTION_PREPASS = 1 << 2,     // --prepass, HW2 and HW3
+    OPTION_SINGLE_PASS = 1 << 3, // --single-pass, HW2 and HW3
+    OPTION_SOFTWARE = 1 << 4,    // --headless=software, HW2
+};
+
+// Parses argv into options, prints the usage and returns false on unknown arguments. Options of
+// CommandLineOption outside supported are rejected with the apps that have them, and left out of the usage.
+bool ParseCommandLine(int argc, char **argv, CommandLineOptions &options, unsigned supported);
+
+#endif
@@ -0,0 +1,77 @@
+#include "DepthPrepass.h"
+
+void DepthPrepass::beginDepth()
+{
+    if (queries_[0][0] == 0)
+        glGenQueries(SLOTS * 2, &queries_[0][0]);
+    if (pending_[slot_])
+        read(slot_);
+
+    glGetIntegerv(GL_DEPTH_FUNC, &depth_func_);
+    stencil_test_ = glIsEnabled(GL_STENCIL_TEST);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glBeginQuery(GL_SAMPLES_PASSED, queries_[slot_][0]);
+}
+
+void DepthPrepass::beginShading()
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    // the depth buffer already holds the nearest surface, only the fragments of that one pass
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+    // and the first of them marks its pixel as shaded
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_EQUAL, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+    glBeginQuery(GL_SAMPLES_PASSED, queries_[slot_][1]);
+}
+
+void DepthPrepass::end()
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    glDepthFunc(depth_func_);
+    glDepthMask(GL_TRUE);
+    if (!stencil_test_)
+        glDisable(GL_STENCIL_TEST);
+
+    pending_[slot_] = true;
+    slot_ = (slot_ + 1) % SLOTS;
+}
+
+void DepthPrepass::read(int slot)
+{
+    GLuint64 depth = 0, shaded = 0;
+    glGetQueryObjectui64v(queries_[slot][0], GL_QUERY_RESULT, &depth);
+    glGetQueryObjectui64v(queries_[slot][1], GL_QUERY_RESULT, &shaded);
+    depth_fragments_ += depth;
+    shaded_fragments_ += shaded;
+    views_++;
+    pending_[slot] = false;
+}
+
+bool DepthPrepass::statistics(PrepassStatistics &stats, bool wait)
+{
+    // oldest first, the queries of a view finish in the order they were issued
+    for (int i = 0; i < SLOTS; i++)
+    {
+        int slot = (slot_ + i) % SLOTS;
+        if (!pending_[slot])
+            continue;
+        GLuint available = GL_TRUE;
+        if (!wait)
+            glGetQueryObjectuiv(queries_[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        read(slot);
+    }
+
+    if (views_ == 0)
+        return false;
+    stats.views = views_;
+    stats.depth_fragments = static_cast<double>(depth_fragments_) / views_;
+    stats.shaded_fragments = static_cast<double>(shaded_fragments_) / views_;
+    views_ = 0;
+    depth_fragments_ = shaded_fragments_ = 0;
+    return true;
+}
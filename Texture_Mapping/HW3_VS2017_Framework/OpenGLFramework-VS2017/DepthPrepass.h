@@ -0,0 +1,59 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+// Depth pre-pass for the expensive per pixel programs: the shapes are drawn twice, first into the depth
+// buffer only by a program without any lighting, then by the full program with a GL_EQUAL depth test,
+// so that it runs once for every covered pixel however often the model overlaps itself there. Of surfaces
+// at exactly the same depth only the first drawn is shaded, by a stencil test, as with the GL_LESS test of
+// a single pass, so the stencil buffer has to be cleared to 0 before.
+//
+// GL_SAMPLES_PASSED queries count the fragments passing the depth test of each pass. Those of the depth
+// pass, drawn in the same order, are the ones the full program would shade on its own with early depth
+// testing, those of the second pass the ones it shades after the pre-pass.
+
+// fragments of one pre-passed view, averaged over the views read back
+struct PrepassStatistics
+{
+    int views = 0;
+    double depth_fragments = 0;  // passing the depth test of the depth pass
+    double shaded_fragments = 0; // shaded by the full program
+};
+
+class DepthPrepass
+{
+public:
+    DepthPrepass() = default;
+    DepthPrepass(const DepthPrepass &) = delete;
+    DepthPrepass &operator=(const DepthPrepass &) = delete;
+
+    // GL thread, around the draws of one view: beginDepth() turns the color writes off for the depth only program,
+    // beginShading() turns them on again and the depth test to GL_EQUAL for the full one, end() restores the tests
+    void beginDepth();
+    void beginShading();
+    void end();
+
+    // Averages of the views whose queries finished since the last call, waiting for all of them if wait.
+    // Returns false if there are none.
+    bool statistics(PrepassStatistics &stats, bool wait = false);
+
+private:
+    // views in flight, the queries of a slot are read back before it is reused
+    static constexpr int SLOTS = 4;
+
+    void read(int slot);
+
+    // depth and shading pass of every slot, created by the first beginDepth() and kept as long as the context
+    GLuint queries_[SLOTS][2] = {};
+    bool pending_[SLOTS] = {};
+    int slot_ = 0;
+    GLint depth_func_ = GL_LESS;
+    GLboolean stencil_test_ = GL_FALSE;
+
+    int views_ = 0;
+    GLuint64 depth_fragments_ = 0;
+    GLuint64 shaded_fragments_ = 0;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "GBuffer.h"
+
+#include <iostream>
+
+// sampler names of the targets in the lighting pass, by GBufferTarget
+static const char *const SAMPLER_NAMES[GBUFFER_TARGETS] = {"gbufferPosition", "gbufferNormal", "gbufferAmbient", "gbufferDiffuse", "gbufferSpecular"};
+
+void GBuffer::release()
+{
+    if (fbo_ != 0)
+    {
+        glDeleteFramebuffers(1, &fbo_);
+        glDeleteTextures(GBUFFER_TARGETS, textures_);
+        glDeleteRenderbuffers(1, &depth_);
+    }
+    fbo_ = depth_ = 0;
+    for (auto &texture : textures_)
+        texture = 0;
+    complete_ = false;
+}
+
+bool GBuffer::resize(int width, int height)
+{
+    if (fbo_ != 0 && width == width_ && height == height_)
+        return complete_;
+
+    release();
+    width_ = width;
+    height_ = height;
+    if (width <= 0 || height <= 0)
+        return false;
+
+    const GLenum formats[GBUFFER_TARGETS][3] = {
+        {GL_RGBA32F, GL_RGBA, GL_FLOAT},
+        {GL_RGBA16F, GL_RGBA, GL_FLOAT},
+        {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+        {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+        {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+    };
+
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+    GLenum draw_buffers[GBUFFER_TARGETS];
+    glGenTextures(GBUFFER_TARGETS, textures_);
+    for (int i = 0; i < GBUFFER_TARGETS; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0, formats[i][1], formats[i][2], NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures_[i], 0);
+        draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDrawBuffers(GBUFFER_TARGETS, draw_buffers);
+
+    glGenRenderbuffers(1, &depth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+
+    complete_ = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete_)
+        std::cout << "GBuffer: the framebuffer of " << width << "x" << height << " targets is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+    if (vao_ == 0)
+        glGenVertexArrays(1, &vao_);
+    return complete_;
+}
+
+void GBuffer::begin()
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+    // zero alpha in the position target marks the pixels no surface covers
+    const GLfloat zero[4] = {0, 0, 0, 0};
+    const GLfloat far_depth = 1.0f;
+    for (int i = 0; i < GBUFFER_TARGETS; i++)
+        glClearBufferfv(GL_COLOR, i, zero);
+    glClearBufferfv(GL_DEPTH, 0, &far_depth);
+}
+
+void GBuffer::end()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_fbo_);
+}
+
+void GBuffer::drawLighting(GLuint first_unit)
+{
+    for (int i = 0; i < GBUFFER_TARGETS; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + first_unit + i);
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (depth_test)
+        glEnable(GL_DEPTH_TEST);
+}
+
+void GBuffer::setSamplers(GLuint program, GLuint first_unit)
+{
+    for (int i = 0; i < GBUFFER_TARGETS; i++)
+        glUniform1i(glGetUniformLocation(program, SAMPLER_NAMES[i]), first_unit + i);
+}
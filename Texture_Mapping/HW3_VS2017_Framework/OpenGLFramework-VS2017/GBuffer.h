@@ -0,0 +1,67 @@
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+#include <glad/glad.h>
+
+// Deferred shading: a geometry pass writes the inputs of the lighting of every visible surface
+// into the G-buffer, and a lighting pass then shades each covered pixel once, in a single
+// fullscreen triangle, however many fragments were drawn over it.
+
+// values of DEFERRED_PASS in the shaders
+enum DeferredPass
+{
+    DEFERRED_FORWARD = 0,  // lit while rasterizing, no G-buffer
+    DEFERRED_GEOMETRY = 1, // writes the G-buffer targets
+    DEFERRED_LIGHTING = 2  // fullscreen pass reading them back at gl_FragCoord
+};
+
+// render targets of the geometry pass, at these fragment output locations
+enum GBufferTarget
+{
+    GBUFFER_POSITION = 0, // GL_RGBA32F, world position; alpha 1 where a surface was drawn, 0 elsewhere
+    GBUFFER_NORMAL,       // GL_RGBA16F, world normal, not normalized
+    GBUFFER_AMBIENT,      // GL_RGBA8, Ka
+    GBUFFER_DIFFUSE,      // GL_RGBA8, Kd, the albedo
+    GBUFFER_SPECULAR,     // GL_RGBA8, Ks
+    GBUFFER_TARGETS
+};
+
+// The G-buffer targets and their depth buffer, all of the size of the window. The lighting pass reads
+// the target pixel under its fragment, so both passes have to run with the same viewport.
+// The GL objects are kept as long as the context.
+class GBuffer
+{
+public:
+    GBuffer() = default;
+    GBuffer(const GBuffer &) = delete;
+    GBuffer &operator=(const GBuffer &) = delete;
+
+    // (re)create the targets for a window of width x height unless they already have that size,
+    // false if the driver cannot render into them
+    bool resize(int width, int height);
+
+    // geometry pass: draw into the cleared targets until end(), which binds the framebuffer of before again
+    void begin();
+    void end();
+
+    // lighting pass: bind the targets to the texture units first_unit + GBufferTarget and draw
+    // one triangle covering the viewport, without depth test
+    void drawLighting(GLuint first_unit);
+
+    // point the gbuffer* samplers of program at the units of drawLighting(first_unit), program has to be in use
+    static void setSamplers(GLuint program, GLuint first_unit);
+
+private:
+    void release();
+
+    GLuint fbo_ = 0;
+    GLuint textures_[GBUFFER_TARGETS] = {};
+    GLuint depth_ = 0;
+    GLuint vao_ = 0; // without attributes, the triangle comes from gl_VertexID
+    GLint previous_fbo_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    bool complete_ = false;
+};
+
+#endif
@@ -19,8 +19,18 @@
 #ifndef MATH_MATRICES_H
 #define MATH_MATRICES_H
 
+#include <cstddef>
 #include "Vectors.h"
 
+// SIMD bodies of the Matrix4 products; Matrix4::transformPoints() picks the widest kernel at run time
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATH_MATRICES_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MATH_MATRICES_NEON
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 // 2x2 matrix
 ///////////////////////////////////////////////////////////////////////////
@@ -28,40 +38,40 @@ class Matrix2
 {
 public:
     // constructors
-    Matrix2();  // init with identity
-    Matrix2(const float src[4]);
-    Matrix2(float xx, float xy, float yx, float yy);
-
-    void        set(const float src[4]);
-    void        set(float xx, float xy, float yx, float yy);
-    void        setRow(int index, const float row[2]);
-    void        setRow(int index, const Vector2& v);
-    void        setColumn(int index, const float col[2]);
-    void        setColumn(int index, const Vector2& v);
-
-    const float* get() const;
+    constexpr Matrix2();  // init with identity
+    constexpr Matrix2(const float src[4]);
+    constexpr Matrix2(float xx, float xy, float yx, float yy);
+
+    constexpr void        set(const float src[4]);
+    constexpr void        set(float xx, float xy, float yx, float yy);
+    constexpr void        setRow(int index, const float row[2]);
+    constexpr void        setRow(int index, const Vector2& v);
+    constexpr void        setColumn(int index, const float col[2]);
+    constexpr void        setColumn(int index, const Vector2& v);
+
+    constexpr const float* get() const;
     float       getDeterminant();
 
-    Matrix2&    identity();
+    constexpr Matrix2&    identity();
     Matrix2&    transpose();                            // transpose itself and return reference
     Matrix2&    invert();
 
     // operators
-    Matrix2     operator+(const Matrix2& rhs) const;    // add rhs
-    Matrix2     operator-(const Matrix2& rhs) const;    // subtract rhs
-    Matrix2&    operator+=(const Matrix2& rhs);         // add rhs and update this object
-    Matrix2&    operator-=(const Matrix2& rhs);         // subtract rhs and update this object
-    Vector2     operator*(const Vector2& rhs) const;    // multiplication: v' = M * v
-    Matrix2     operator*(const Matrix2& rhs) const;    // multiplication: M3 = M1 * M2
-    Matrix2&    operator*=(const Matrix2& rhs);         // multiplication: M1' = M1 * M2
-    bool        operator==(const Matrix2& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Matrix2& rhs) const;   // exact compare, no epsilon
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Matrix2 operator-(const Matrix2& m);                     // unary operator (-)
-    friend Matrix2 operator*(float scalar, const Matrix2& m);       // pre-multiplication
-    friend Vector2 operator*(const Vector2& vec, const Matrix2& m); // pre-multiplication
+    constexpr Matrix2     operator+(const Matrix2& rhs) const;  // add rhs
+    constexpr Matrix2     operator-(const Matrix2& rhs) const;  // subtract rhs
+    constexpr Matrix2&    operator+=(const Matrix2& rhs);       // add rhs and update this object
+    constexpr Matrix2&    operator-=(const Matrix2& rhs);       // subtract rhs and update this object
+    constexpr Vector2     operator*(const Vector2& rhs) const;  // multiplication: v' = M * v
+    constexpr Matrix2     operator*(const Matrix2& rhs) const;  // multiplication: M3 = M1 * M2
+    constexpr Matrix2&    operator*=(const Matrix2& rhs);       // multiplication: M1' = M1 * M2
+    constexpr bool        operator==(const Matrix2& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Matrix2& rhs) const; // exact compare, no epsilon
+    constexpr float       operator[](int index) const;          // subscript operator v[0], v[1]
+    constexpr float&      operator[](int index);                // subscript operator v[0], v[1]
+
+    friend constexpr Matrix2 operator-(const Matrix2& m);                     // unary operator (-)
+    friend constexpr Matrix2 operator*(float scalar, const Matrix2& m);       // pre-multiplication
+    friend constexpr Vector2 operator*(const Vector2& vec, const Matrix2& m); // pre-multiplication
     friend std::ostream& operator<<(std::ostream& os, const Matrix2& m);
 
 protected:
@@ -80,44 +90,44 @@ class Matrix3
 {
 public:
     // constructors
-    Matrix3();  // init with identity
-    Matrix3(const float src[9]);
-    Matrix3(float xx, float xy, float xz,
-            float yx, float yy, float yz,
-            float zx, float zy, float zz);
-
-    void        set(const float src[9]);
-    void        set(float xx, float xy, float xz,
-                    float yx, float yy, float yz,
-                    float zx, float zy, float zz);
-    void        setRow(int index, const float row[3]);
-    void        setRow(int index, const Vector3& v);
-    void        setColumn(int index, const float col[3]);
-    void        setColumn(int index, const Vector3& v);
-
-    const float* get() const;
+    constexpr Matrix3();  // init with identity
+    constexpr Matrix3(const float src[9]);
+    constexpr Matrix3(float xx, float xy, float xz,
+                      float yx, float yy, float yz,
+                      float zx, float zy, float zz);
+
+    constexpr void        set(const float src[9]);
+    constexpr void        set(float xx, float xy, float xz,
+                              float yx, float yy, float yz,
+                              float zx, float zy, float zz);
+    constexpr void        setRow(int index, const float row[3]);
+    constexpr void        setRow(int index, const Vector3& v);
+    constexpr void        setColumn(int index, const float col[3]);
+    constexpr void        setColumn(int index, const Vector3& v);
+
+    constexpr const float* get() const;
     float       getDeterminant();
 
-    Matrix3&    identity();
+    constexpr Matrix3&    identity();
     Matrix3&    transpose();                            // transpose itself and return reference
     Matrix3&    invert();
 
     // operators
-    Matrix3     operator+(const Matrix3& rhs) const;    // add rhs
-    Matrix3     operator-(const Matrix3& rhs) const;    // subtract rhs
-    Matrix3&    operator+=(const Matrix3& rhs);         // add rhs and update this object
-    Matrix3&    operator-=(const Matrix3& rhs);         // subtract rhs and update this object
-    Vector3     operator*(const Vector3& rhs) const;    // multiplication: v' = M * v
-    Matrix3     operator*(const Matrix3& rhs) const;    // multiplication: M3 = M1 * M2
-    Matrix3&    operator*=(const Matrix3& rhs);         // multiplication: M1' = M1 * M2
-    bool        operator==(const Matrix3& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Matrix3& rhs) const;   // exact compare, no epsilon
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Matrix3 operator-(const Matrix3& m);                     // unary operator (-)
-    friend Matrix3 operator*(float scalar, const Matrix3& m);       // pre-multiplication
-    friend Vector3 operator*(const Vector3& vec, const Matrix3& m); // pre-multiplication
+    constexpr Matrix3     operator+(const Matrix3& rhs) const;  // add rhs
+    constexpr Matrix3     operator-(const Matrix3& rhs) const;  // subtract rhs
+    constexpr Matrix3&    operator+=(const Matrix3& rhs);       // add rhs and update this object
+    constexpr Matrix3&    operator-=(const Matrix3& rhs);       // subtract rhs and update this object
+    constexpr Vector3     operator*(const Vector3& rhs) const;  // multiplication: v' = M * v
+    constexpr Matrix3     operator*(const Matrix3& rhs) const;  // multiplication: M3 = M1 * M2
+    constexpr Matrix3&    operator*=(const Matrix3& rhs);       // multiplication: M1' = M1 * M2
+    constexpr bool        operator==(const Matrix3& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Matrix3& rhs) const; // exact compare, no epsilon
+    constexpr float       operator[](int index) const;          // subscript operator v[0], v[1]
+    constexpr float&      operator[](int index);                // subscript operator v[0], v[1]
+
+    friend constexpr Matrix3 operator-(const Matrix3& m);                     // unary operator (-)
+    friend constexpr Matrix3 operator*(float scalar, const Matrix3& m);       // pre-multiplication
+    friend constexpr Vector3 operator*(const Vector3& vec, const Matrix3& m); // pre-multiplication
     friend std::ostream& operator<<(std::ostream& os, const Matrix3& m);
 
 protected:
@@ -136,30 +146,30 @@ class Matrix4
 {
 public:
     // constructors
-    Matrix4();  // init with identity
-    Matrix4(const float src[16]);
-    Matrix4(float xx, float xy, float xz, float xw,
-            float yx, float yy, float yz, float yw,
-            float zx, float zy, float zz, float zw,
-            float wx, float wy, float wz, float ww);
-
-    void        set(const float src[16]);
-    void        set(float xx, float xy, float xz, float xw,
-                    float yx, float yy, float yz, float yw,
-                    float zx, float zy, float zz, float zw,
-                    float wx, float wy, float wz, float ww);
-    void        setRow(int index, const float row[4]);
-    void        setRow(int index, const Vector4& v);
-    void        setRow(int index, const Vector3& v);
-    void        setColumn(int index, const float col[4]);
-    void        setColumn(int index, const Vector4& v);
-    void        setColumn(int index, const Vector3& v);
-
-    const float* get() const;
-    const float* getTranspose();                        // return transposed matrix
+    constexpr Matrix4();  // init with identity
+    constexpr Matrix4(const float src[16]);
+    constexpr Matrix4(float xx, float xy, float xz, float xw,
+                      float yx, float yy, float yz, float yw,
+                      float zx, float zy, float zz, float zw,
+                      float wx, float wy, float wz, float ww);
+
+    constexpr void        set(const float src[16]);
+    constexpr void        set(float xx, float xy, float xz, float xw,
+                              float yx, float yy, float yz, float yw,
+                              float zx, float zy, float zz, float zw,
+                              float wx, float wy, float wz, float ww);
+    constexpr void        setRow(int index, const float row[4]);
+    constexpr void        setRow(int index, const Vector4& v);
+    constexpr void        setRow(int index, const Vector3& v);
+    constexpr void        setColumn(int index, const float col[4]);
+    constexpr void        setColumn(int index, const Vector4& v);
+    constexpr void        setColumn(int index, const Vector3& v);
+
+    constexpr const float* get() const;
+    constexpr void        getTranspose(float dst[16]) const; // write transposed (column major) matrix to dst
     float        getDeterminant();
 
-    Matrix4&    identity();
+    constexpr Matrix4&    identity();
     Matrix4&    transpose();                            // transpose itself and return reference
     Matrix4&    invert();                               // check best inverse method before inverse
     Matrix4&    invertEuclidean();                      // inverse of Euclidean transform matrix
@@ -179,23 +189,26 @@ public:
     Matrix4&    scale(float sx, float sy, float sz);    // scale by (sx, sy, sz) on each axis
 
     // operators
-    Matrix4     operator+(const Matrix4& rhs) const;    // add rhs
-    Matrix4     operator-(const Matrix4& rhs) const;    // subtract rhs
-    Matrix4&    operator+=(const Matrix4& rhs);         // add rhs and update this object
-    Matrix4&    operator-=(const Matrix4& rhs);         // subtract rhs and update this object
-    Vector4     operator*(const Vector4& rhs) const;    // multiplication: v' = M * v
-    Vector3     operator*(const Vector3& rhs) const;    // multiplication: v' = M * v
-    Matrix4     operator*(const Matrix4& rhs) const;    // multiplication: M3 = M1 * M2
-    Matrix4&    operator*=(const Matrix4& rhs);         // multiplication: M1' = M1 * M2
-    bool        operator==(const Matrix4& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Matrix4& rhs) const;   // exact compare, no epsilon
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Matrix4 operator-(const Matrix4& m);                     // unary operator (-)
-    friend Matrix4 operator*(float scalar, const Matrix4& m);       // pre-multiplication
-    friend Vector3 operator*(const Vector3& vec, const Matrix4& m); // pre-multiplication
-    friend Vector4 operator*(const Vector4& vec, const Matrix4& m); // pre-multiplication
+    constexpr Matrix4     operator+(const Matrix4& rhs) const;  // add rhs
+    constexpr Matrix4     operator-(const Matrix4& rhs) const;  // subtract rhs
+    constexpr Matrix4&    operator+=(const Matrix4& rhs);       // add rhs and update this object
+    constexpr Matrix4&    operator-=(const Matrix4& rhs);       // subtract rhs and update this object
+    Vector4     operator*(const Vector4& rhs) const;            // multiplication: v' = M * v
+    constexpr Vector3     operator*(const Vector3& rhs) const;  // multiplication: v' = M * v
+    Matrix4     operator*(const Matrix4& rhs) const;            // multiplication: M3 = M1 * M2
+    Matrix4&    operator*=(const Matrix4& rhs);                 // multiplication: M1' = M1 * M2
+    constexpr bool        operator==(const Matrix4& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Matrix4& rhs) const; // exact compare, no epsilon
+    constexpr float       operator[](int index) const;          // subscript operator v[0], v[1]
+    constexpr float&      operator[](int index);                // subscript operator v[0], v[1]
+
+    // batched M * (x, y, z, 1): count points of 3 floats in, count vectors of 4 floats out
+    void        transformPoints(const float* in, float* out, size_t count) const;
+
+    friend constexpr Matrix4 operator-(const Matrix4& m);                     // unary operator (-)
+    friend constexpr Matrix4 operator*(float scalar, const Matrix4& m);       // pre-multiplication
+    friend constexpr Vector3 operator*(const Vector3& vec, const Matrix4& m); // pre-multiplication
+    friend constexpr Vector4 operator*(const Vector4& vec, const Matrix4& m); // pre-multiplication
     friend std::ostream& operator<<(std::ostream& os, const Matrix4& m);
 
 protected:
@@ -206,87 +219,86 @@ private:
                             float m6, float m7, float m8);
 
     float m[16];
-    float tm[16];                                       // transpose m
 
 };
 
+static_assert(sizeof(Matrix4) == 16 * sizeof(float), "Matrix4 holds nothing but its elements");
+
 
 
 ///////////////////////////////////////////////////////////////////////////
 // inline functions for Matrix2
 ///////////////////////////////////////////////////////////////////////////
-inline Matrix2::Matrix2()
+// every element is initialized up front, as constant expressions require
+constexpr Matrix2::Matrix2() : m{1, 0,  0, 1}
 {
     // initially identity matrix
-    identity();
 }
 
 
 
-inline Matrix2::Matrix2(const float src[4])
+constexpr Matrix2::Matrix2(const float src[4]) : m{src[0], src[1], src[2], src[3]}
 {
-    set(src);
 }
 
 
 
-inline Matrix2::Matrix2(float xx, float xy, float yx, float yy)
+constexpr Matrix2::Matrix2(float xx, float xy, float yx, float yy) : m{xx, xy, yx, yy}
 {
-    set(xx, xy, yx, yy);
 }
 
 
 
-inline void Matrix2::set(const float src[4])
+constexpr void Matrix2::set(const float src[4])
 {
     m[0] = src[0];  m[1] = src[1];  m[2] = src[2];  m[3] = src[3];
 }
 
 
 
-inline void Matrix2::set(float xx, float xy, float yx, float yy)
+constexpr void Matrix2::set(float xx, float xy, float yx, float yy)
 {
     m[0]= xx;  m[1] = xy;  m[2] = yx;  m[3]= yy;
 }
 
 
 
-inline void Matrix2::setRow(int index, const float row[2])
+constexpr void Matrix2::setRow(int index, const float row[2])
 {
     m[index*2] = row[0];  m[index*2 + 1] = row[1];
 }
 
 
 
-inline void Matrix2::setRow(int index, const Vector2& v)
+constexpr void Matrix2::setRow(int index, const Vector2& v)
 {
     m[index*2] = v.x;  m[index*2 + 1] = v.y;
 }
 
 
 
-inline void Matrix2::setColumn(int index, const float col[2])
+constexpr void Matrix2::setColumn(int index, const float col[2])
 {
     m[index] = col[0];  m[index + 2] = col[1];
 }
 
 
 
-inline void Matrix2::setColumn(int index, const Vector2& v)
+constexpr void Matrix2::setColumn(int index, const Vector2& v)
 {
     m[index] = v.x;  m[index + 2] = v.y;
 }
 
 
 
-inline const float* Matrix2::get() const
+constexpr const float* Matrix2::get() const
 {
     return m;
 }
 
 
 
-inline Matrix2& Matrix2::identity()
+constexpr Matrix2& Matrix2::identity()
 {
     m[0] = m[3] = 1.0f;
     m[1] = m[2] = 0.0f;
@@ -295,21 +307,21 @@ inline Matrix2& Matrix2::identity()
 
 
 
-inline Matrix2 Matrix2::operator+(const Matrix2& rhs) const
+constexpr Matrix2 Matrix2::operator+(const Matrix2& rhs) const
 {
     return Matrix2(m[0]+rhs[0], m[1]+rhs[1], m[2]+rhs[2], m[3]+rhs[3]);
 }
 
 
 
-inline Matrix2 Matrix2::operator-(const Matrix2& rhs) const
+constexpr Matrix2 Matrix2::operator-(const Matrix2& rhs) const
 {
     return Matrix2(m[0]-rhs[0], m[1]-rhs[1], m[2]-rhs[2], m[3]-rhs[3]);
 }
 
 
 
-inline Matrix2& Matrix2::operator+=(const Matrix2& rhs)
+constexpr Matrix2& Matrix2::operator+=(const Matrix2& rhs)
 {
     m[0] += rhs[0];  m[1] += rhs[1];  m[2] += rhs[2];  m[3] += rhs[3];
     return *this;
@@ -317,7 +329,7 @@ inline Matrix2& Matrix2::operator+=(const Matrix2& rhs)
 
 
 
-inline Matrix2& Matrix2::operator-=(const Matrix2& rhs)
+constexpr Matrix2& Matrix2::operator-=(const Matrix2& rhs)
 {
     m[0] -= rhs[0];  m[1] -= rhs[1];  m[2] -= rhs[2];  m[3] -= rhs[3];
     return *this;
@@ -325,14 +337,14 @@ inline Matrix2& Matrix2::operator-=(const Matrix2& rhs)
 
 
 
-inline Vector2 Matrix2::operator*(const Vector2& rhs) const
+constexpr Vector2 Matrix2::operator*(const Vector2& rhs) const
 {
     return Vector2(m[0]*rhs.x + m[1]*rhs.y,  m[2]*rhs.x + m[3]*rhs.y);
 }
 
 
 
-inline Matrix2 Matrix2::operator*(const Matrix2& rhs) const
+constexpr Matrix2 Matrix2::operator*(const Matrix2& rhs) const
 {
     return Matrix2(m[0]*rhs[0] + m[1]*rhs[2],  m[0]*rhs[1] + m[1]*rhs[3],
                    m[2]*rhs[0] + m[3]*rhs[2],  m[2]*rhs[1] + m[3]*rhs[3]);
@@ -340,7 +352,7 @@ inline Matrix2 Matrix2::operator*(const Matrix2& rhs) const
 
 
 
-inline Matrix2& Matrix2::operator*=(const Matrix2& rhs)
+constexpr Matrix2& Matrix2::operator*=(const Matrix2& rhs)
 {
     *this = *this * rhs;
     return *this;
@@ -348,49 +360,49 @@ inline Matrix2& Matrix2::operator*=(const Matrix2& rhs)
 
 
 
-inline bool Matrix2::operator==(const Matrix2& rhs) const
+constexpr bool Matrix2::operator==(const Matrix2& rhs) const
 {
     return (m[0] == rhs[0]) && (m[1] == rhs[1]) && (m[2] == rhs[2]) && (m[3] == rhs[3]);
 }
 
 
 
-inline bool Matrix2::operator!=(const Matrix2& rhs) const
+constexpr bool Matrix2::operator!=(const Matrix2& rhs) const
 {
     return (m[0] != rhs[0]) || (m[1] != rhs[1]) || (m[2] != rhs[2]) || (m[3] != rhs[3]);
 }
 
 
 
-inline float Matrix2::operator[](int index) const
+constexpr float Matrix2::operator[](int index) const
 {
     return m[index];
 }
 
 
 
-inline float& Matrix2::operator[](int index)
+constexpr float& Matrix2::operator[](int index)
 {
     return m[index];
 }
 
 
 
-inline Matrix2 operator-(const Matrix2& rhs)
+constexpr Matrix2 operator-(const Matrix2& rhs)
 {
     return Matrix2(-rhs[0], -rhs[1], -rhs[2], -rhs[3]);
 }
 
 
 
-inline Matrix2 operator*(float s, const Matrix2& rhs)
+constexpr Matrix2 operator*(float s, const Matrix2& rhs)
 {
     return Matrix2(s*rhs[0], s*rhs[1], s*rhs[2], s*rhs[3]);
 }
 
 
 
-inline Vector2 operator*(const Vector2& v, const Matrix2& rhs)
+constexpr Vector2 operator*(const Vector2& v, const Matrix2& rhs)
 {
     return Vector2(v.x*rhs[0] + v.y*rhs[2],  v.x*rhs[1] + v.y*rhs[3]);
 }
@@ -411,31 +423,30 @@ inline std::ostream& operator<<(std::ostream& os, const Matrix2& m)
 ///////////////////////////////////////////////////////////////////////////
 // inline functions for Matrix3
 ///////////////////////////////////////////////////////////////////////////
-inline Matrix3::Matrix3()
+constexpr Matrix3::Matrix3() : m{1, 0, 0,  0, 1, 0,  0, 0, 1}
 {
     // initially identity matrix
-    identity();
 }
 
 
 
-inline Matrix3::Matrix3(const float src[9])
+constexpr Matrix3::Matrix3(const float src[9]) : m{src[0], src[1], src[2],
+                                                   src[3], src[4], src[5],
+                                                   src[6], src[7], src[8]}
 {
-    set(src);
 }
 
 
 
-inline Matrix3::Matrix3(float xx, float xy, float xz,
-                        float yx, float yy, float yz,
-                        float zx, float zy, float zz)
+constexpr Matrix3::Matrix3(float xx, float xy, float xz,
+                           float yx, float yy, float yz,
+                           float zx, float zy, float zz) : m{xx, xy, xz,  yx, yy, yz,  zx, zy, zz}
 {
-    set(xx, xy, xz,  yx, yy, yz,  zx, zy, zz);
 }
 
 
 
-inline void Matrix3::set(const float src[9])
+constexpr void Matrix3::set(const float src[9])
 {
     m[0] = src[0];  m[1] = src[1];  m[2] = src[2];
     m[3] = src[3];  m[4] = src[4];  m[5] = src[5];
@@ -444,9 +455,9 @@ inline void Matrix3::set(const float src[9])
 
 
 
-inline void Matrix3::set(float xx, float xy, float xz,
-                         float yx, float yy, float yz,
-                         float zx, float zy, float zz)
+constexpr void Matrix3::set(float xx, float xy, float xz,
+                            float yx, float yy, float yz,
+                            float zx, float zy, float zz)
 {
     m[0] = xx;  m[1] = xy;  m[2] = xz;
     m[3] = yx;  m[4] = yy;  m[5] = yz;
@@ -455,42 +466,42 @@ inline void Matrix3::set(float xx, float xy, float xz,
 
 
 
-inline void Matrix3::setRow(int index, const float row[3])
+constexpr void Matrix3::setRow(int index, const float row[3])
 {
     m[index*3] = row[0];  m[index*3 + 1] = row[1];  m[index*3 + 2] = row[2];
 }
 
 
 
-inline void Matrix3::setRow(int index, const Vector3& v)
+constexpr void Matrix3::setRow(int index, const Vector3& v)
 {
     m[index*3] = v.x;  m[index*3 + 1] = v.y;  m[index*3 + 2] = v.z;
 }
 
 
 
-inline void Matrix3::setColumn(int index, const float col[3])
+constexpr void Matrix3::setColumn(int index, const float col[3])
 {
     m[index] = col[0];  m[index + 3] = col[1];  m[index + 6] = col[2];
 }
 
 
 
-inline void Matrix3::setColumn(int index, const Vector3& v)
+constexpr void Matrix3::setColumn(int index, const Vector3& v)
 {
     m[index] = v.x;  m[index + 3] = v.y;  m[index + 6] = v.z;
 }
 
 
 
-inline const float* Matrix3::get() const
+constexpr const float* Matrix3::get() const
 {
     return m;
 }
 
 
 
-inline Matrix3& Matrix3::identity()
+constexpr Matrix3& Matrix3::identity()
 {
     m[0] = m[4] = m[8] = 1.0f;
     m[1] = m[2] = m[3] = m[5] = m[6] = m[7] = 0.0f;
@@ -499,7 +510,7 @@ inline Matrix3& Matrix3::identity()
 
 
 
-inline Matrix3 Matrix3::operator+(const Matrix3& rhs) const
+constexpr Matrix3 Matrix3::operator+(const Matrix3& rhs) const
 {
     return Matrix3(m[0]+rhs[0], m[1]+rhs[1], m[2]+rhs[2],
                    m[3]+rhs[3], m[4]+rhs[4], m[5]+rhs[5],
@@ -508,7 +519,7 @@ inline Matrix3 Matrix3::operator+(const Matrix3& rhs) const
 
 
 
-inline Matrix3 Matrix3::operator-(const Matrix3& rhs) const
+constexpr Matrix3 Matrix3::operator-(const Matrix3& rhs) const
 {
     return Matrix3(m[0]-rhs[0], m[1]-rhs[1], m[2]-rhs[2],
                    m[3]-rhs[3], m[4]-rhs[4], m[5]-rhs[5],
@@ -517,7 +528,7 @@ inline Matrix3 Matrix3::operator-(const Matrix3& rhs) const
 
 
 
-inline Matrix3& Matrix3::operator+=(const Matrix3& rhs)
+constexpr Matrix3& Matrix3::operator+=(const Matrix3& rhs)
 {
     m[0] += rhs[0];  m[1] += rhs[1];  m[2] += rhs[2];
     m[3] += rhs[3];  m[4] += rhs[4];  m[5] += rhs[5];
@@ -527,7 +538,7 @@ inline Matrix3& Matrix3::operator+=(const Matrix3& rhs)
 
 
 
-inline Matrix3& Matrix3::operator-=(const Matrix3& rhs)
+constexpr Matrix3& Matrix3::operator-=(const Matrix3& rhs)
 {
     m[0] -= rhs[0];  m[1] -= rhs[1];  m[2] -= rhs[2];
     m[3] -= rhs[3];  m[4] -= rhs[4];  m[5] -= rhs[5];
@@ -537,7 +548,7 @@ inline Matrix3& Matrix3::operator-=(const Matrix3& rhs)
 
 
 
-inline Vector3 Matrix3::operator*(const Vector3& rhs) const
+constexpr Vector3 Matrix3::operator*(const Vector3& rhs) const
 {
     return Vector3(m[0]*rhs.x + m[1]*rhs.y + m[2]*rhs.z,
                    m[3]*rhs.x + m[4]*rhs.y + m[5]*rhs.z,
@@ -546,7 +557,7 @@ inline Vector3 Matrix3::operator*(const Vector3& rhs) const
 
 
 
-inline Matrix3 Matrix3::operator*(const Matrix3& rhs) const
+constexpr Matrix3 Matrix3::operator*(const Matrix3& rhs) const
 {
     return Matrix3(m[0]*rhs[0] + m[1]*rhs[3] + m[2]*rhs[6],  m[0]*rhs[1] + m[1]*rhs[4] + m[2]*rhs[7],  m[0]*rhs[2] + m[1]*rhs[5] + m[2]*rhs[8],
                    m[3]*rhs[0] + m[4]*rhs[3] + m[5]*rhs[6],  m[3]*rhs[1] + m[4]*rhs[4] + m[5]*rhs[7],  m[3]*rhs[2] + m[4]*rhs[5] + m[5]*rhs[8],
@@ -555,7 +566,7 @@ inline Matrix3 Matrix3::operator*(const Matrix3& rhs) const
 
 
 
-inline Matrix3& Matrix3::operator*=(const Matrix3& rhs)
+constexpr Matrix3& Matrix3::operator*=(const Matrix3& rhs)
 {
     *this = *this * rhs;
     return *this;
@@ -563,7 +574,7 @@ inline Matrix3& Matrix3::operator*=(const Matrix3& rhs)
 
 
 
-inline bool Matrix3::operator==(const Matrix3& rhs) const
+constexpr bool Matrix3::operator==(const Matrix3& rhs) const
 {
     return (m[0] == rhs[0]) && (m[1] == rhs[1]) && (m[2] == rhs[2]) &&
            (m[3] == rhs[3]) && (m[4] == rhs[4]) && (m[5] == rhs[5]) &&
@@ -572,7 +583,7 @@ inline bool Matrix3::operator==(const Matrix3& rhs) const
 
 
 
-inline bool Matrix3::operator!=(const Matrix3& rhs) const
+constexpr bool Matrix3::operator!=(const Matrix3& rhs) const
 {
     return (m[0] != rhs[0]) || (m[1] != rhs[1]) || (m[2] != rhs[2]) ||
            (m[3] != rhs[3]) || (m[4] != rhs[4]) || (m[5] != rhs[5]) ||
@@ -581,35 +592,35 @@ inline bool Matrix3::operator!=(const Matrix3& rhs) const
 
 
 
-inline float Matrix3::operator[](int index) const
+constexpr float Matrix3::operator[](int index) const
 {
     return m[index];
 }
 
 
 
-inline float& Matrix3::operator[](int index)
+constexpr float& Matrix3::operator[](int index)
 {
     return m[index];
 }
 
 
 
-inline Matrix3 operator-(const Matrix3& rhs)
+constexpr Matrix3 operator-(const Matrix3& rhs)
 {
     return Matrix3(-rhs[0], -rhs[1], -rhs[2], -rhs[3], -rhs[4], -rhs[5], -rhs[6], -rhs[7], -rhs[8]);
 }
 
 
 
-inline Matrix3 operator*(float s, const Matrix3& rhs)
+constexpr Matrix3 operator*(float s, const Matrix3& rhs)
 {
     return Matrix3(s*rhs[0], s*rhs[1], s*rhs[2], s*rhs[3], s*rhs[4], s*rhs[5], s*rhs[6], s*rhs[7], s*rhs[8]);
 }
 
 
 
-inline Vector3 operator*(const Vector3& v, const Matrix3& m)
+constexpr Vector3 operator*(const Vector3& v, const Matrix3& m)
 {
     return Vector3(v.x*m[0] + v.y*m[3] + v.z*m[6],  v.x*m[1] + v.y*m[4] + v.z*m[7],  v.x*m[2] + v.y*m[5] + v.z*m[8]);
 }
@@ -631,32 +642,32 @@ inline std::ostream& operator<<(std::ostream& os, const Matrix3& m)
 ///////////////////////////////////////////////////////////////////////////
 // inline functions for Matrix4
 ///////////////////////////////////////////////////////////////////////////
-inline Matrix4::Matrix4()
+constexpr Matrix4::Matrix4() : m{1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1}
 {
     // initially identity matrix
-    identity();
 }
 
 
 
-inline Matrix4::Matrix4(const float src[16])
+constexpr Matrix4::Matrix4(const float src[16]) : m{src[0],  src[1],  src[2],  src[3],
+                                                    src[4],  src[5],  src[6],  src[7],
+                                                    src[8],  src[9],  src[10], src[11],
+                                                    src[12], src[13], src[14], src[15]}
 {
-    set(src);
 }
 
 
 
-inline Matrix4::Matrix4(float xx, float xy, float xz, float xw,
-                        float yx, float yy, float yz, float yw,
-                        float zx, float zy, float zz, float zw,
-                        float wx, float wy, float wz, float ww)
+constexpr Matrix4::Matrix4(float xx, float xy, float xz, float xw,
+                           float yx, float yy, float yz, float yw,
+                           float zx, float zy, float zz, float zw,
+                           float wx, float wy, float wz, float ww) : m{xx, xy, xz, xw,  yx, yy, yz, yw,  zx, zy, zz, zw,  wx, wy, wz, ww}
 {
-    set(xx, xy, xz, xw,  yx, yy, yz, yw,  zx, zy, zz, zw,  wx, wy, wz, ww);
 }
 
 
 
-inline void Matrix4::set(const float src[16])
+constexpr void Matrix4::set(const float src[16])
 {
     m[0] = src[0];  m[1] = src[1];  m[2] = src[2];  m[3] = src[3];
     m[4] = src[4];  m[5] = src[5];  m[6] = src[6];  m[7] = src[7];
@@ -666,10 +677,10 @@ inline void Matrix4::set(const float src[16])
 
 
 
-inline void Matrix4::set(float xx, float xy, float xz, float xw,
-                         float yx, float yy, float yz, float yw,
-                         float zx, float zy, float zz, float zw,
-                         float wx, float wy, float wz, float ww)
+constexpr void Matrix4::set(float xx, float xy, float xz, float xw,
+                            float yx, float yy, float yz, float yw,
+                            float zx, float zy, float zz, float zw,
+                            float wx, float wy, float wz, float ww)
 {
     m[0] = xx;  m[1] = xy;  m[2] = xz;  m[3] = xw;
     m[4] = yx;  m[5] = yy;  m[6] = yz;  m[7] = yw;
@@ -679,67 +690,66 @@ inline void Matrix4::set(float xx, float xy, float xz, float xw,
 
 
 
-inline void Matrix4::setRow(int index, const float row[4])
+constexpr void Matrix4::setRow(int index, const float row[4])
 {
     m[index*4] = row[0];  m[index*4 + 1] = row[1];  m[index*4 + 2] = row[2];  m[index*4 + 3] = row[3];
 }
 
 
 
-inline void Matrix4::setRow(int index, const Vector4& v)
+constexpr void Matrix4::setRow(int index, const Vector4& v)
 {
     m[index*4] = v.x;  m[index*4 + 1] = v.y;  m[index*4 + 2] = v.z;  m[index*4 + 3] = v.w;
 }
 
 
 
-inline void Matrix4::setRow(int index, const Vector3& v)
+constexpr void Matrix4::setRow(int index, const Vector3& v)
 {
     m[index*4] = v.x;  m[index*4 + 1] = v.y;  m[index*4 + 2] = v.z;
 }
 
 
 
-inline void Matrix4::setColumn(int index, const float col[4])
+constexpr void Matrix4::setColumn(int index, const float col[4])
 {
     m[index] = col[0];  m[index + 4] = col[1];  m[index + 8] = col[2];  m[index + 12] = col[3];
 }
 
 
 
-inline void Matrix4::setColumn(int index, const Vector4& v)
+constexpr void Matrix4::setColumn(int index, const Vector4& v)
 {
     m[index] = v.x;  m[index + 4] = v.y;  m[index + 8] = v.z;  m[index + 12] = v.w;
 }
 
 
 
-inline void Matrix4::setColumn(int index, const Vector3& v)
+constexpr void Matrix4::setColumn(int index, const Vector3& v)
 {
     m[index] = v.x;  m[index + 4] = v.y;  m[index + 8] = v.z;
 }
 
 
 
-inline const float* Matrix4::get() const
+constexpr const float* Matrix4::get() const
 {
     return m;
 }
 
 
 
-inline const float* Matrix4::getTranspose()
+constexpr void Matrix4::getTranspose(float dst[16]) const
 {
-    tm[0] = m[0];   tm[1] = m[4];   tm[2] = m[8];   tm[3] = m[12];
-    tm[4] = m[1];   tm[5] = m[5];   tm[6] = m[9];   tm[7] = m[13];
-    tm[8] = m[2];   tm[9] = m[6];   tm[10]= m[10];  tm[11]= m[14];
-    tm[12]= m[3];   tm[13]= m[7];   tm[14]= m[11];  tm[15]= m[15];
-    return tm;
+    dst[0] = m[0];   dst[1] = m[4];   dst[2] = m[8];   dst[3] = m[12];
+    dst[4] = m[1];   dst[5] = m[5];   dst[6] = m[9];   dst[7] = m[13];
+    dst[8] = m[2];   dst[9] = m[6];   dst[10]= m[10];  dst[11]= m[14];
+    dst[12]= m[3];   dst[13]= m[7];   dst[14]= m[11];  dst[15]= m[15];
 }
 
 
 
-inline Matrix4& Matrix4::identity()
+constexpr Matrix4& Matrix4::identity()
 {
     m[0] = m[5] = m[10] = m[15] = 1.0f;
     m[1] = m[2] = m[3] = m[4] = m[6] = m[7] = m[8] = m[9] = m[11] = m[12] = m[13] = m[14] = 0.0f;
@@ -748,7 +758,7 @@ inline Matrix4& Matrix4::identity()
 
 
 
-inline Matrix4 Matrix4::operator+(const Matrix4& rhs) const
+constexpr Matrix4 Matrix4::operator+(const Matrix4& rhs) const
 {
     return Matrix4(m[0]+rhs[0],   m[1]+rhs[1],   m[2]+rhs[2],   m[3]+rhs[3],
                    m[4]+rhs[4],   m[5]+rhs[5],   m[6]+rhs[6],   m[7]+rhs[7],
@@ -758,7 +768,7 @@ inline Matrix4 Matrix4::operator+(const Matrix4& rhs) const
 
 
 
-inline Matrix4 Matrix4::operator-(const Matrix4& rhs) const
+constexpr Matrix4 Matrix4::operator-(const Matrix4& rhs) const
 {
     return Matrix4(m[0]-rhs[0],   m[1]-rhs[1],   m[2]-rhs[2],   m[3]-rhs[3],
                    m[4]-rhs[4],   m[5]-rhs[5],   m[6]-rhs[6],   m[7]-rhs[7],
@@ -768,7 +778,7 @@ inline Matrix4 Matrix4::operator-(const Matrix4& rhs) const
 
 
 
-inline Matrix4& Matrix4::operator+=(const Matrix4& rhs)
+constexpr Matrix4& Matrix4::operator+=(const Matrix4& rhs)
 {
     m[0] += rhs[0];    m[1] += rhs[1];    m[2] += rhs[2];    m[3] += rhs[3];
     m[4] += rhs[4];    m[5] += rhs[5];    m[6] += rhs[6];    m[7] += rhs[7];
@@ -779,7 +789,7 @@ inline Matrix4& Matrix4::operator+=(const Matrix4& rhs)
 
 
 
-inline Matrix4& Matrix4::operator-=(const Matrix4& rhs)
+constexpr Matrix4& Matrix4::operator-=(const Matrix4& rhs)
 {
     m[0] -= rhs[0];    m[1] -= rhs[1];    m[2] -= rhs[2];    m[3] -= rhs[3];
     m[4] -= rhs[4];    m[5] -= rhs[5];    m[6] -= rhs[6];    m[7] -= rhs[7];
@@ -792,15 +802,40 @@ inline Matrix4& Matrix4::operator-=(const Matrix4& rhs)
 
 inline Vector4 Matrix4::operator*(const Vector4& rhs) const
 {
+#if defined(MATH_MATRICES_SSE)
+    // sum of the columns scaled by the components, added in the order of the scalar code
+    __m128 c0 = _mm_loadu_ps(&m[0]);
+    __m128 c1 = _mm_loadu_ps(&m[4]);
+    __m128 c2 = _mm_loadu_ps(&m[8]);
+    __m128 c3 = _mm_loadu_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 r = _mm_mul_ps(c0, _mm_set1_ps(rhs.x));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(rhs.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(rhs.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(rhs.w)));
+    float v[4];
+    _mm_storeu_ps(v, r);
+    return Vector4(v[0], v[1], v[2], v[3]);
+#elif defined(MATH_MATRICES_NEON)
+    float32x4x4_t c = vld4q_f32(m);             // de-interleaved rows are the columns
+    float32x4_t r = vmulq_n_f32(c.val[0], rhs.x);
+    r = vmlaq_n_f32(r, c.val[1], rhs.y);
+    r = vmlaq_n_f32(r, c.val[2], rhs.z);
+    r = vmlaq_n_f32(r, c.val[3], rhs.w);
+    float v[4];
+    vst1q_f32(v, r);
+    return Vector4(v[0], v[1], v[2], v[3]);
+#else
     return Vector4(m[0]*rhs.x  + m[1]*rhs.y  + m[2]*rhs.z  + m[3]*rhs.w,
                    m[4]*rhs.x  + m[5]*rhs.y  + m[6]*rhs.z  + m[7]*rhs.w,
                    m[8]*rhs.x  + m[9]*rhs.y  + m[10]*rhs.z + m[11]*rhs.w,
                    m[12]*rhs.x + m[13]*rhs.y + m[14]*rhs.z + m[15]*rhs.w);
+#endif
 }
 
 
 
-inline Vector3 Matrix4::operator*(const Vector3& rhs) const
+constexpr Vector3 Matrix4::operator*(const Vector3& rhs) const
 {
     return Vector3(m[0]*rhs.x + m[1]*rhs.y + m[2]*rhs.z,
                    m[4]*rhs.x + m[5]*rhs.y + m[6]*rhs.z,
@@ -811,10 +846,32 @@ inline Vector3 Matrix4::operator*(const Vector3& rhs) const
 
 inline Matrix4 Matrix4::operator*(const Matrix4& n) const
 {
+#if defined(MATH_MATRICES_SSE) || defined(MATH_MATRICES_NEON)
+    // row i of the product is the rows of n scaled by row i of this matrix
+    float r[16];
+    for(int i = 0; i < 16; i += 4)
+    {
+#if defined(MATH_MATRICES_SSE)
+        __m128 row = _mm_mul_ps(_mm_set1_ps(m[i]), _mm_loadu_ps(&n.m[0]));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m[i+1]), _mm_loadu_ps(&n.m[4])));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m[i+2]), _mm_loadu_ps(&n.m[8])));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m[i+3]), _mm_loadu_ps(&n.m[12])));
+        _mm_storeu_ps(&r[i], row);
+#else
+        float32x4_t row = vmulq_n_f32(vld1q_f32(&n.m[0]), m[i]);
+        row = vmlaq_n_f32(row, vld1q_f32(&n.m[4]), m[i+1]);
+        row = vmlaq_n_f32(row, vld1q_f32(&n.m[8]), m[i+2]);
+        row = vmlaq_n_f32(row, vld1q_f32(&n.m[12]), m[i+3]);
+        vst1q_f32(&r[i], row);
+#endif
+    }
+    return Matrix4(r);
+#else
     return Matrix4(m[0]*n[0]  + m[1]*n[4]  + m[2]*n[8]  + m[3]*n[12],   m[0]*n[1]  + m[1]*n[5]  + m[2]*n[9]  + m[3]*n[13],   m[0]*n[2]  + m[1]*n[6]  + m[2]*n[10]  + m[3]*n[14],   m[0]*n[3]  + m[1]*n[7]  + m[2]*n[11]  + m[3]*n[15],
                    m[4]*n[0]  + m[5]*n[4]  + m[6]*n[8]  + m[7]*n[12],   m[4]*n[1]  + m[5]*n[5]  + m[6]*n[9]  + m[7]*n[13],   m[4]*n[2]  + m[5]*n[6]  + m[6]*n[10]  + m[7]*n[14],   m[4]*n[3]  + m[5]*n[7]  + m[6]*n[11]  + m[7]*n[15],
                    m[8]*n[0]  + m[9]*n[4]  + m[10]*n[8] + m[11]*n[12],  m[8]*n[1]  + m[9]*n[5]  + m[10]*n[9] + m[11]*n[13],  m[8]*n[2]  + m[9]*n[6]  + m[10]*n[10] + m[11]*n[14],  m[8]*n[3]  + m[9]*n[7]  + m[10]*n[11] + m[11]*n[15],
                    m[12]*n[0] + m[13]*n[4] + m[14]*n[8] + m[15]*n[12],  m[12]*n[1] + m[13]*n[5] + m[14]*n[9] + m[15]*n[13],  m[12]*n[2] + m[13]*n[6] + m[14]*n[10] + m[15]*n[14],  m[12]*n[3] + m[13]*n[7] + m[14]*n[11] + m[15]*n[15]);
+#endif
 }
 
 
@@ -827,7 +884,7 @@ inline Matrix4& Matrix4::operator*=(const Matrix4& rhs)
 
 
 
-inline bool Matrix4::operator==(const Matrix4& n) const
+constexpr bool Matrix4::operator==(const Matrix4& n) const
 {
     return (m[0] == n[0])   && (m[1] == n[1])   && (m[2] == n[2])   && (m[3] == n[3]) &&
            (m[4] == n[4])   && (m[5] == n[5])   && (m[6] == n[6])   && (m[7] == n[7]) &&
@@ -837,7 +894,7 @@ inline bool Matrix4::operator==(const Matrix4& n) const
 
 
 
-inline bool Matrix4::operator!=(const Matrix4& n) const
+constexpr bool Matrix4::operator!=(const Matrix4& n) const
 {
     return (m[0] != n[0])   || (m[1] != n[1])   || (m[2] != n[2])   || (m[3] != n[3]) ||
            (m[4] != n[4])   || (m[5] != n[5])   || (m[6] != n[6])   || (m[7] != n[7]) ||
@@ -847,42 +904,42 @@ inline bool Matrix4::operator!=(const Matrix4& n) const
 
 
 
-inline float Matrix4::operator[](int index) const
+constexpr float Matrix4::operator[](int index) const
 {
     return m[index];
 }
 
 
 
-inline float& Matrix4::operator[](int index)
+constexpr float& Matrix4::operator[](int index)
 {
     return m[index];
 }
 
 
 
-inline Matrix4 operator-(const Matrix4& rhs)
+constexpr Matrix4 operator-(const Matrix4& rhs)
 {
     return Matrix4(-rhs[0], -rhs[1], -rhs[2], -rhs[3], -rhs[4], -rhs[5], -rhs[6], -rhs[7], -rhs[8], -rhs[9], -rhs[10], -rhs[11], -rhs[12], -rhs[13], -rhs[14], -rhs[15]);
 }
 
 
 
-inline Matrix4 operator*(float s, const Matrix4& rhs)
+constexpr Matrix4 operator*(float s, const Matrix4& rhs)
 {
     return Matrix4(s*rhs[0], s*rhs[1], s*rhs[2], s*rhs[3], s*rhs[4], s*rhs[5], s*rhs[6], s*rhs[7], s*rhs[8], s*rhs[9], s*rhs[10], s*rhs[11], s*rhs[12], s*rhs[13], s*rhs[14], s*rhs[15]);
 }
 
 
 
-inline Vector4 operator*(const Vector4& v, const Matrix4& m)
+constexpr Vector4 operator*(const Vector4& v, const Matrix4& m)
 {
     return Vector4(v.x*m[0] + v.y*m[4] + v.z*m[8] + v.w*m[12],  v.x*m[1] + v.y*m[5] + v.z*m[9] + v.w*m[13],  v.x*m[2] + v.y*m[6] + v.z*m[10] + v.w*m[14], v.x*m[3] + v.y*m[7] + v.z*m[11] + v.w*m[15]);
 }
 
 
 
-inline Vector3 operator*(const Vector3& v, const Matrix4& m)
+constexpr Vector3 operator*(const Vector3& v, const Matrix4& m)
 {
     return Vector3(v.x*m[0] + v.y*m[4] + v.z*m[8],  v.x*m[1] + v.y*m[5] + v.z*m[9],  v.x*m[2] + v.y*m[6] + v.z*m[10]);
 }
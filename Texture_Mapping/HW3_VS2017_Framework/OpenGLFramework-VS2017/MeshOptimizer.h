@@ -0,0 +1,56 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One attribute of a vertex array, stored as `components` consecutive floats per vertex.
+struct VertexStream
+{
+    const float *data;
+    int components;
+};
+
+// Turns a triangle soup into an indexed mesh: vertices whose values are bitwise equal in
+// every stream are merged. The unique vertices are written to welded[0..stream_count) in order
+// of first use, indices receives one index per input vertex. Returns the unique vertex count.
+size_t WeldVertices(size_t vertex_count, const VertexStream *streams, int stream_count,
+                    std::vector<float> *welded, std::vector<uint32_t> &indices);
+
+// Triangle order optimization of indexed triangle lists, run once when a model is loaded.
+
+// post-transform vertex cache entries assumed by the functions below
+constexpr unsigned int VERTEX_CACHE_SIZE = 16;
+
+// Average cache miss ratio: vertices transformed per triangle on a FIFO vertex cache,
+// between 0.5 (ideal for large meshes) and 3 (no reuse).
+float ComputeACMR(const uint32_t *indices, size_t index_count, size_t vertex_count,
+                  unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles for vertex cache locality (Tipsify, Sander et al. 2007).
+void OptimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count,
+                         unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+// Reorders the clusters of a vertex cache optimized triangle list so clusters facing away from the
+// center of the mesh, which likely occlude the others, are drawn first. Clusters are split until
+// their ACMR reaches threshold times the ACMR of the input. positions has 3 floats per vertex.
+void OptimizeOverdraw(uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+                      float threshold = 1.05f, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+// OptimizeVertexCache followed by OptimizeOverdraw, returns the ACMR before and after.
+void OptimizeTriangleOrder(uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+                           float *acmr_before, float *acmr_after);
+
+// Quantization of vertex attributes for compact vertex buffers.
+
+// rgb in [0, 1] to four normalized GL_UNSIGNED_BYTE components, alpha = 1
+void PackUnorm8(const float *rgb, uint8_t *rgba);
+
+// direction to one GL_INT_2_10_10_10_REV value: normalized, then 10 signed bits per component, w = 0
+uint32_t PackSnorm10(const float *xyz);
+
+// IEEE 754 half float (GL_HALF_FLOAT), rounded to nearest even
+uint16_t FloatToHalf(float value);
+
+#endif
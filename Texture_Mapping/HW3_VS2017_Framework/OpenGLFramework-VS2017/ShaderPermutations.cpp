@@ -0,0 +1,153 @@
+#include "ShaderPermutations.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+
+#include "ProgramCache.h"
+#include "textfile.h"
+
+static bool ReadSource(const std::string &path, std::string &source)
+{
+    char *text = textFileRead(path.c_str());
+    if (text == NULL)
+        return false;
+
+    source = text;
+    free(text);
+    return true;
+}
+
+// #version has to stay the first line, and #line keeps the line numbers of compile errors those of the file
+static std::string Specialize(const std::string &source, const std::string &defines)
+{
+    size_t start = 0;
+    if (source.compare(0, 8, "#version") == 0 && source.find('\n') != std::string::npos)
+        start = source.find('\n') + 1;
+    return source.substr(0, start) + defines + "#line " + std::to_string(start == 0 ? 1 : 2) + "\n" + source.substr(start);
+}
+
+// compile both shaders and link them into p, printing any errors
+static GLint CompileAndLink(GLuint p, const char *vs, const char *fs)
+{
+    GLuint v, f;
+
+    v = glCreateShader(GL_VERTEX_SHADER);
+    f = glCreateShader(GL_FRAGMENT_SHADER);
+
+    glShaderSource(v, 1, &vs, NULL);
+    glShaderSource(f, 1, &fs, NULL);
+
+    GLint success;
+    char infoLog[1000];
+    // compile vertex shader
+    glCompileShader(v);
+    // check for shader compile errors
+    glGetShaderiv(v, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(v, 1000, NULL, infoLog);
+        std::cout << "ERROR: VERTEX SHADER COMPILATION FAILED\n"
+                  << infoLog << std::endl;
+    }
+
+    // compile fragment shader
+    glCompileShader(f);
+    // check for shader compile errors
+    glGetShaderiv(f, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(f, 1000, NULL, infoLog);
+        std::cout << "ERROR: FRAGMENT SHADER COMPILATION FAILED\n"
+                  << infoLog << std::endl;
+    }
+
+    // attach shaders to program object
+    glAttachShader(p, f);
+    glAttachShader(p, v);
+
+    // link program, keeping its binary for the program cache
+    PrepareProgramBinary(p);
+    glLinkProgram(p);
+    // check for linking errors
+    glGetProgramiv(p, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(p, 1000, NULL, infoLog);
+        std::cout << "ERROR: SHADER PROGRAM LINKING FAILED\n"
+                  << infoLog << std::endl;
+    }
+
+    glDeleteShader(v);
+    glDeleteShader(f);
+
+    return success;
+}
+
+bool ShaderPermutations::load(const std::string &vertex_path, const std::string &fragment_path, std::vector<ShaderOption> options,
+                              std::vector<const char *> uniforms, std::function<void(GLuint)> setup)
+{
+    if (!ReadSource(vertex_path, vertex_source_) || !ReadSource(fragment_path, fragment_source_))
+        return false;
+
+    size_t count = 1;
+    for (const auto &option : options)
+        count *= option.count;
+
+    vertex_path_ = vertex_path;
+    options_ = std::move(options);
+    uniforms_ = std::move(uniforms);
+    setup_ = std::move(setup);
+    programs_.assign(count, ShaderProgram());
+    failed_.assign(count, false);
+    return true;
+}
+
+const ShaderProgram *ShaderPermutations::program(std::initializer_list<int> values)
+{
+    // mixed radix index of the values, missing trailing values are 0
+    size_t index = 0;
+    std::string defines;
+    const int *value = values.begin();
+    for (const auto &option : options_)
+    {
+        int v = value != values.end() ? *value++ : 0;
+        index = index * option.count + v;
+        defines += std::string("#define ") + option.name + " " + std::to_string(v) + "\n";
+    }
+
+    ShaderProgram &program = programs_[index];
+    if (program.id != 0)
+        return &program;
+    if (failed_[index])
+        return nullptr;
+
+    std::string vs = Specialize(vertex_source_, defines);
+    std::string fs = Specialize(fragment_source_, defines);
+    std::string cache_path = vertex_path_ + "." + std::to_string(index) + ".programcache";
+
+    GLuint p = glCreateProgram();
+    uint64_t key = ProgramCacheKey(vs.c_str(), fs.c_str());
+    GLint success = LoadProgramBinary(cache_path, key, p);
+    if (!success)
+    {
+        success = CompileAndLink(p, vs.c_str(), fs.c_str());
+        if (success)
+            SaveProgramBinary(cache_path, key, p);
+    }
+
+    if (!success)
+    {
+        std::cout << "ShaderPermutations: cannot build the permutation\n"
+                  << defines << std::flush;
+        glDeleteProgram(p);
+        failed_[index] = true;
+        return nullptr;
+    }
+
+    setup_(p);
+    program.id = p;
+    for (const char *name : uniforms_)
+        program.locations.push_back(glGetUniformLocation(p, name));
+    return &program;
+}
@@ -0,0 +1,51 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// one compile time switch of the shaders, #define name taking the values 0 .. count - 1
+struct ShaderOption
+{
+    const char *name;
+    int count;
+};
+
+// linked program of one permutation
+struct ShaderProgram
+{
+    GLuint id = 0;
+    std::vector<GLint> locations; // of the uniforms passed to load(), -1 where the permutation has none
+};
+
+// Specialized programs built from one vertex and one fragment shader source. Every combination of
+// option values is a permutation whose #defines go right after the #version line. A permutation is
+// compiled the first time it is asked for, through the program binary cache, and kept from then on.
+// Programs are never deleted, they live as long as the context.
+class ShaderPermutations
+{
+public:
+    // read both sources, false if one is missing. setup runs once on every new program, before
+    // its uniform locations are looked up, e.g. for the uniform block bindings
+    bool load(const std::string &vertex_path, const std::string &fragment_path, std::vector<ShaderOption> options,
+              std::vector<const char *> uniforms, std::function<void(GLuint)> setup);
+
+    // the program of one value per option, in the order of the options; nullptr if it does not build
+    const ShaderProgram *program(std::initializer_list<int> values);
+
+private:
+    std::string vertex_path_;
+    std::string vertex_source_;
+    std::string fragment_source_;
+    std::vector<ShaderOption> options_;
+    std::vector<const char *> uniforms_;
+    std::function<void(GLuint)> setup_;
+    std::vector<ShaderProgram> programs_; // by permutation index
+    std::vector<bool> failed_;            // built once without success, not retried
+};
+
+#endif
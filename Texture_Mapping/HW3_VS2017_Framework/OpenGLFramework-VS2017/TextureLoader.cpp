@@ -0,0 +1,330 @@
+#include "TextureLoader.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <STB/stb_image.h>
+#include "MeshCache.h"
+
+constexpr size_t TextureLoader::DEFAULT_UPLOAD_BUDGET;
+
+// lexically normalized path: '/' separators, no "." or "dir/.." components,
+// lower case on Windows where paths are case insensitive
+static std::string CanonicalPath(const std::string &path)
+{
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+    std::vector<std::string> parts;
+    std::string part;
+    for (size_t i = 0; i <= path.size(); i++)
+    {
+        char c = i < path.size() ? path[i] : '/';
+        if (c == '/' || c == '\\')
+        {
+            if (part == "..")
+            {
+                if (!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if (!absolute)
+                    parts.push_back(part);
+            }
+            else if (!part.empty() && part != ".")
+            {
+                parts.push_back(part);
+            }
+            part.clear();
+            continue;
+        }
+#ifdef _WIN32
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+#endif
+        part += c;
+    }
+
+    std::string canonical = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        if (i > 0)
+            canonical += '/';
+        canonical += parts[i];
+    }
+    return canonical;
+}
+
+// whether the file at path holds exactly the bytes of file
+static bool SameContent(const MappedFile &file, const std::string &path)
+{
+    MappedFile other;
+    if (!other.open(path))
+        return false;
+    return other.size() == file.size() && memcmp(other.data(), file.data(), file.size()) == 0;
+}
+
+TextureLoader::TextureLoader(unsigned int thread_count) : pool_(thread_count)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+    // images decoded but never uploaded
+    std::shared_ptr<TextureRequest> request;
+    while (decoded_.try_pop(request))
+    {
+        if (request->pixels != nullptr)
+            stbi_image_free(request->pixels);
+        request->pixels = nullptr;
+    }
+}
+
+void TextureLoader::init()
+{
+    // flip is a global stb_image setting, set it before the workers start decoding
+    stbi_set_flip_vertically_on_load(true);
+
+    const unsigned char white[4] = {255, 255, 255, 255};
+    glGenTextures(1, &placeholder_);
+    glBindTexture(GL_TEXTURE_2D, placeholder_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+    glGenBuffers(2, pbo_);
+}
+
+TextureHandle TextureLoader::load(const std::string &path)
+{
+    std::string canonical = CanonicalPath(path);
+    std::shared_ptr<TextureRequest> request;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        auto it = by_path_.find(canonical);
+        if (it != by_path_.end())
+        {
+            it->second->handles++;
+            it->second->loads++;
+            return TextureHandle(it->second);
+        }
+
+        request = std::make_shared<TextureRequest>();
+        request->path = canonical;
+        request->handles = 1;
+        request->loads = 1;
+        by_path_[canonical] = request;
+    }
+
+    pending_++;
+    pool_.enqueue([this, request]() { decode(request); });
+    return TextureHandle(request);
+}
+
+// decode thread: hash the file and decode it unless an image with the same content is already known
+void TextureLoader::decode(const std::shared_ptr<TextureRequest> &request)
+{
+    MappedFile file;
+    if (file.open(request->path))
+    {
+        request->content_hash = HashBytes(file.data(), file.size());
+        std::shared_ptr<TextureRequest> candidate;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            auto it = by_content_.find(request->content_hash);
+            if (it != by_content_.end())
+                candidate = it->second;
+            else
+                by_content_[request->content_hash] = request;
+        }
+
+        // equal hashes only make a match likely, share the texture once the bytes agree as well;
+        // the candidate still has to be registered then, or it was released in the meantime
+        if (candidate && SameContent(file, candidate->path))
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            auto it = by_content_.find(request->content_hash);
+            if (it != by_content_.end() && it->second == candidate)
+            {
+                request->source = candidate;
+                request->source->users++;
+                request->users--;
+            }
+        }
+
+        if (!request->source)
+        {
+            int channel;
+            int require_channel = 4;
+            request->pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &request->width, &request->height, &channel, require_channel);
+        }
+    }
+    decoded_.push(request);
+}
+
+void TextureLoader::upload(TextureRequest &request)
+{
+    size_t size = size_t(request.width) * size_t(request.height) * 4;
+
+    // alternate between two buffers and orphan the storage, so filling one never waits
+    // for the driver to finish reading the previous upload
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_[next_pbo_]);
+    next_pbo_ ^= 1;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    const void *src = NULL; // offset into the bound unpack buffer
+    if (dst != NULL)
+    {
+        memcpy(dst, request.pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        src = request.pixels;
+    }
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, request.width, request.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, src);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    stbi_image_free(request.pixels);
+    request.pixels = nullptr;
+    request.texture = tex;
+    request.state = TextureRequest::READY;
+}
+
+// a request sharing the content of another one takes over its texture once that is done
+void TextureLoader::finishShared(TextureRequest &request)
+{
+    request.width = request.source->width;
+    request.height = request.source->height;
+    request.texture = request.source->texture;
+    request.state = request.source->state.load();
+}
+
+void TextureLoader::update(size_t byte_budget)
+{
+    bool finished = false;
+    size_t uploaded = 0;
+    std::shared_ptr<TextureRequest> request;
+    while (uploaded < byte_budget && decoded_.try_pop(request))
+    {
+        if (request->source)
+        {
+            waiting_.push_back(request);
+            continue;
+        }
+
+        if (request->pixels == nullptr)
+        {
+            std::cout << "LoadTextureImage: Cannot load image from " << request->path << std::endl;
+            request->state = TextureRequest::FAILED;
+        }
+        else
+        {
+            uploaded += size_t(request->width) * size_t(request->height) * 4;
+            upload(*request);
+        }
+        pending_--;
+        finished = true;
+    }
+
+    for (size_t i = 0; i < waiting_.size();)
+    {
+        if (waiting_[i]->source->state == TextureRequest::LOADING)
+        {
+            i++;
+            continue;
+        }
+        finishShared(*waiting_[i]);
+        waiting_.erase(waiting_.begin() + i);
+        pending_--;
+        finished = true;
+    }
+
+    // forget released requests once they are done; a texture is deleted with the last request using it
+    for (size_t i = 0; i < released_.size();)
+    {
+        std::shared_ptr<TextureRequest> released = released_[i];
+        if (released->state == TextureRequest::LOADING)
+        {
+            i++;
+            continue;
+        }
+        released_.erase(released_.begin() + i);
+
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        if (released->handles > 0)
+            continue; // loaded again in the meantime
+        by_path_.erase(released->path);
+
+        std::shared_ptr<TextureRequest> owner = released->source ? released->source : released;
+        if (--owner->users > 0)
+            continue;
+        auto it = by_content_.find(owner->content_hash);
+        if (it != by_content_.end() && it->second == owner)
+            by_content_.erase(it);
+        if (owner->state == TextureRequest::READY)
+            glDeleteTextures(1, &owner->texture);
+        owner->texture = 0;
+    }
+
+    if (finished && pending_ == 0)
+        printStatistics();
+}
+
+void TextureLoader::release(TextureHandle &handle)
+{
+    if (!handle.request_)
+        return;
+
+    std::shared_ptr<TextureRequest> request = std::move(handle.request_);
+    handle.request_ = nullptr;
+
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    if (--request->handles == 0)
+        released_.push_back(request);
+}
+
+GLuint TextureLoader::texture(const TextureHandle &handle) const
+{
+    if (handle.ready())
+        return handle.request_->texture;
+    return placeholder_;
+}
+
+size_t TextureLoader::bytesSaved() const
+{
+    // every load() beyond the first one of each distinct image would have been another copy in texture memory
+    std::map<const TextureRequest *, int> loads;
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (const auto &entry : by_path_)
+    {
+        const TextureRequest *request = entry.second.get();
+        if (request->state != TextureRequest::READY)
+            continue;
+        loads[request->source ? request->source.get() : request] += request->loads;
+    }
+
+    size_t saved = 0;
+    for (const auto &owner : loads)
+        saved += size_t(owner.second - 1) * size_t(owner.first->width) * size_t(owner.first->height) * 4;
+    return saved;
+}
+
+void TextureLoader::printStatistics() const
+{
+    int requested = 0, images = 0, textures = 0;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (const auto &entry : by_path_)
+        {
+            requested += entry.second->loads;
+            images++;
+            if (!entry.second->source && entry.second->state == TextureRequest::READY)
+                textures++;
+        }
+    }
+
+    printf("TextureLoader: %d textures requested, %d distinct files, %d uploaded, %.2f MB of texture memory saved\n",
+           requested, images, textures, bytesSaved() / (1024.0 * 1024.0));
+}
@@ -0,0 +1,125 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include "ThreadPool.h"
+
+// One image file requested from a TextureLoader, shared by the loader and its handles.
+// Requests of files with identical content share the GL texture of the first one (their source).
+struct TextureRequest
+{
+    enum State
+    {
+        LOADING = 0,
+        READY,
+        FAILED
+    };
+
+    std::string path; // canonical path
+    std::atomic<int> state{LOADING};
+    GLuint texture = 0; // valid once READY
+
+    // set by the decode thread when another request already holds the same content
+    std::shared_ptr<TextureRequest> source;
+    uint64_t content_hash = 0;
+
+    // decoded RGBA pixels, handed from the decode thread to the GL thread
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+
+    // guarded by the loader's registry mutex
+    int handles = 0;  // live load() results for this path
+    int loads = 0;    // every load() of this path, for the statistics
+    int users = 1;    // requests sharing this request's texture, itself included
+};
+
+// Future-like handle of a texture that is decoded and uploaded in the background.
+class TextureHandle
+{
+public:
+    TextureHandle() = default;
+
+    bool valid() const { return request_ != nullptr; }
+    bool ready() const { return request_ && request_->state == TextureRequest::READY; }
+    bool failed() const { return request_ && request_->state == TextureRequest::FAILED; }
+
+private:
+    friend class TextureLoader;
+    explicit TextureHandle(std::shared_ptr<TextureRequest> request) : request_(std::move(request)) {}
+
+    std::shared_ptr<TextureRequest> request_;
+};
+
+// Decodes image files on a worker pool and uploads them through pixel unpack buffers on the GL thread.
+// Until a texture is uploaded (or when it cannot be loaded) a 1x1 white placeholder is bound instead,
+// so rendering can start before any image has been decoded.
+//
+// Textures are registered by canonical path and by content hash: loading a path again returns the
+// same texture, and a different file with the same bytes is neither decoded nor uploaded again.
+// GL textures are reference counted through load() / release().
+class TextureLoader
+{
+public:
+    // about one 1024x1024 RGBA image per frame
+    static constexpr size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+    explicit TextureLoader(unsigned int thread_count = 0);
+    ~TextureLoader();
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    // GL thread, once the context is current and before the first load()
+    void init();
+
+    // queue an image for decoding, safe to call from any thread
+    TextureHandle load(const std::string &path);
+
+    // GL thread: drop a handle returned by load(), the texture is deleted with its last user
+    void release(TextureHandle &handle);
+
+    // GL thread, once per frame: upload decoded images, at least one and about byte_budget bytes at most.
+    // Prints the deduplication statistics whenever the last pending texture is done.
+    void update(size_t byte_budget = DEFAULT_UPLOAD_BUDGET);
+
+    // the texture to bind for handle: the uploaded texture or the placeholder
+    GLuint texture(const TextureHandle &handle) const;
+
+    // number of requested textures that are neither uploaded nor failed
+    size_t pending() const { return pending_; }
+
+    // texture memory (level 0) not allocated thanks to deduplication
+    size_t bytesSaved() const;
+
+private:
+    void decode(const std::shared_ptr<TextureRequest> &request);
+    void upload(TextureRequest &request);
+    void finishShared(TextureRequest &request);
+    void printStatistics() const;
+
+    mutable std::mutex registry_mutex_;
+    std::map<std::string, std::shared_ptr<TextureRequest>> by_path_;
+    std::map<uint64_t, std::shared_ptr<TextureRequest>> by_content_;
+
+    BlockingQueue<std::shared_ptr<TextureRequest>> decoded_;
+    std::vector<std::shared_ptr<TextureRequest>> waiting_;  // GL thread: their source is still loading
+    std::vector<std::shared_ptr<TextureRequest>> released_; // GL thread: no handles left, not yet collected
+    std::atomic<size_t> pending_{0};
+    GLuint placeholder_ = 0;
+    GLuint pbo_[2] = {0, 0};
+    int next_pbo_ = 0;
+
+    // declared last so the workers are joined before the queue they push to is destroyed
+    ThreadPool pool_;
+};
+
+#endif
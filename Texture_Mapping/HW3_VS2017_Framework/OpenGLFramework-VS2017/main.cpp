@@ -1,12 +1,28 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <math.h>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "textfile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Benchmark.h"
+#include "CommandLine.h"
+#include "DepthPrepass.h"
+#include "GBuffer.h"
+#include "Offscreen.h"
+#include "ShaderPermutations.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <STB/stb_image.h>
@@ -23,6 +39,8 @@
 
 using namespace std;
 
+constexpr double PI = 3.14159265358979323846;
+
 // Default window size
 constexpr int WINDOW_WIDTH = 800;
 constexpr int WINDOW_HEIGHT = 600;
@@ -87,7 +105,7 @@ typedef struct
     Vector3 Kd;
     Vector3 Ks;
 
-    GLuint diffuseTexture;
+    TextureHandle diffuseTexture;
 
     // eye texture coordinate
     GLuint isEye = 0;
@@ -106,6 +124,7 @@ typedef struct
     GLuint p_texCoord;
     PhongMaterial material;
     int indexCount;
+    GLintptr materialOffset; // of its MaterialBlock in the model's material buffer
 } Shape;
 
 struct model
@@ -114,13 +133,35 @@ struct model
     Vector3 scale = Vector3(1, 1, 1);
     Vector3 rotation = Vector3(0, 0, 0); // Euler form
 
+    // translate(position) * rotate(rotation) * scaling(scale) and transpose(inverse()) of its upper 3x3,
+    // rebuilt by UpdateModelMatrix() after the callbacks marked them dirty
+    Matrix4 matrix;
+    Matrix3 normalMatrix;
+    bool dirty = true;
+
     vector<Shape> shapes;
+    GLuint materialBuffer = 0; // MaterialBlock of every shape
+    vector<TextureHandle> textures; // one textureLoader.load() per material, the shapes bind copies of them
 
     bool hasEye = false;
     GLint max_eye_offset = 7;
     GLint cur_eye_offset_idx = 0;
 };
 vector<model> models;
+TextureLoader textureLoader;
+
+// interleaved vertex of the packed vertex format, 24 bytes instead of 44 in four float buffers
+struct PackedVertex
+{
+    GLfloat position[3];
+    GLubyte color[4];     // normalized
+    GLuint normal;        // GL_INT_2_10_10_10_REV
+    GLushort texCoord[2]; // half float
+};
+
+// upload shapes as one buffer of PackedVertex instead of one float buffer per attribute
+bool usePackedVertices = true;
+
 int cur_idx = 0; // represent which model should be rendered now
 int cur_eye_offset_idx = 0;
 
@@ -169,55 +210,87 @@ SpotLightInfo spotLightInfo;
 int curLightMode = 0;
 GLfloat shininess;
 
-struct UniformPhongMaterial
+// std140 mirrors of the uniform blocks in shader.vs.glsl / shader.fs.glsl
+struct FrameBlock
 {
-    GLint Ka;
-    GLint Kd;
-    GLint Ks;
+    GLfloat um4p[16];
+    GLfloat um4v[16];
+    GLfloat um4m[16];
+    GLfloat normalMatrix[12]; // mat3, rows padded to vec4
+    GLfloat cameraPosition[3];
+    GLfloat pad0;
 };
 
-struct UniformLightInfo
+struct LightBlock
 {
-    GLint position;
-    GLint ambient;
-    GLint diffuse;
-    GLint specular;
-    GLint attenuationConstant;
-    GLint attenuationLinear;
-    GLint attenuationQuadratic;
+    // LightInfo lightInfo
+    GLfloat position[3], pad0;
+    GLfloat ambient[3], pad1;
+    GLfloat diffuse[3], pad2;
+    GLfloat specular[3];
+    GLfloat attenuationConstant;
+    GLfloat attenuationLinear;
+    GLfloat attenuationQuadratic;
+    GLfloat pad3[2];
+    // SpotLightInfo spotLightInfo
+    GLfloat direction[3];
+    GLfloat exponent;
+    GLfloat cutoff;
+    GLfloat pad4[3];
+
+    GLfloat shininess;
+    GLfloat pad5[3];
 };
 
-struct UniformSpotLightInfo
+struct MaterialBlock
 {
-    GLint direction;
-    GLint exponent;
-    GLint cutoff;
+    // PhongMaterial material
+    GLfloat Ka[3], pad0;
+    GLfloat Kd[3], pad1;
+    GLfloat Ks[3], pad2;
 };
 
-GLuint program;
+static_assert(sizeof(FrameBlock) == 256 && sizeof(LightBlock) == 128 && sizeof(MaterialBlock) == 48, "std140 layout");
 
-// uniforms location
-GLuint iLocP;
-GLuint iLocV;
-GLuint iLocM;
+// binding points of the uniform blocks
+enum UniformBinding
+{
+    FRAME_BINDING = 0,
+    LIGHT_BINDING = 1,
+    MATERIAL_BINDING = 2
+};
 
-struct Uniform
+GLuint frameUniformBuffer;
+GLuint lightUniformBuffer;
+GLint uniformBufferAlignment = 256; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+// one program per light mode, per vertex / per pixel lighting, eye texture offset and deferred pass
+ShaderPermutations shaders;
+
+// the diffuse textures of the shapes are bound to unit 0
+enum TextureUnit
 {
-    GLint iLocCameraPosition;
-    UniformPhongMaterial iLocMaterial;
-    UniformLightInfo iLocLightInfo;
-    UniformSpotLightInfo iLocSpotLightInfo;
-    GLint iLocCurLightMode;
-    GLint iLocShininess;
-    GLint iLocIsPerPixelLighting;
+    GBUFFER_UNIT = 1 // the first of GBUFFER_TARGETS
+};
 
-    /* HW3 added */
-    GLint iLocDiffuseTexture;
-    GLint iLocIsEye;
-    GLint iLocOffsetX;
-    GLint iLocOffsetY;
+// shade the per pixel view in a geometry and a lighting pass instead of while rasterizing, set by --deferred
+bool useDeferredShading = false;
+GBuffer gbuffer;
+
+// draw the depth of the per pixel view first, so its program shades every pixel once, set by --prepass
+bool useDepthPrepass = false;
+DepthPrepass depthPrepass;
+constexpr int PREPASS_REPORT_FRAMES = 100; // between the statistics printed by the window
+
+// draw both views in one pass over the shapes instead of a pass each, set by --single-pass
+bool useSinglePass = false;
+
+// uniforms of the permutations, indices into ShaderProgram::locations
+enum ShaderUniform
+{
+    UNIFORM_OFFSET_X = 0,
+    UNIFORM_OFFSET_Y
 };
-Uniform uniform;
 
 static GLvoid Normalize(GLfloat v[3])
 {
@@ -234,7 +307,7 @@ static GLvoid Cross(GLfloat u[3], GLfloat v[3], GLfloat n[3])
     n[2] = u[0] * v[1] - u[1] * v[0];
 }
 
-Matrix4 translate(Vector3 vec)
+constexpr Matrix4 translate(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -247,7 +320,7 @@ Matrix4 translate(Vector3 vec)
     return mat;
 }
 
-Matrix4 scaling(Vector3 vec)
+constexpr Matrix4 scaling(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -304,6 +377,38 @@ Matrix4 rotate(Vector3 vec)
     return rotateX(vec.x) * rotateY(vec.y) * rotateZ(vec.z);
 }
 
+// translate * rotate * scaling written out, one sine and cosine per axis instead of three matrix products.
+// The normal matrix of R * S is R * inverse(S), R being orthonormal
+void UpdateModelMatrix(model &m)
+{
+    if (!m.dirty)
+        return;
+
+    float sx = sinf(m.rotation.x), cx = cosf(m.rotation.x);
+    float sy = sinf(m.rotation.y), cy = cosf(m.rotation.y);
+    float sz = sinf(m.rotation.z), cz = cosf(m.rotation.z);
+    float R[9] = {
+                        cy * cz,                -cy * sz,       sy,
+         sx * sy * cz + cx * sz, -sx * sy * sz + cx * cz, -sx * cy,
+        -cx * sy * cz + sx * sz,  cx * sy * sz + sx * cz,  cx * cy
+    };
+
+    const Vector3 &s = m.scale;
+    const Vector3 &t = m.position;
+    m.matrix.set(
+        R[0] * s.x, R[1] * s.y, R[2] * s.z, t.x,
+        R[3] * s.x, R[4] * s.y, R[5] * s.z, t.y,
+        R[6] * s.x, R[7] * s.y, R[8] * s.z, t.z,
+                 0,          0,          0,   1
+    );
+    m.normalMatrix.set(
+        R[0] / s.x, R[1] / s.y, R[2] / s.z,
+        R[3] / s.x, R[4] / s.y, R[5] / s.z,
+        R[6] / s.x, R[7] / s.y, R[8] / s.z
+    );
+    m.dirty = false;
+}
+
 void setViewingMatrix()
 {
     float F[3] = {main_camera.position.x - main_camera.center.x, main_camera.position.y - main_camera.center.y, main_camera.position.z - main_camera.center.z};
@@ -404,57 +509,80 @@ void Vector3ToFloat4(Vector3 v, GLfloat res[4])
     res[3] = 1;
 }
 
-inline void transferVector3(GLint location, const Vector3 &v)
+inline void copyVector3(GLfloat *dst, const Vector3 &v)
 {
-    glUniform3f(location, v.x, v.y, v.z);
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
 }
 
-// Render function for display rendering
-void RenderScene(int per_vertex_or_per_pixel)
+// std140 keeps every row of a row_major mat3 in a vec4
+inline void copyMatrix3(GLfloat *dst, const Matrix3 &m)
 {
-    Vector3 modelPos = models[cur_idx].position;
-
-    Matrix4 T, R, S;
-    T = translate(models[cur_idx].position);
-    R = rotate(models[cur_idx].rotation);
-    S = scaling(models[cur_idx].scale);
-
-    // render object
-    Matrix4 model_matrix = T * R * S;
-    glUniformMatrix4fv(iLocM, 1, GL_FALSE, model_matrix.getTranspose());
-    glUniformMatrix4fv(iLocV, 1, GL_FALSE, view_matrix.getTranspose());
-    glUniformMatrix4fv(iLocP, 1, GL_FALSE, project_matrix.getTranspose());
-    transferVector3(uniform.iLocCameraPosition, main_camera.position);
-
-    transferVector3(uniform.iLocLightInfo.position, lightInfo[curLightMode].position);
-    transferVector3(uniform.iLocLightInfo.ambient, lightInfo[curLightMode].ambient);
-    transferVector3(uniform.iLocLightInfo.diffuse, lightInfo[curLightMode].diffuse);
-    transferVector3(uniform.iLocLightInfo.specular, lightInfo[curLightMode].specular);
-    glUniform1f(uniform.iLocLightInfo.attenuationConstant, lightInfo[curLightMode].attenuationConstant);
-    glUniform1f(uniform.iLocLightInfo.attenuationLinear, lightInfo[curLightMode].attenuationLinear);
-    glUniform1f(uniform.iLocLightInfo.attenuationQuadratic, lightInfo[curLightMode].attenuationQuadratic);
+    for (int row = 0; row < 3; row++)
+        memcpy(dst + row * 4, m.get() + row * 3, 3 * sizeof(GLfloat));
+}
 
-    transferVector3(uniform.iLocSpotLightInfo.direction, spotLightInfo.direction);
-    glUniform1f(uniform.iLocSpotLightInfo.exponent, spotLightInfo.exponent);
-    glUniform1f(uniform.iLocSpotLightInfo.cutoff, spotLightInfo.cutoff);
+// upload the frame and light state once per frame, both views read it from the same buffers
+void UpdateUniformBuffers()
+{
+    UpdateModelMatrix(models[cur_idx]);
+    const Matrix4 &model_matrix = models[cur_idx].matrix;
+
+    FrameBlock frame = {};
+    // the Frame block is row_major, so the matrices are copied as they are
+    memcpy(frame.um4m, model_matrix.get(), sizeof(frame.um4m));
+    memcpy(frame.um4v, view_matrix.get(), sizeof(frame.um4v));
+    memcpy(frame.um4p, project_matrix.get(), sizeof(frame.um4p));
+    copyMatrix3(frame.normalMatrix, models[cur_idx].normalMatrix);
+    copyVector3(frame.cameraPosition, main_camera.position);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+
+    const LightInfo &light = lightInfo[curLightMode];
+    LightBlock lightBlock = {};
+    copyVector3(lightBlock.position, light.position);
+    copyVector3(lightBlock.ambient, light.ambient);
+    copyVector3(lightBlock.diffuse, light.diffuse);
+    copyVector3(lightBlock.specular, light.specular);
+    lightBlock.attenuationConstant = light.attenuationConstant;
+    lightBlock.attenuationLinear = light.attenuationLinear;
+    lightBlock.attenuationQuadratic = light.attenuationQuadratic;
+    copyVector3(lightBlock.direction, spotLightInfo.direction);
+    lightBlock.exponent = spotLightInfo.exponent;
+    lightBlock.cutoff = spotLightInfo.cutoff;
+    lightBlock.shininess = shininess;
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lightBlock), &lightBlock);
+}
 
-    glUniform1i(uniform.iLocCurLightMode, curLightMode);
-    glUniform1f(uniform.iLocShininess, shininess);
-    glUniform1i(uniform.iLocIsPerPixelLighting, !per_vertex_or_per_pixel);
+// with split_view both views at once, whichever per_vertex_or_per_pixel, see RenderSplitView()
+void RenderScene(int per_vertex_or_per_pixel, int deferred_pass = DEFERRED_FORWARD, int depth_only = 0, int split_view = 0)
+{
+    int per_pixel = !per_vertex_or_per_pixel && !split_view;
+    GLuint current_program = 0;
+    // the G-buffer and the depth hold the same for every light mode, the depth also for every eye offset
+    int light_mode = deferred_pass == DEFERRED_GEOMETRY || depth_only ? 0 : curLightMode;
 
     for (int i = 0; i < models[cur_idx].shapes.size(); i++)
     {
         const auto &shape = models.at(cur_idx).shapes.at(i);
-        transferVector3(uniform.iLocMaterial.Ka, shape.material.Ka);
-        transferVector3(uniform.iLocMaterial.Kd, shape.material.Kd);
-        transferVector3(uniform.iLocMaterial.Ks, shape.material.Ks);
+        int eye = shape.material.isEye == 1 && !depth_only;
+        const ShaderProgram *program = shaders.program({light_mode, per_pixel, eye, deferred_pass, depth_only, split_view});
+        if (program == nullptr)
+            continue;
+        if (program->id != current_program)
+        {
+            glUseProgram(program->id);
+            current_program = program->id;
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BINDING, models[cur_idx].materialBuffer, shape.materialOffset, sizeof(MaterialBlock));
 
         /* HW3 added */
-        glUniform1i(uniform.iLocIsEye, shape.material.isEye);
-        if (shape.material.isEye == 1)
+        if (eye)
         {
-            glUniform1f(uniform.iLocOffsetX, shape.material.offsets.at(cur_eye_offset_idx).x);
-            glUniform1f(uniform.iLocOffsetY, shape.material.offsets.at(cur_eye_offset_idx).y);
+            glUniform1f(program->locations[UNIFORM_OFFSET_X], shape.material.offsets.at(cur_eye_offset_idx).x);
+            glUniform1f(program->locations[UNIFORM_OFFSET_Y], shape.material.offsets.at(cur_eye_offset_idx).y);
         }
 
         glBindVertexArray(shape.vao);
@@ -463,7 +591,7 @@ void RenderScene(int per_vertex_or_per_pixel)
         // Hint: glActiveTexture, glBindTexture, glTexParameteri
         /* HW3 added */
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, shape.material.diffuseTexture);
+        glBindTexture(GL_TEXTURE_2D, textureLoader.texture(shape.material.diffuseTexture));
 
         if (curMagFilterMode == MagFilterMode::NEAREST)
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -478,10 +606,64 @@ void RenderScene(int per_vertex_or_per_pixel)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-        glDrawArrays(GL_TRIANGLES, 0, shape.vertex_count);
+        if (split_view)
+            glDrawElementsInstanced(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, 0, 2);
+        else
+            glDrawElements(GL_TRIANGLES, shape.indexCount, GL_UNSIGNED_INT, 0);
     }
 }
 
+// Both views in a single pass: every shape is drawn once with two instances over the whole window, the
+// first one moved into the left half and lit per vertex, the second into the right half and lit per pixel,
+// with one texture bind and eye offset for both. GL 3.3 has no viewport arrays, so the vertex shader does
+// the viewport transform of the halves itself.
+void RenderSplitView()
+{
+    glViewport(0, 0, screenWidth, screenHeight);
+    glEnable(GL_CLIP_DISTANCE0);
+    glEnable(GL_CLIP_DISTANCE1);
+    RenderScene(1, DEFERRED_FORWARD, 0, 1);
+    glDisable(GL_CLIP_DISTANCE0);
+    glDisable(GL_CLIP_DISTANCE1);
+}
+
+// The per pixel view after a depth pre-pass, in the current viewport: the shapes are drawn into the depth
+// buffer only, then shaded where they are the nearest surface
+void RenderPrepassed()
+{
+    depthPrepass.beginDepth();
+    RenderScene(0, DEFERRED_FORWARD, 1);
+    depthPrepass.beginShading();
+    RenderScene(0);
+    depthPrepass.end();
+}
+
+// print the fragments the depth pre-pass saved shading since the last report, waiting for them if wait
+void ReportDepthPrepass(const string &label, bool wait)
+{
+    PrepassStatistics stats;
+    if (!depthPrepass.statistics(stats, wait))
+        return;
+    printf("DepthPrepass: %s, %.0f fragments pass the depth test, %.0f shaded, %.2fx fewer (%d frames)\n", label.c_str(),
+           stats.depth_fragments, stats.shaded_fragments, stats.depth_fragments / max(stats.shaded_fragments, 1.0), stats.views);
+}
+
+// Deferred shading of the per pixel view, in the current viewport: the shapes write their textured
+// surfaces into the G-buffer, then one fullscreen pass lights each covered pixel once
+void RenderDeferred()
+{
+    const ShaderProgram *lighting = shaders.program({curLightMode, 1, 0, DEFERRED_LIGHTING});
+    if (lighting == nullptr)
+        return;
+
+    gbuffer.begin();
+    RenderScene(0, DEFERRED_GEOMETRY);
+    gbuffer.end();
+
+    glUseProgram(lighting->id);
+    gbuffer.drawLighting(GBUFFER_UNIT);
+}
+
 // Call back function for keyboard
 void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
@@ -566,6 +748,15 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
             else
                 curMinFilterMode = MinFilterMode::NEAREST_MIPMAP_LINEAR;
             break;
+        case GLFW_KEY_D:
+            useDeferredShading = !useDeferredShading;
+            break;
+        case GLFW_KEY_V:
+            useDepthPrepass = !useDepthPrepass;
+            break;
+        case GLFW_KEY_A:
+            useSinglePass = !useSinglePass;
+            break;
         case GLFW_KEY_RIGHT:
             cur_eye_offset_idx = (cur_eye_offset_idx == 6) ? 0 : cur_eye_offset_idx + 1;
             break;
@@ -600,12 +791,15 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
         break;
     case TransMode::GeoTranslation:
         models[cur_idx].position.z += 0.1 * (float)yoffset;
+        models[cur_idx].dirty = true;
         break;
     case TransMode::GeoScaling:
         models[cur_idx].scale.z += 0.01 * (float)yoffset;
+        models[cur_idx].dirty = true;
         break;
     case TransMode::GeoRotation:
         models[cur_idx].rotation.z += (acosf(-1.0f) / 180.0) * 5 * (float)yoffset;
+        models[cur_idx].dirty = true;
         break;
     case TransMode::LightEdit:
         if (curLightMode == 0 || curLightMode == 1)
@@ -679,14 +873,17 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
             case TransMode::GeoTranslation:
                 models[cur_idx].position.x += -diff_x * (1.0 / 400.0);
                 models[cur_idx].position.y += diff_y * (1.0 / 400.0);
+                models[cur_idx].dirty = true;
                 break;
             case TransMode::GeoScaling:
                 models[cur_idx].scale.x += diff_x * 0.001;
                 models[cur_idx].scale.y += diff_y * 0.001;
+                models[cur_idx].dirty = true;
                 break;
             case TransMode::GeoRotation:
                 models[cur_idx].rotation.x += acosf(-1.0f) / 180.0 * diff_y * (45.0 / 400.0);
                 models[cur_idx].rotation.y += acosf(-1.0f) / 180.0 * diff_x * (45.0 / 400.0);
+                models[cur_idx].dirty = true;
                 break;
             case TransMode::LightEdit:
                 lightInfo[curLightMode].position.x += diff_x / 200.0;
@@ -701,76 +898,31 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
 
 void setShaders()
 {
-    GLuint v, f, p;
-    char *vs = NULL;
-    char *fs = NULL;
-
-    v = glCreateShader(GL_VERTEX_SHADER);
-    f = glCreateShader(GL_FRAGMENT_SHADER);
-
-    vs = textFileRead("shader.vs.glsl");
-    fs = textFileRead("shader.fs.glsl");
-
-    glShaderSource(v, 1, (const GLchar **)&vs, NULL);
-    glShaderSource(f, 1, (const GLchar **)&fs, NULL);
-
-    free(vs);
-    free(fs);
-
-    GLint success;
-    char infoLog[1000];
-    // compile vertex shader
-    glCompileShader(v);
-    // check for shader compile errors
-    glGetShaderiv(v, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(v, 1000, NULL, infoLog);
-        std::cout << "ERROR: VERTEX SHADER COMPILATION FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    // compile fragment shader
-    glCompileShader(f);
-    // check for shader compile errors
-    glGetShaderiv(f, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(f, 1000, NULL, infoLog);
-        std::cout << "ERROR: FRAGMENT SHADER COMPILATION FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    // create program object
-    p = glCreateProgram();
-
-    // attach shaders to program object
-    glAttachShader(p, f);
-    glAttachShader(p, v);
-
-    // link program
-    glLinkProgram(p);
-    // check for linking errors
-    glGetProgramiv(p, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(p, 1000, NULL, infoLog);
-        std::cout << "ERROR: SHADER PROGRAM LINKING FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    glDeleteShader(v);
-    glDeleteShader(f);
+    vector<ShaderOption> options = {{"LIGHT_MODE", 3}, {"PER_PIXEL_LIGHTING", 2}, {"EYE_OFFSET", 2}, {"DEFERRED_PASS", 3}, {"DEPTH_ONLY", 2}, {"SPLIT_VIEW", 2}};
+    bool loaded = shaders.load("shader.vs.glsl", "shader.fs.glsl", options, {"offsetX", "offsetY"}, [](GLuint p) {
+        // the blocks a permutation uses, the deferred lighting pass reads the material from the G-buffer
+        const pair<const char *, GLuint> blocks[] = {{"Frame", FRAME_BINDING}, {"Light", LIGHT_BINDING}, {"Material", MATERIAL_BINDING}};
+        for (const auto &block : blocks)
+        {
+            GLuint index = glGetUniformBlockIndex(p, block.first);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(p, index, block.second);
+        }
+        // and the samplers of the G-buffer in the deferred lighting pass
+        if (glGetUniformLocation(p, "gbufferPosition") != -1)
+        {
+            glUseProgram(p);
+            GBuffer::setSamplers(p, GBUFFER_UNIT);
+        }
+    });
 
-    if (success)
-        glUseProgram(p);
-    else
+    // the other permutations are compiled when first drawn, the plain ones of the first frame right away
+    // so that broken shaders still stop here
+    if (!loaded || shaders.program({curLightMode, 0, 0}) == nullptr || shaders.program({curLightMode, 1, 0}) == nullptr)
     {
         system("pause");
         exit(123);
     }
-
-    program = p;
 }
 
 void normalization(tinyobj::attrib_t *attrib, vector<GLfloat> &vertices, vector<GLfloat> &colors, vector<GLfloat> &normals, vector<GLfloat> &textureCoords, vector<int> &material_id, tinyobj::shape_t *shape)
@@ -906,117 +1058,218 @@ static string GetBaseDir(const string &filepath)
     return "";
 }
 
-GLuint LoadTextureImage(string image_path)
+// vertex streams of the faces that share one material
+struct MaterialStreams
+{
+    int material_id;
+    vector<GLfloat> vertices, colors, normals, textureCoords;
+    vector<uint32_t> indices;
+};
+
+// Counting sort of the vertices by material: one pass counts the vertices of every material so each
+// bucket is allocated once, a second pass scatters the vertices into their bucket.
+vector<MaterialStreams> SplitShapeByMaterial(vector<GLfloat> &vertices, vector<GLfloat> &colors, vector<GLfloat> &normals, vector<GLfloat> &textureCoords, vector<int> &material_id, const vector<CachedMaterial> &materials)
 {
-    int channel, width, height;
-    int require_channel = 4;
-    stbi_set_flip_vertically_on_load(true);
-    stbi_uc *data = stbi_load(image_path.c_str(), &width, &height, &channel, require_channel);
-    if (data != NULL)
+    // material ids are ints, -1 for faces without one
+    int material_count = static_cast<int>(materials.size());
+    vector<size_t> count(material_count, 0);
+    for (int m : material_id)
     {
-        GLuint tex = 0;
+        // vertices without a valid material are dropped
+        if (m >= 0 && m < material_count)
+            count[m]++;
+    }
 
-        // [TODO] Bind the image to texture
-        // Hint: glGenTextures, glBindTexture, glTexImage2D, glGenerateMipmap
-        /* HW3 added */
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // free the image from memory after binding to texture
-        stbi_image_free(data);
-        return tex;
+    // bucket of every material, only materials that are used get one
+    vector<MaterialStreams> res;
+    vector<int> bucket(material_count, -1);
+    for (int m = 0; m < material_count; m++)
+    {
+        if (count[m] == 0)
+            continue;
+        bucket[m] = static_cast<int>(res.size());
+
+        MaterialStreams split;
+        split.material_id = m;
+        split.vertices.resize(count[m] * 3);
+        split.colors.resize(count[m] * 3);
+        split.normals.resize(count[m] * 3);
+        split.textureCoords.resize(count[m] * 2);
+        res.push_back(std::move(split));
     }
-    else
+
+    vector<size_t> fill(res.size(), 0);
+    for (size_t v = 0; v < material_id.size(); v++)
     {
-        cout << "LoadTextureImage: Cannot load image from " << image_path << endl;
-        return -1;
+        int m = material_id[v];
+        if (m < 0 || m >= material_count)
+            continue;
+
+        MaterialStreams &split = res[bucket[m]];
+        size_t i = fill[bucket[m]]++;
+        memcpy(&split.vertices[i * 3], &vertices[v * 3], 3 * sizeof(GLfloat));
+        memcpy(&split.colors[i * 3], &colors[v * 3], 3 * sizeof(GLfloat));
+        memcpy(&split.normals[i * 3], &normals[v * 3], 3 * sizeof(GLfloat));
+        memcpy(&split.textureCoords[i * 2], &textureCoords[v * 2], 2 * sizeof(GLfloat));
     }
+
+    return res;
 }
 
-vector<Shape> SplitShapeByMaterial(vector<GLfloat> &vertices, vector<GLfloat> &colors, vector<GLfloat> &normals, vector<GLfloat> &textureCoords, vector<int> &material_id, vector<PhongMaterial> &materials)
+// replace the triangle soup of split by its unique vertices and an index list
+void WeldMaterialStreams(MaterialStreams &split)
 {
-    vector<Shape> res;
-    for (int m = 0; m < materials.size(); m++)
+    VertexStream soup[MESH_STREAM_COUNT] = {{split.vertices.data(), 3}, {split.colors.data(), 3}, {split.normals.data(), 3}, {split.textureCoords.data(), 2}};
+    vector<GLfloat> welded[MESH_STREAM_COUNT];
+    WeldVertices(split.vertices.size() / 3, soup, MESH_STREAM_COUNT, welded, split.indices);
+
+    split.vertices.swap(welded[MESH_POSITION]);
+    split.colors.swap(welded[MESH_COLOR]);
+    split.normals.swap(welded[MESH_NORMAL]);
+    split.textureCoords.swap(welded[MESH_TEXCOORD]);
+}
+
+vector<PackedVertex> PackVertices(const CachedShape &streams)
+{
+    vector<PackedVertex> packed(streams.length[MESH_POSITION] / 3);
+    for (size_t v = 0; v < packed.size(); v++)
     {
-        vector<GLfloat> m_vertices, m_colors, m_normals, m_textureCoords;
-        for (int v = 0; v < material_id.size(); v++)
-        {
-            // extract all vertices with same material id and create a new shape for it.
-            if (material_id[v] == m)
-            {
-                m_vertices.push_back(vertices[v * 3 + 0]);
-                m_vertices.push_back(vertices[v * 3 + 1]);
-                m_vertices.push_back(vertices[v * 3 + 2]);
+        memcpy(packed[v].position, streams.stream[MESH_POSITION] + v * 3, sizeof(packed[v].position));
+        PackUnorm8(streams.stream[MESH_COLOR] + v * 3, packed[v].color);
+        packed[v].normal = PackSnorm10(streams.stream[MESH_NORMAL] + v * 3);
+        packed[v].texCoord[0] = FloatToHalf(streams.stream[MESH_TEXCOORD][v * 2 + 0]);
+        packed[v].texCoord[1] = FloatToHalf(streams.stream[MESH_TEXCOORD][v * 2 + 1]);
+    }
+    return packed;
+}
+
+Shape CreateShape(const CachedShape &streams, const PhongMaterial &material)
+{
+    Shape tmp_shape;
+    glGenVertexArrays(1, &tmp_shape.vao);
+    glBindVertexArray(tmp_shape.vao);
+    tmp_shape.vertex_count = streams.length[MESH_POSITION] / 3;
+
+    if (usePackedVertices)
+    {
+        vector<PackedVertex> packed = PackVertices(streams);
+        GLsizei stride = sizeof(PackedVertex);
+
+        glGenBuffers(1, &tmp_shape.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(PackedVertex, color));
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, texCoord));
+    }
+    else
+    {
+        glGenBuffers(1, &tmp_shape.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_POSITION] * sizeof(GLfloat), streams.stream[MESH_POSITION], GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glGenBuffers(1, &tmp_shape.p_color);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_color);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_COLOR] * sizeof(GLfloat), streams.stream[MESH_COLOR], GL_STATIC_DRAW);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glGenBuffers(1, &tmp_shape.p_normal);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_normal);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_NORMAL] * sizeof(GLfloat), streams.stream[MESH_NORMAL], GL_STATIC_DRAW);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glGenBuffers(1, &tmp_shape.p_texCoord);
+        glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_texCoord);
+        glBufferData(GL_ARRAY_BUFFER, streams.length[MESH_TEXCOORD] * sizeof(GLfloat), streams.stream[MESH_TEXCOORD], GL_STATIC_DRAW);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    }
 
-                m_colors.push_back(colors[v * 3 + 0]);
-                m_colors.push_back(colors[v * 3 + 1]);
-                m_colors.push_back(colors[v * 3 + 2]);
+    glGenBuffers(1, &tmp_shape.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tmp_shape.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, streams.index_count * sizeof(GLuint), streams.indices, GL_STATIC_DRAW);
+    tmp_shape.indexCount = streams.index_count;
 
-                m_normals.push_back(normals[v * 3 + 0]);
-                m_normals.push_back(normals[v * 3 + 1]);
-                m_normals.push_back(normals[v * 3 + 2]);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
 
-                m_textureCoords.push_back(textureCoords[v * 2 + 0]);
-                m_textureCoords.push_back(textureCoords[v * 2 + 1]);
-            }
-        }
+    tmp_shape.material = material;
+    return tmp_shape;
+}
 
-        if (!m_vertices.empty())
-        {
-            Shape tmp_shape;
-            glGenVertexArrays(1, &tmp_shape.vao);
-            glBindVertexArray(tmp_shape.vao);
-
-            glGenBuffers(1, &tmp_shape.vbo);
-            glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.vbo);
-            glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(GL_FLOAT), &m_vertices.at(0), GL_STATIC_DRAW);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            tmp_shape.vertex_count = m_vertices.size() / 3;
-
-            glGenBuffers(1, &tmp_shape.p_color);
-            glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_color);
-            glBufferData(GL_ARRAY_BUFFER, m_colors.size() * sizeof(GL_FLOAT), &m_colors.at(0), GL_STATIC_DRAW);
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-            glGenBuffers(1, &tmp_shape.p_normal);
-            glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_normal);
-            glBufferData(GL_ARRAY_BUFFER, m_normals.size() * sizeof(GL_FLOAT), &m_normals.at(0), GL_STATIC_DRAW);
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-            glGenBuffers(1, &tmp_shape.p_texCoord);
-            glBindBuffer(GL_ARRAY_BUFFER, tmp_shape.p_texCoord);
-            glBufferData(GL_ARRAY_BUFFER, m_textureCoords.size() * sizeof(GL_FLOAT), &m_textureCoords.at(0), GL_STATIC_DRAW);
-            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-            glEnableVertexAttribArray(0);
-            glEnableVertexAttribArray(1);
-            glEnableVertexAttribArray(2);
-            glEnableVertexAttribArray(3);
-
-            tmp_shape.material = materials[m];
-            res.push_back(tmp_shape);
-        }
+PhongMaterial LoadPhongMaterial(const CachedMaterial &cached, const TextureHandle &texture, model &tmp_model)
+{
+    PhongMaterial material;
+    material.Ka = Vector3(cached.ambient[0], cached.ambient[1], cached.ambient[2]);
+    material.Kd = Vector3(cached.diffuse[0], cached.diffuse[1], cached.diffuse[2]);
+    material.Ks = Vector3(cached.specular[0], cached.specular[1], cached.specular[2]);
+
+    // the texture itself is still decoding, the placeholder is bound until textureLoader uploads it
+    material.diffuseTexture = texture;
+
+    /* HW3 added */
+    if (cached.diffuse_texname.find("EyeDh") != string::npos)
+    {
+        tmp_model.hasEye = true;
+        material.isEye = 1;
+        material.offsets = {{0.0f, 0.0f}, {0.0f, 0.75f}, {0.0f, 0.5f}, {0.0f, 0.25f},
+                            {0.5f, 0.0f}, {0.5f, 0.75f}, {0.5f, 0.5f}, {0.5f, 0.25f}};
     }
 
-    return res;
+    return material;
+}
+
+// pack the materials of all shapes of a model into one uniform buffer, bound per draw with glBindBufferRange
+void CreateMaterialBuffer(model &tmp_model)
+{
+    GLintptr stride = (sizeof(MaterialBlock) + uniformBufferAlignment - 1) / uniformBufferAlignment * uniformBufferAlignment;
+    vector<unsigned char> data(tmp_model.shapes.size() * stride, 0);
+    for (int i = 0; i < tmp_model.shapes.size(); i++)
+    {
+        Shape &shape = tmp_model.shapes[i];
+        shape.materialOffset = i * stride;
+
+        MaterialBlock block = {};
+        copyVector3(block.Ka, shape.material.Ka);
+        copyVector3(block.Kd, shape.material.Kd);
+        copyVector3(block.Ks, shape.material.Ks);
+        memcpy(&data[shape.materialOffset], &block, sizeof(block));
+    }
+
+    glGenBuffers(1, &tmp_model.materialBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, tmp_model.materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
 }
 
-void LoadTexturedModels(string model_path)
+// CPU side of one model, filled on a loader thread and uploaded by the GL thread
+struct ModelData
 {
-    vector<tinyobj::shape_t> shapes;
-    vector<tinyobj::material_t> materials;
-    tinyobj::attrib_t attrib;
-    vector<GLfloat> vertices;
-    vector<GLfloat> colors;
-    vector<GLfloat> normals;
-    vector<GLfloat> textureCoords;
-    vector<int> material_id;
+    bool ok = false;
+    string messages; // printed by the GL thread, loader threads never write to cout
+    string errors;
 
-    string err;
-    string warn;
+    MeshCacheReader cache;          // warm start: the shape streams point into the mapped cache file
+    vector<MaterialStreams> splits; // cold start: the shape streams point into these
+    vector<CachedMaterial> materials;
+    vector<CachedShape> shapes;
 
+    // diffuse texture of each material, requested as soon as the materials are known
+    vector<TextureHandle> textures;
+};
+
+// start decoding the diffuse textures of the materials on the texture loader pool
+void RequestTextures(ModelData &data, const string &base_dir)
+{
+    for (const auto &material : data.materials)
+        data.textures.push_back(textureLoader.load(base_dir + material.diffuse_texname));
+}
+
+// runs on a loader thread: parse (or map the cache of) one .obj file and request its textures, no GL calls
+void ParseTexturedModel(const string &model_path, ModelData &data)
+{
     string base_dir = GetBaseDir(model_path); // handle .mtl with relative path
 
 #ifdef _WIN32
@@ -1025,73 +1278,175 @@ void LoadTexturedModels(string model_path)
     base_dir += "/";
 #endif
 
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str(), base_dir.c_str());
-
-    if (!warn.empty())
+    string cache_path = GetMeshCachePath(model_path);
+    uint64_t source_hash = 0;
+    bool hashed = HashModelContent(model_path, &source_hash);
+    if (hashed && data.cache.open(cache_path, source_hash))
     {
-        cout << warn << std::endl;
+        data.messages += "Load Models From Cache ! Shapes size " + to_string(data.cache.shapes().size()) +
+                         " Material size " + to_string(data.cache.materials().size()) + "\n";
+        data.materials = data.cache.materials();
+        data.shapes = data.cache.shapes();
+        RequestTextures(data, base_dir);
     }
-
-    if (!err.empty())
+    else
     {
-        cerr << err << std::endl;
-    }
+        tinyobj::ObjReaderConfig reader_config;
+        reader_config.mtl_search_path = base_dir;
+        // already one of the loader pool's jobs, a parallel parse would start a thread per hardware thread in each
+        reader_config.num_threads = 1;
 
-    if (!ret)
-    {
-        exit(1);
-    }
+        tinyobj::ObjReader reader;
+        bool ret = reader.ParseFromFile(model_path, reader_config);
 
-    printf("Load Models Success ! Shapes size %d Material size %d\n", shapes.size(), materials.size());
-    model tmp_model;
+        if (!reader.Warning().empty())
+            data.messages += reader.Warning() + "\n";
 
-    vector<PhongMaterial> allMaterial;
-    for (int i = 0; i < materials.size(); i++)
-    {
-        PhongMaterial material;
-        material.Ka = Vector3(materials[i].ambient[0], materials[i].ambient[1], materials[i].ambient[2]);
-        material.Kd = Vector3(materials[i].diffuse[0], materials[i].diffuse[1], materials[i].diffuse[2]);
-        material.Ks = Vector3(materials[i].specular[0], materials[i].specular[1], materials[i].specular[2]);
+        if (!reader.Error().empty())
+            data.errors += reader.Error() + "\n";
+
+        if (!ret)
+            return;
+
+        tinyobj::attrib_t attrib = reader.TakeAttrib();
+        vector<tinyobj::shape_t> shapes = reader.TakeShapes();
+        const vector<tinyobj::material_t> &materials = reader.GetMaterials();
+
+        data.messages += "Load Models Success ! Shapes size " + to_string(shapes.size()) +
+                         " Material size " + to_string(materials.size()) + "\n";
 
-        material.diffuseTexture = LoadTextureImage(base_dir + string(materials[i].diffuse_texname));
-        if (material.diffuseTexture == -1)
+        for (int i = 0; i < materials.size(); i++)
         {
-            cout << "LoadTexturedModels: Fail to load model's material " << i << endl;
-            system("pause");
+            CachedMaterial material;
+            for (int c = 0; c < 3; c++)
+            {
+                material.ambient[c] = materials[i].ambient[c];
+                material.diffuse[c] = materials[i].diffuse[c];
+                material.specular[c] = materials[i].specular[c];
+            }
+            material.diffuse_texname = materials[i].diffuse_texname;
+            data.materials.push_back(material);
         }
+        RequestTextures(data, base_dir);
+
+        vector<GLfloat> vertices;
+        vector<GLfloat> colors;
+        vector<GLfloat> normals;
+        vector<GLfloat> textureCoords;
+        vector<int> material_id;
+        for (int i = 0; i < shapes.size(); i++)
+        {
+            vertices.clear();
+            colors.clear();
+            normals.clear();
+            textureCoords.clear();
+            material_id.clear();
 
-        /* HW3 added */
-        if (string(materials[i].diffuse_texname).find("EyeDh") != string::npos)
+            normalization(&attrib, vertices, colors, normals, textureCoords, material_id, &shapes[i]);
+            // printf("Vertices size: %d", vertices.size() / 3);
+
+            // split current shape into multiple shapes base on material_id.
+            vector<MaterialStreams> splitedShapeByMaterial = SplitShapeByMaterial(vertices, colors, normals, textureCoords, material_id, data.materials);
+
+            // concatenate splited shape to model's shape list
+            for (auto &split : splitedShapeByMaterial)
+            {
+                WeldMaterialStreams(split);
+                data.splits.push_back(std::move(split));
+            }
+        }
+
+        // reorder the triangles of every shape for the vertex cache and then for overdraw
+        float faces = 0.0f, missesBefore = 0.0f, missesAfter = 0.0f;
+        for (auto &split : data.splits)
         {
-            tmp_model.hasEye = true;
-            material.isEye = 1;
-            material.offsets = {{0.0f, 0.0f}, {0.0f, 0.75f}, {0.0f, 0.5f}, {0.0f, 0.25f},
-                                {0.5f, 0.0f}, {0.5f, 0.75f}, {0.5f, 0.5f}, {0.5f, 0.25f}};
+            float before, after;
+            OptimizeTriangleOrder(split.indices.data(), split.indices.size(), split.vertices.data(), split.vertices.size() / 3, &before, &after);
+            faces += split.indices.size() / 3;
+            missesBefore += before * (split.indices.size() / 3);
+            missesAfter += after * (split.indices.size() / 3);
+        }
+        if (faces > 0.0f)
+        {
+            char acmr[64];
+            snprintf(acmr, sizeof(acmr), "ACMR %.3f -> %.3f", missesBefore / faces, missesAfter / faces);
+            data.messages += "Optimize Models Success ! " + string(acmr) + "\n";
         }
 
-        allMaterial.push_back(material);
+        for (const auto &split : data.splits)
+        {
+            CachedShape streams;
+            streams.material_id = split.material_id;
+            streams.stream[MESH_POSITION] = split.vertices.data();
+            streams.stream[MESH_COLOR] = split.colors.data();
+            streams.stream[MESH_NORMAL] = split.normals.data();
+            streams.stream[MESH_TEXCOORD] = split.textureCoords.data();
+            streams.length[MESH_POSITION] = static_cast<uint32_t>(split.vertices.size());
+            streams.length[MESH_COLOR] = static_cast<uint32_t>(split.colors.size());
+            streams.length[MESH_NORMAL] = static_cast<uint32_t>(split.normals.size());
+            streams.length[MESH_TEXCOORD] = static_cast<uint32_t>(split.textureCoords.size());
+            streams.indices = split.indices.data();
+            streams.index_count = static_cast<uint32_t>(split.indices.size());
+            data.shapes.push_back(streams);
+        }
+
+        if (hashed && !WriteMeshCache(cache_path, source_hash, data.materials, data.shapes))
+            data.messages += "LoadTexturedModels: Cannot write mesh cache " + cache_path + "\n";
     }
 
-    for (int i = 0; i < shapes.size(); i++)
-    {
-        vertices.clear();
-        colors.clear();
-        normals.clear();
-        textureCoords.clear();
-        material_id.clear();
+    data.ok = true;
+}
 
-        normalization(&attrib, vertices, colors, normals, textureCoords, material_id, &shapes[i]);
-        // printf("Vertices size: %d", vertices.size() / 3);
+// runs on the GL thread: create the textures and vertex buffers of a parsed model,
+// returns false if it could not be loaded
+bool UploadTexturedModel(ModelData &data, model &tmp_model)
+{
+    cout << data.messages;
+    cerr << data.errors;
+    if (!data.ok)
+        return false;
+
+    vector<PhongMaterial> allMaterial;
+    for (int i = 0; i < data.materials.size(); i++)
+        allMaterial.push_back(LoadPhongMaterial(data.materials[i], data.textures[i], tmp_model));
+    tmp_model.textures = data.textures;
+
+    for (const auto &streams : data.shapes)
+        tmp_model.shapes.push_back(CreateShape(streams, allMaterial.at(streams.material_id)));
+    CreateMaterialBuffer(tmp_model);
+    return true;
+}
+
+// Parses the models on a thread pool while this (GL) thread uploads every model as soon as it is ready,
+// so the startup time approaches the time of the slowest model instead of the sum of all of them.
+// The models keep the order of model_paths. Returns false if any of them could not be loaded, only once
+// all of them are done and the pool is joined, so that the caller can exit safely.
+bool LoadTexturedModels(const vector<string> &model_paths)
+{
+    typedef pair<size_t, unique_ptr<ModelData>> LoadedModel;
+    BlockingQueue<LoadedModel> loaded;
+
+    size_t first = models.size();
+    models.resize(first + model_paths.size());
 
-        // split current shape into multiple shapes base on material_id.
-        vector<Shape> splitedShapeByMaterial = SplitShapeByMaterial(vertices, colors, normals, textureCoords, material_id, allMaterial);
+    ThreadPool pool;
+    for (size_t i = 0; i < model_paths.size(); i++)
+    {
+        pool.enqueue([&loaded, &model_paths, i]() {
+            unique_ptr<ModelData> data(new ModelData);
+            ParseTexturedModel(model_paths[i], *data);
+            loaded.push(LoadedModel(i, std::move(data)));
+        });
+    }
 
-        // concatenate splited shape to model's shape list
-        tmp_model.shapes.insert(tmp_model.shapes.end(), splitedShapeByMaterial.begin(), splitedShapeByMaterial.end());
+    bool ok = true;
+    for (size_t n = 0; n < model_paths.size(); n++)
+    {
+        LoadedModel item = loaded.pop();
+        if (!UploadTexturedModel(*item.second, models[first + item.first]))
+            ok = false;
     }
-    shapes.clear();
-    materials.clear();
-    models.push_back(tmp_model);
+    return ok;
 }
 
 void initParameter()
@@ -1145,40 +1500,44 @@ void initParameter()
     setPerspective(); // set default projection matrix as perspective matrix
 }
 
-void setUniformVariables()
+// buffers of the Frame and Light uniform blocks, rewritten every frame
+void setUniformBuffers()
 {
-    iLocP = glGetUniformLocation(program, "um4p");
-    iLocV = glGetUniformLocation(program, "um4v");
-    iLocM = glGetUniformLocation(program, "um4m");
-
-    uniform.iLocCameraPosition = glGetUniformLocation(program, "cameraPosition");
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
 
-    uniform.iLocMaterial.Ka = glGetUniformLocation(program, "material.Ka");
-    uniform.iLocMaterial.Kd = glGetUniformLocation(program, "material.Kd");
-    uniform.iLocMaterial.Ks = glGetUniformLocation(program, "material.Ks");
+    glGenBuffers(1, &frameUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameUniformBuffer);
 
-    uniform.iLocLightInfo.position =             glGetUniformLocation(program, "lightInfo.position");
-    uniform.iLocLightInfo.ambient =              glGetUniformLocation(program, "lightInfo.ambient");
-    uniform.iLocLightInfo.diffuse =              glGetUniformLocation(program, "lightInfo.diffuse");
-    uniform.iLocLightInfo.specular =             glGetUniformLocation(program, "lightInfo.specular");
-    uniform.iLocLightInfo.attenuationConstant =  glGetUniformLocation(program, "lightInfo.attenuationConstant");
-    uniform.iLocLightInfo.attenuationLinear =    glGetUniformLocation(program, "lightInfo.attenuationLinear");
-    uniform.iLocLightInfo.attenuationQuadratic = glGetUniformLocation(program, "lightInfo.attenuationQuadratic");
-
-    uniform.iLocSpotLightInfo.direction = glGetUniformLocation(program, "spotLightInfo.direction");
-    uniform.iLocSpotLightInfo.exponent =  glGetUniformLocation(program, "spotLightInfo.exponent");
-    uniform.iLocSpotLightInfo.cutoff =    glGetUniformLocation(program, "spotLightInfo.cutoff");
+    glGenBuffers(1, &lightUniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, lightUniformBuffer);
+}
 
-    uniform.iLocCurLightMode =       glGetUniformLocation(program, "curLightMode");
-    uniform.iLocShininess =          glGetUniformLocation(program, "shininess");
-    uniform.iLocIsPerPixelLighting = glGetUniformLocation(program, "isPerPixelLighting");
+// upload every requested texture, so nothing is rendered with the placeholder
+void WaitForTextures()
+{
+    while (textureLoader.pending() > 0)
+    {
+        textureLoader.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
 
-    // [TODO] Get uniform location of texture
-    /* HW3 added */
-    uniform.iLocDiffuseTexture = glGetUniformLocation(program, "diffuseTexture");
-    uniform.iLocIsEye =          glGetUniformLocation(program, "isEye");
-    uniform.iLocOffsetX =        glGetUniformLocation(program, "offsetX");
-    uniform.iLocOffsetY =        glGetUniformLocation(program, "offsetY");
+// drop the models and release their textures, the GL textures are deleted with the last model using them;
+// the vertex and material buffers stay with the context as before
+void ReleaseModels()
+{
+    for (auto &m : models)
+        for (auto &texture : m.textures)
+            textureLoader.release(texture);
+    models.clear();
+
+    // released textures are only collected once they are done
+    WaitForTextures();
+    textureLoader.update();
 }
 
 void setupRC()
@@ -1186,14 +1545,17 @@ void setupRC()
     // setup shaders
     setShaders();
     initParameter();
-    setUniformVariables();
+    setUniformBuffers();
 
     // OpenGL States and Values
     glClearColor(0.2, 0.2, 0.2, 1.0);
 
-    for (string model_path : model_list)
+    textureLoader.init();
+    if (!LoadTexturedModels(model_list))
     {
-        LoadTexturedModels(model_path);
+        // the loader threads are joined, let the texture decodes of the other models finish as well
+        WaitForTextures();
+        exit(1);
     }
 }
 
@@ -1215,8 +1577,133 @@ void glPrintContextInfo(bool printExtension)
     }
 }
 
+// both views of the current model
+void RenderFrame()
+{
+    UpdateUniformBuffers();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    // both views in one pass unless the right one is drawn in passes of its own
+    if (useSinglePass && !useDeferredShading && !useDepthPrepass)
+    {
+        RenderSplitView();
+        return;
+    }
+    // render left view
+    glViewport(0, 0, screenWidth / 2, screenHeight);
+    RenderScene(1);
+    // render right view
+    glViewport(screenWidth / 2, 0, screenWidth / 2, screenHeight);
+    if (useDeferredShading && gbuffer.resize(screenWidth, screenHeight))
+        RenderDeferred();
+    else if (useDepthPrepass)
+        RenderPrepassed();
+    else
+        RenderScene(0);
+}
+
+// benchmark camera path: frame i of n on one orbit around the center, at the distance of start
+void SetBenchmarkCamera(const camera &start, int i, int n)
+{
+    float angle = static_cast<float>(2 * PI * i / n);
+    Vector3 offset = start.position - start.center;
+    main_camera = start;
+    main_camera.position = start.center + Vector3(offset.x * cos(angle) + offset.z * sin(angle), offset.y, offset.z * cos(angle) - offset.x * sin(angle));
+    setViewingMatrix();
+}
+
+// render options.frames frames of every model on the benchmark camera path and write the report,
+// window is NULL when rendering offscreen
+int RunBenchmark(const CommandLineOptions &options, GLFWwindow *window)
+{
+    WaitForTextures();
+    if (window != NULL)
+        glfwSwapInterval(0); // measure the frames, not the display refresh
+
+    camera start = main_camera;
+    vector<BenchmarkResult> results(models.size());
+    FrameTimer timer;
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        for (int i = -BENCHMARK_WARMUP_FRAMES; i < options.frames; i++)
+        {
+            SetBenchmarkCamera(start, i, options.frames);
+            if (i >= 0)
+                timer.begin();
+
+            RenderFrame();
+            if (window != NULL)
+            {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            else
+            {
+                glFlush();
+            }
+
+            if (i >= 0)
+                timer.end();
+        }
+        results[cur_idx].model = model_list[cur_idx];
+        timer.finish(results[cur_idx]);
+        ReportDepthPrepass(model_list[cur_idx], true);
+    }
+
+    main_camera = start;
+    setViewingMatrix();
+    cur_idx = 0;
+    return WriteBenchmarkReport(options.report, "HW3", options.frames, results) ? 0 : -1;
+}
+
+// render every model once into an image file, without any window
+int RenderHeadless(const CommandLineOptions &options)
+{
+    OffscreenContext context;
+    if (!context.create(options.backend, options.width, options.height))
+        return -1;
+
+    glPrintContextInfo(false);
+
+    glEnable(GL_DEPTH_TEST);
+    useDeferredShading = options.deferred;
+    useDepthPrepass = options.prepass;
+    useSinglePass = options.single_pass;
+    setupRC();
+    ChangeSize(NULL, context.width(), context.height());
+    if (options.benchmark)
+    {
+        int result = RunBenchmark(options, NULL);
+        ReleaseModels();
+        return result;
+    }
+
+    WaitForTextures();
+
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        RenderFrame();
+        ReportDepthPrepass(model_list[cur_idx], true);
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s_%03d.ppm", options.output.c_str(), cur_idx);
+        if (!context.writeImage(path))
+            return -1;
+        cout << "Headless: wrote " << path << endl;
+    }
+    ReleaseModels();
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
+    CommandLineOptions options;
+    options.width = WINDOW_WIDTH;
+    options.height = WINDOW_HEIGHT;
+    if (!ParseCommandLine(argc, argv, options, OPTION_DEFERRED | OPTION_PREPASS | OPTION_SINGLE_PASS))
+        return -1;
+    if (options.headless)
+        return RenderHeadless(options);
+
     // initial glfw
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -1254,20 +1741,29 @@ int main(int argc, char **argv)
 
     glfwSetFramebufferSizeCallback(window, ChangeSize);
     glEnable(GL_DEPTH_TEST);
+    useDeferredShading = options.deferred;
+    useDepthPrepass = options.prepass;
+    useSinglePass = options.single_pass;
     // Setup render context
     setupRC();
 
+    if (options.benchmark)
+    {
+        int result = RunBenchmark(options, window);
+        ReleaseModels();
+        return result;
+    }
+
     // main loop
-    while (!glfwWindowShouldClose(window))
+    for (int frame = 1; !glfwWindowShouldClose(window); frame++)
     {
+        // upload the textures decoded since the last frame
+        textureLoader.update();
+
         // render
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-        // render left view
-        glViewport(0, 0, screenWidth / 2, screenHeight);
-        RenderScene(1);
-        // render right view
-        glViewport(screenWidth / 2, 0, screenWidth / 2, screenHeight);
-        RenderScene(0);
+        RenderFrame();
+        if (frame % PREPASS_REPORT_FRAMES == 0)
+            ReportDepthPrepass(model_list[cur_idx], false);
 
         // swap buffer from back to front
         glfwSwapBuffers(window);
@@ -1275,6 +1771,7 @@ int main(int argc, char **argv)
         // Poll input event
         glfwPollEvents();
     }
+    ReleaseModels();
 
     // just for compatibiliy purposes
     return 0;
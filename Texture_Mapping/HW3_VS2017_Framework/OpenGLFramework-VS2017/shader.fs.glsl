@@ -1,15 +1,39 @@
 #version 330
 
+#if PER_PIXEL_LIGHTING || SPLIT_VIEW
 in vec3 vertex_pos;
-in vec3 vertex_color;
 in vec3 vertex_normal;
+#endif
+#if !PER_PIXEL_LIGHTING || SPLIT_VIEW
+in vec3 vertex_color;
+#endif
+#if SPLIT_VIEW
+flat in int view;
+#endif
 in vec2 texCoord;
 
+#if DEFERRED_PASS == 1
+// the G-buffer targets, at the locations of GBufferTarget in GBuffer.h
+layout(location = 0) out vec4 gPosition;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 gAmbient;
+layout(location = 3) out vec4 gDiffuse;
+layout(location = 4) out vec4 gSpecular;
+#else
 out vec4 fragColor;
+#endif
 
 const float PI = 3.14159265358979323846;
 
-uniform vec3 cameraPosition;
+// uniform blocks, shared by both shader stages and mirrored by the *Block structs in main.cpp
+layout(std140, row_major) uniform Frame
+{
+    mat4 um4p;
+    mat4 um4v;
+    mat4 um4m;
+    mat3 normalMatrix; // transpose(inverse(mat3(um4m))), computed once per model on the CPU
+    vec3 cameraPosition;
+};
 
 struct PhongMaterial
 {
@@ -17,7 +41,22 @@ struct PhongMaterial
     vec3 Kd;
     vec3 Ks;
 };
-uniform PhongMaterial material;
+
+#if DEFERRED_PASS == 2
+// the G-buffer, and the material of the pixel read from it by main(), already multiplied by the texture
+uniform sampler2D gbufferPosition;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferAmbient;
+uniform sampler2D gbufferDiffuse;
+uniform sampler2D gbufferSpecular;
+
+PhongMaterial material;
+#else
+layout(std140) uniform Material
+{
+    PhongMaterial material;
+};
+#endif
 
 struct LightInfo
 {
@@ -29,7 +68,6 @@ struct LightInfo
     float attenuationLinear;
     float attenuationQuadratic;
 };
-uniform LightInfo lightInfo;
 
 struct SpotLightInfo
 {
@@ -37,19 +75,22 @@ struct SpotLightInfo
     float exponent;
     float cutoff;
 };
-uniform SpotLightInfo spotLightInfo;
 
-uniform int curLightMode;
-uniform float shininess;
-uniform int isPerPixelLighting;
+layout(std140) uniform Light
+{
+    LightInfo lightInfo;
+    SpotLightInfo spotLightInfo;
+    float shininess;
+};
 
 // [TODO] passing texture from main.cpp
 // Hint: sampler2D
 /* HW3 added */
 uniform sampler2D diffuseTexture;
-uniform int isEye;
+#if EYE_OFFSET
 uniform float offsetX;
 uniform float offsetY;
+#endif
 
 vec3 directionalLight(vec3 vertexPosition, vec3 vertexNormal)
 {
@@ -109,22 +150,61 @@ vec3 spotLight(vec3 vertexPosition, vec3 vertexNormal)
     return ambient + spotEffect * f_att * (diffuse + specular);
 }
 
+// LIGHT_MODE picks the light type of the permutation: 0 directional, 1 position, 2 spot light
+vec3 lighting(vec3 vertexPosition, vec3 vertexNormal)
+{
+#if LIGHT_MODE == 0
+    return directionalLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 1
+    return positionLight(vertexPosition, vertexNormal);
+#else
+    return spotLight(vertexPosition, vertexNormal);
+#endif
+}
+
 void main()
 {
-    vec3 color;
-    if (curLightMode == 0)
-        color = directionalLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 1)
-        color = positionLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 2)
-        color = spotLight(vertex_pos, vertex_normal);
-    fragColor = (isPerPixelLighting == 1) ? vec4(color, 1.0f) : vec4(vertex_color, 1.0f);
+#if DEFERRED_PASS == 1
+    // geometry pass: the inputs of lighting(), each material color times the texture, which scales
+    // the lit color as a whole in the forward pass
+#if EYE_OFFSET
+    vec3 albedo = texture(diffuseTexture, texCoord + vec2(offsetX, offsetY)).rgb;
+#else
+    vec3 albedo = texture(diffuseTexture, texCoord).rgb;
+#endif
+    gPosition = vec4(vertex_pos, 1.0f);
+    gNormal = vec4(vertex_normal, 0.0f);
+    gAmbient = vec4(material.Ka * albedo, 1.0f);
+    gDiffuse = vec4(material.Kd * albedo, 1.0f);
+    gSpecular = vec4(material.Ks * albedo, 1.0f);
+#elif DEFERRED_PASS == 2
+    // lighting pass: once for every pixel a surface covers
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gbufferPosition, pixel, 0);
+    if (position.w == 0.0f)
+        discard;
+    material.Ka = texelFetch(gbufferAmbient, pixel, 0).rgb;
+    material.Kd = texelFetch(gbufferDiffuse, pixel, 0).rgb;
+    material.Ks = texelFetch(gbufferSpecular, pixel, 0).rgb;
+    fragColor = vec4(lighting(position.xyz, texelFetch(gbufferNormal, pixel, 0).xyz), 1.0f);
+#elif DEPTH_ONLY
+    // depth pre-pass: the depth of the fragment is all that is written
+#else
+#if SPLIT_VIEW
+    fragColor = view == 1 ? vec4(lighting(vertex_pos, vertex_normal), 1.0f) : vec4(vertex_color, 1.0f);
+#elif PER_PIXEL_LIGHTING
+    fragColor = vec4(lighting(vertex_pos, vertex_normal), 1.0f);
+#else
+    fragColor = vec4(vertex_color, 1.0f);
+#endif
 
     // [TODO] sampleing from texture
     // Hint: texture
     /* HW3 added */
-    if (isEye == 0)
-        fragColor *= texture(diffuseTexture, texCoord);
-    else
-        fragColor *= texture(diffuseTexture, texCoord + vec2(offsetX, offsetY));
+#if EYE_OFFSET
+    fragColor *= texture(diffuseTexture, texCoord + vec2(offsetX, offsetY));
+#else
+    fragColor *= texture(diffuseTexture, texCoord);
+#endif
+#endif
 }
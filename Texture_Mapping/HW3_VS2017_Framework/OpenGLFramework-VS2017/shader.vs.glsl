@@ -5,17 +5,35 @@ layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec3 aNormal;
 layout(location = 3) in vec2 aTexCoord;
 
+// LIGHT_MODE, PER_PIXEL_LIGHTING, EYE_OFFSET, DEFERRED_PASS, DEPTH_ONLY and SPLIT_VIEW are #defined for every
+// program by ShaderPermutations, per pixel lighting and the G-buffer are left to shader.fs.glsl
+#if PER_PIXEL_LIGHTING || SPLIT_VIEW
 out vec3 vertex_pos;
-out vec3 vertex_color;
 out vec3 vertex_normal;
+#endif
+#if !PER_PIXEL_LIGHTING || SPLIT_VIEW
+out vec3 vertex_color;
+#endif
+#if SPLIT_VIEW
+// both views in one instanced draw: instance 0 is the left view, lit per vertex, instance 1 the right one, lit per pixel
+flat out int view;
+#endif
 out vec2 texCoord;
 
+// the depth only program of the pre-pass and the full ones have to agree exactly for its GL_EQUAL depth test
+invariant gl_Position;
+
 const float PI = 3.14159265358979323846;
 
-uniform mat4 um4p;
-uniform mat4 um4v;
-uniform mat4 um4m;
-uniform vec3 cameraPosition;
+// uniform blocks, shared by both shader stages and mirrored by the *Block structs in main.cpp
+layout(std140, row_major) uniform Frame
+{
+    mat4 um4p;
+    mat4 um4v;
+    mat4 um4m;
+    mat3 normalMatrix; // transpose(inverse(mat3(um4m))), computed once per model on the CPU
+    vec3 cameraPosition;
+};
 
 struct PhongMaterial
 {
@@ -23,7 +41,11 @@ struct PhongMaterial
     vec3 Kd;
     vec3 Ks;
 };
-uniform PhongMaterial material;
+
+layout(std140) uniform Material
+{
+    PhongMaterial material;
+};
 
 struct LightInfo
 {
@@ -35,7 +57,6 @@ struct LightInfo
     float attenuationLinear;
     float attenuationQuadratic;
 };
-uniform LightInfo lightInfo;
 
 struct SpotLightInfo
 {
@@ -43,10 +64,13 @@ struct SpotLightInfo
     float exponent;
     float cutoff;
 };
-uniform SpotLightInfo spotLightInfo;
 
-uniform int curLightMode;
-uniform float shininess;
+layout(std140) uniform Light
+{
+    LightInfo lightInfo;
+    SpotLightInfo spotLightInfo;
+    float shininess;
+};
 
 // [TODO] passing uniform variable for texture coordinate offset
 
@@ -108,22 +132,49 @@ vec3 spotLight(vec3 vertexPosition, vec3 vertexNormal)
     return ambient + spotEffect * f_att * (diffuse + specular);
 }
 
-void main()
+// LIGHT_MODE picks the light type of the permutation: 0 directional, 1 position, 2 spot light
+vec3 lighting(vec3 vertexPosition, vec3 vertexNormal)
 {
-    gl_Position = um4p * um4v * um4m * vec4(aPos, 1.0);
-
-    vertex_pos = vec3(um4m * vec4(aPos, 1.0f));
-    vertex_normal = mat3(transpose(inverse(um4m))) * aNormal;
+#if LIGHT_MODE == 0
+    return directionalLight(vertexPosition, vertexNormal);
+#elif LIGHT_MODE == 1
+    return positionLight(vertexPosition, vertexNormal);
+#else
+    return spotLight(vertexPosition, vertexNormal);
+#endif
+}
 
-    vec3 color;
-    if (curLightMode == 0)
-        color = directionalLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 1)
-        color = positionLight(vertex_pos, vertex_normal);
-    else if (curLightMode == 2)
-        color = spotLight(vertex_pos, vertex_normal);
-    vertex_color = color;
+void main()
+{
+#if DEFERRED_PASS == 2
+    // one triangle covering the viewport, the lighting pass of deferred shading needs no vertices
+    gl_Position = vec4(gl_VertexID == 1 ? 3.0f : -1.0f, gl_VertexID == 2 ? 3.0f : -1.0f, 0.0f, 1.0f);
+#else
+    // three matrix times vector products, invariant keeps the compiler from reordering them itself
+    gl_Position = um4p * (um4v * (um4m * vec4(aPos, 1.0)));
+
+#if !DEPTH_ONLY
+    vec3 position = vec3(um4m * vec4(aPos, 1.0f));
+    vec3 normal = normalMatrix * aNormal;
+#if SPLIT_VIEW
+    view = gl_InstanceID;
+    vertex_pos = position;
+    vertex_normal = normal;
+    vertex_color = view == 0 ? lighting(position, normal) : vec3(0.0f);
+
+    // into the half of the window of the view, whose edges clip like those of a viewport of its own
+    gl_ClipDistance[0] = gl_Position.w + gl_Position.x;
+    gl_ClipDistance[1] = gl_Position.w - gl_Position.x;
+    gl_Position.x = 0.5f * gl_Position.x + (float(view) - 0.5f) * gl_Position.w;
+#elif PER_PIXEL_LIGHTING
+    vertex_pos = position;
+    vertex_normal = normal;
+#else
+    vertex_color = lighting(position, normal);
+#endif
 
     // [TODO]
     texCoord = aTexCoord;
+#endif
+#endif
 }
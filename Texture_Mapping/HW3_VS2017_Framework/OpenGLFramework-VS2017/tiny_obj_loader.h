@@ -59,6 +59,7 @@ THE SOFTWARE.
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace tinyobj {
@@ -491,7 +492,16 @@ struct ObjReaderConfig {
   ///
   std::string mtl_search_path;
 
-  ObjReaderConfig() : triangulate(true), vertex_color(true) {}
+  ///
+  /// Number of threads used to parse the .obj text.
+  /// 1 = single-threaded(default), 0 = use all hardware threads.
+  /// The text is split into line-aligned chunks which are parsed
+  /// concurrently and merged afterwards, so the result is identical to the
+  /// single-threaded parse. Small files are always parsed on one thread.
+  ///
+  unsigned int num_threads;
+
+  ObjReaderConfig() : triangulate(true), vertex_color(true), num_threads(1) {}
 };
 
 ///
@@ -534,6 +544,16 @@ class ObjReader {
 
   const std::vector<material_t> &GetMaterials() const { return materials_; }
 
+  ///
+  /// Move the parsed data out of the reader, for callers that modify it.
+  /// The corresponding Get accessor returns empty data afterwards.
+  ///
+  attrib_t TakeAttrib() { return std::move(attrib_); }
+
+  std::vector<shape_t> TakeShapes() { return std::move(shapes_); }
+
+  std::vector<material_t> TakeMaterials() { return std::move(materials_); }
+
   ///
   /// Warning message(may be filled after `Load` or `Parse`)
   ///
@@ -631,6 +651,16 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <fstream>
 #include <sstream>
 
+#if __cplusplus > 199711L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define TINYOBJLOADER_HAS_THREADS
+#include <thread>
+#endif
+
+// Smallest amount of .obj text handed to one thread by the parallel parser.
+#ifndef TINYOBJLOADER_PARALLEL_MIN_CHUNK_SIZE
+#define TINYOBJLOADER_PARALLEL_MIN_CHUNK_SIZE (256 * 1024)
+#endif
+
 namespace tinyobj {
 
 MaterialReader::~MaterialReader() {}
@@ -1074,22 +1104,35 @@ static tag_sizes parseTagTriple(const char **token) {
   return ts;
 }
 
+// Bits of `relative` in parseTriple().
+enum {
+  RELATIVE_V_IDX = 1,
+  RELATIVE_VT_IDX = 2,
+  RELATIVE_VN_IDX = 4
+};
+
 // Parse triples with index offsets: i, i/j/k, i//k, i/j
+// When `relative` is given, the RELATIVE_* bit of every component written
+// with a negative(relative) index is set in it.
 static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
-                        vertex_index_t *ret) {
+                        vertex_index_t *ret, unsigned int *relative = NULL) {
   if (!ret) {
     return false;
   }
 
   vertex_index_t vi(-1);
+  unsigned int rel = 0;
 
-  if (!fixIndex(atoi((*token)), vsize, &(vi.v_idx))) {
+  int idx = atoi((*token));
+  if (!fixIndex(idx, vsize, &(vi.v_idx))) {
     return false;
   }
+  if (idx < 0) rel |= RELATIVE_V_IDX;
 
   (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
+    if (relative) (*relative) = rel;
     return true;
   }
   (*token)++;
@@ -1097,33 +1140,42 @@ static bool parseTriple(const char **token, int vsize, int vnsize, int vtsize,
   // i//k
   if ((*token)[0] == '/') {
     (*token)++;
-    if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
+    idx = atoi((*token));
+    if (!fixIndex(idx, vnsize, &(vi.vn_idx))) {
       return false;
     }
+    if (idx < 0) rel |= RELATIVE_VN_IDX;
     (*token) += strcspn((*token), "/ \t\r");
     (*ret) = vi;
+    if (relative) (*relative) = rel;
     return true;
   }
 
   // i/j/k or i/j
-  if (!fixIndex(atoi((*token)), vtsize, &(vi.vt_idx))) {
+  idx = atoi((*token));
+  if (!fixIndex(idx, vtsize, &(vi.vt_idx))) {
     return false;
   }
+  if (idx < 0) rel |= RELATIVE_VT_IDX;
 
   (*token) += strcspn((*token), "/ \t\r");
   if ((*token)[0] != '/') {
     (*ret) = vi;
+    if (relative) (*relative) = rel;
     return true;
   }
 
   // i/j/k
   (*token)++;  // skip '/'
-  if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
+  idx = atoi((*token));
+  if (!fixIndex(idx, vnsize, &(vi.vn_idx))) {
     return false;
   }
+  if (idx < 0) rel |= RELATIVE_VN_IDX;
   (*token) += strcspn((*token), "/ \t\r");
 
   (*ret) = vi;
+  if (relative) (*relative) = rel;
 
   return true;
 }
@@ -2170,13 +2222,8 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
                  trianglulate, default_vcols_fallback);
 }
 
-bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
-             std::vector<material_t> *materials, std::string *warn,
-             std::string *err, std::istream *inStream,
-             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
-             bool default_vcols_fallback) {
-  std::stringstream errss;
-
+// Parser state shared by the single-threaded and the parallel LoadObj.
+struct obj_state_t {
   std::vector<real_t> v;
   std::vector<real_t> vn;
   std::vector<real_t> vt;
@@ -2187,19 +2234,411 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   // material
   std::map<std::string, int> material_map;
-  int material = -1;
+  int material;
 
   // smoothing group id
-  unsigned int current_smoothing_id =
-      0;  // Initial value. 0 means no smoothing.
+  unsigned int current_smoothing_id;  // 0 means no smoothing.
 
-  int greatest_v_idx = -1;
-  int greatest_vn_idx = -1;
-  int greatest_vt_idx = -1;
+  int greatest_v_idx;
+  int greatest_vn_idx;
+  int greatest_vt_idx;
 
   shape_t shape;
 
-  bool found_all_colors = true;
+  bool found_all_colors;
+
+  obj_state_t()
+      : material(-1),
+        current_smoothing_id(0),
+        greatest_v_idx(-1),
+        greatest_vn_idx(-1),
+        greatest_vt_idx(-1),
+        found_all_colors(true) {}
+};
+
+// Parses every command except `v', `vn', `vt' and `f', which are handled by
+// the caller. `vsize', `vnsize' and `vtsize' are the number of attributes
+// defined before this line. Returns false on a parse error.
+static bool parseObjCommand(const char *token, size_t line_num, int vsize,
+                            int vnsize, int vtsize, bool triangulate,
+                            obj_state_t *state, std::vector<shape_t> *shapes,
+                            std::vector<material_t> *materials,
+                            MaterialReader *readMatFn, std::string *warn,
+                            std::string *err) {
+  // line
+  if (token[0] == 'l' && IS_SPACE((token[1]))) {
+    token += 2;
+
+    __line_t line;
+
+    while (!IS_NEW_LINE(token[0])) {
+      vertex_index_t vi;
+      if (!parseTriple(&token, vsize, vnsize, vtsize, &vi)) {
+        if (err) {
+          std::stringstream ss;
+          ss << "Failed parse `l' line(e.g. zero value for vertex index. "
+                "line "
+             << line_num << ".)\n";
+          (*err) += ss.str();
+        }
+        return false;
+      }
+
+      line.vertex_indices.push_back(vi);
+
+      size_t n = strspn(token, " \t\r");
+      token += n;
+    }
+
+    state->prim_group.lineGroup.push_back(line);
+
+    return true;
+  }
+
+  // points
+  if (token[0] == 'p' && IS_SPACE((token[1]))) {
+    token += 2;
+
+    __points_t pts;
+
+    while (!IS_NEW_LINE(token[0])) {
+      vertex_index_t vi;
+      if (!parseTriple(&token, vsize, vnsize, vtsize, &vi)) {
+        if (err) {
+          std::stringstream ss;
+          ss << "Failed parse `p' line(e.g. zero value for vertex index. "
+                "line "
+             << line_num << ".)\n";
+          (*err) += ss.str();
+        }
+        return false;
+      }
+
+      pts.vertex_indices.push_back(vi);
+
+      size_t n = strspn(token, " \t\r");
+      token += n;
+    }
+
+    state->prim_group.pointsGroup.push_back(pts);
+
+    return true;
+  }
+
+  // use mtl
+  if ((0 == strncmp(token, "usemtl", 6))) {
+    token += 6;
+    std::string namebuf = parseString(&token);
+
+    int newMaterialId = -1;
+    std::map<std::string, int>::const_iterator it =
+        state->material_map.find(namebuf);
+    if (it != state->material_map.end()) {
+      newMaterialId = it->second;
+    } else {
+      // { error!! material not found }
+      if (warn) {
+        (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
+      }
+    }
+
+    if (newMaterialId != state->material) {
+      // Create per-face material. Thus we don't add `shape` to `shapes` at
+      // this time.
+      // just clear `faceGroup` after `exportGroupsToShape()` call.
+      exportGroupsToShape(&state->shape, state->prim_group, state->tags,
+                          state->material, state->name, triangulate,
+                          state->v);
+      state->prim_group.faceGroup.clear();
+      state->material = newMaterialId;
+    }
+
+    return true;
+  }
+
+  // load mtl
+  if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+    if (readMatFn) {
+      token += 7;
+
+      std::vector<std::string> filenames;
+      SplitString(std::string(token), ' ', filenames);
+
+      if (filenames.empty()) {
+        if (warn) {
+          std::stringstream ss;
+          ss << "Looks like empty filename for mtllib. Use default "
+                "material (line "
+             << line_num << ".)\n";
+
+          (*warn) += ss.str();
+        }
+      } else {
+        bool found = false;
+        for (size_t s = 0; s < filenames.size(); s++) {
+          std::string warn_mtl;
+          std::string err_mtl;
+          bool ok = (*readMatFn)(filenames[s].c_str(), materials,
+                                 &state->material_map, &warn_mtl, &err_mtl);
+          if (warn && (!warn_mtl.empty())) {
+            (*warn) += warn_mtl;
+          }
+
+          if (err && (!err_mtl.empty())) {
+            (*err) += err_mtl;
+          }
+
+          if (ok) {
+            found = true;
+            break;
+          }
+        }
+
+        if (!found) {
+          if (warn) {
+            (*warn) +=
+                "Failed to load material file(s). Use default "
+                "material.\n";
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // group name
+  if (token[0] == 'g' && IS_SPACE((token[1]))) {
+    // flush previous face group.
+    bool ret = exportGroupsToShape(&state->shape, state->prim_group,
+                                   state->tags, state->material, state->name,
+                                   triangulate, state->v);
+    (void)ret;  // return value not used.
+
+    if (state->shape.mesh.indices.size() > 0) {
+      shapes->push_back(state->shape);
+    }
+
+    state->shape = shape_t();
+
+    // material = -1;
+    state->prim_group.clear();
+
+    std::vector<std::string> names;
+
+    while (!IS_NEW_LINE(token[0])) {
+      std::string str = parseString(&token);
+      names.push_back(str);
+      token += strspn(token, " \t\r");  // skip tag
+    }
+
+    // names[0] must be 'g'
+
+    if (names.size() < 2) {
+      // 'g' with empty names
+      if (warn) {
+        std::stringstream ss;
+        ss << "Empty group name. line: " << line_num << "\n";
+        (*warn) += ss.str();
+        state->name = "";
+      }
+    } else {
+      std::stringstream ss;
+      ss << names[1];
+
+      // tinyobjloader does not support multiple groups for a primitive.
+      // Currently we concatinate multiple group names with a space to get
+      // single group name.
+
+      for (size_t i = 2; i < names.size(); i++) {
+        ss << " " << names[i];
+      }
+
+      state->name = ss.str();
+    }
+
+    return true;
+  }
+
+  // object name
+  if (token[0] == 'o' && IS_SPACE((token[1]))) {
+    // flush previous face group.
+    bool ret = exportGroupsToShape(&state->shape, state->prim_group,
+                                   state->tags, state->material, state->name,
+                                   triangulate, state->v);
+    (void)ret;  // return value not used.
+
+    if (state->shape.mesh.indices.size() > 0 ||
+        state->shape.lines.indices.size() > 0 ||
+        state->shape.points.indices.size() > 0) {
+      shapes->push_back(state->shape);
+    }
+
+    // material = -1;
+    state->prim_group.clear();
+    state->shape = shape_t();
+
+    // @todo { multiple object name? }
+    token += 2;
+    std::stringstream ss;
+    ss << token;
+    state->name = ss.str();
+
+    return true;
+  }
+
+  if (token[0] == 't' && IS_SPACE(token[1])) {
+    const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
+    tag_t tag;
+
+    token += 2;
+
+    tag.name = parseString(&token);
+
+    tag_sizes ts = parseTagTriple(&token);
+
+    if (ts.num_ints < 0) {
+      ts.num_ints = 0;
+    }
+    if (ts.num_ints > max_tag_nums) {
+      ts.num_ints = max_tag_nums;
+    }
+
+    if (ts.num_reals < 0) {
+      ts.num_reals = 0;
+    }
+    if (ts.num_reals > max_tag_nums) {
+      ts.num_reals = max_tag_nums;
+    }
+
+    if (ts.num_strings < 0) {
+      ts.num_strings = 0;
+    }
+    if (ts.num_strings > max_tag_nums) {
+      ts.num_strings = max_tag_nums;
+    }
+
+    tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+      tag.intValues[i] = parseInt(&token);
+    }
+
+    tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
+      tag.floatValues[i] = parseReal(&token);
+    }
+
+    tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+    for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+      tag.stringValues[i] = parseString(&token);
+    }
+
+    state->tags.push_back(tag);
+
+    return true;
+  }
+
+  if (token[0] == 's' && IS_SPACE(token[1])) {
+    // smoothing group id
+    token += 2;
+
+    // skip space.
+    token += strspn(token, " \t");  // skip space
+
+    if (token[0] == '\0') {
+      return true;
+    }
+
+    if (token[0] == '\r' || token[1] == '\n') {
+      return true;
+    }
+
+    if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
+        token[2] == 'f') {
+      state->current_smoothing_id = 0;
+    } else {
+      // assume number
+      int smGroupId = parseInt(&token);
+      if (smGroupId < 0) {
+        // parse error. force set to 0.
+        // FIXME(syoyo): Report warning.
+        state->current_smoothing_id = 0;
+      } else {
+        state->current_smoothing_id = static_cast<unsigned int>(smGroupId);
+      }
+    }
+
+    return true;
+  }  // smoothing group id
+
+  // Ignore unknown command.
+  return true;
+}
+
+// Flushes the last shape and moves the parsed attributes into `attrib`.
+static void finishObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+                      obj_state_t *state, size_t line_num, bool triangulate,
+                      bool default_vcols_fallback, std::string *warn) {
+  // not all vertices have colors, no default colors desired? -> clear colors
+  if (!state->found_all_colors && !default_vcols_fallback) {
+    state->vc.clear();
+  }
+
+  if (state->greatest_v_idx >= static_cast<int>(state->v.size() / 3)) {
+    if (warn) {
+      std::stringstream ss;
+      ss << "Vertex indices out of bounds (line " << line_num << ".)\n"
+         << std::endl;
+      (*warn) += ss.str();
+    }
+  }
+  if (state->greatest_vn_idx >= static_cast<int>(state->vn.size() / 3)) {
+    if (warn) {
+      std::stringstream ss;
+      ss << "Vertex normal indices out of bounds (line " << line_num
+         << ".)\n" << std::endl;
+      (*warn) += ss.str();
+    }
+  }
+  if (state->greatest_vt_idx >= static_cast<int>(state->vt.size() / 2)) {
+    if (warn) {
+      std::stringstream ss;
+      ss << "Vertex texcoord indices out of bounds (line " << line_num
+         << ".)\n" << std::endl;
+      (*warn) += ss.str();
+    }
+  }
+
+  bool ret = exportGroupsToShape(&state->shape, state->prim_group,
+                                 state->tags, state->material, state->name,
+                                 triangulate, state->v);
+  // exportGroupsToShape return false when `usemtl` is called in the last
+  // line.
+  // we also add `shape` to `shapes` when `shape.mesh` has already some
+  // faces(indices)
+  if (ret || state->shape.mesh.indices
+                 .size()) {  // FIXME(syoyo): Support other prims(e.g. lines)
+    shapes->push_back(state->shape);
+  }
+  state->prim_group.clear();  // for safety
+
+  attrib->vertices.swap(state->v);
+  attrib->vertex_weights.swap(state->v);
+  attrib->normals.swap(state->vn);
+  attrib->texcoords.swap(state->vt);
+  attrib->texcoord_ws.swap(state->vt);
+  attrib->colors.swap(state->vc);
+}
+
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *warn,
+             std::string *err, std::istream *inStream,
+             MaterialReader *readMatFn /*= NULL*/, bool triangulate,
+             bool default_vcols_fallback) {
+  std::stringstream errss;
+
+  obj_state_t state;
 
   size_t line_num = 0;
   std::string linebuf;
@@ -2238,16 +2677,17 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       real_t x, y, z;
       real_t r, g, b;
 
-      found_all_colors &= parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+      state.found_all_colors &=
+          parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
 
-      v.push_back(x);
-      v.push_back(y);
-      v.push_back(z);
+      state.v.push_back(x);
+      state.v.push_back(y);
+      state.v.push_back(z);
 
-      if (found_all_colors || default_vcols_fallback) {
-        vc.push_back(r);
-        vc.push_back(g);
-        vc.push_back(b);
+      if (state.found_all_colors || default_vcols_fallback) {
+        state.vc.push_back(r);
+        state.vc.push_back(g);
+        state.vc.push_back(b);
       }
 
       continue;
@@ -2258,9 +2698,9 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       token += 3;
       real_t x, y, z;
       parseReal3(&x, &y, &z, &token);
-      vn.push_back(x);
-      vn.push_back(y);
-      vn.push_back(z);
+      state.vn.push_back(x);
+      state.vn.push_back(y);
+      state.vn.push_back(z);
       continue;
     }
 
@@ -2269,72 +2709,8 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       token += 3;
       real_t x, y;
       parseReal2(&x, &y, &token);
-      vt.push_back(x);
-      vt.push_back(y);
-      continue;
-    }
-
-    // line
-    if (token[0] == 'l' && IS_SPACE((token[1]))) {
-      token += 2;
-
-      __line_t line;
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi)) {
-          if (err) {
-            std::stringstream ss;
-            ss << "Failed parse `l' line(e.g. zero value for vertex index. "
-                  "line "
-               << line_num << ".)\n";
-            (*err) += ss.str();
-          }
-          return false;
-        }
-
-        line.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      prim_group.lineGroup.push_back(line);
-
-      continue;
-    }
-
-    // points
-    if (token[0] == 'p' && IS_SPACE((token[1]))) {
-      token += 2;
-
-      __points_t pts;
-
-      while (!IS_NEW_LINE(token[0])) {
-        vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi)) {
-          if (err) {
-            std::stringstream ss;
-            ss << "Failed parse `p' line(e.g. zero value for vertex index. "
-                  "line "
-               << line_num << ".)\n";
-            (*err) += ss.str();
-          }
-          return false;
-        }
-
-        pts.vertex_indices.push_back(vi);
-
-        size_t n = strspn(token, " \t\r");
-        token += n;
-      }
-
-      prim_group.pointsGroup.push_back(pts);
-
+      state.vt.push_back(x);
+      state.vt.push_back(y);
       continue;
     }
 
@@ -2345,14 +2721,14 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
       face_t face;
 
-      face.smoothing_group_id = current_smoothing_id;
+      face.smoothing_group_id = state.current_smoothing_id;
       face.vertex_indices.reserve(3);
 
       while (!IS_NEW_LINE(token[0])) {
         vertex_index_t vi;
-        if (!parseTriple(&token, static_cast<int>(v.size() / 3),
-                         static_cast<int>(vn.size() / 3),
-                         static_cast<int>(vt.size() / 2), &vi)) {
+        if (!parseTriple(&token, static_cast<int>(state.v.size() / 3),
+                         static_cast<int>(state.vn.size() / 3),
+                         static_cast<int>(state.vt.size() / 2), &vi)) {
           if (err) {
             std::stringstream ss;
             ss << "Failed parse `f' line(e.g. zero value for face index. line "
@@ -2362,11 +2738,15 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
           return false;
         }
 
-        greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
-        greatest_vn_idx =
-            greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
-        greatest_vt_idx =
-            greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
+        state.greatest_v_idx = state.greatest_v_idx > vi.v_idx
+                                   ? state.greatest_v_idx
+                                   : vi.v_idx;
+        state.greatest_vn_idx = state.greatest_vn_idx > vi.vn_idx
+                                    ? state.greatest_vn_idx
+                                    : vi.vn_idx;
+        state.greatest_vt_idx = state.greatest_vt_idx > vi.vt_idx
+                                    ? state.greatest_vt_idx
+                                    : vi.vt_idx;
 
         face.vertex_indices.push_back(vi);
         size_t n = strspn(token, " \t\r");
@@ -2374,311 +2754,334 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       }
 
       // replace with emplace_back + std::move on C++11
-      prim_group.faceGroup.push_back(face);
+      state.prim_group.faceGroup.push_back(face);
 
       continue;
     }
 
-    // use mtl
-    if ((0 == strncmp(token, "usemtl", 6))) {
-      token += 6;
-      std::string namebuf = parseString(&token);
-
-      int newMaterialId = -1;
-      std::map<std::string, int>::const_iterator it = material_map.find(namebuf);
-      if (it != material_map.end()) {
-        newMaterialId = it->second;
-      } else {
-        // { error!! material not found }
-        if (warn) {
-          (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
-        }
-      }
-
-      if (newMaterialId != material) {
-        // Create per-face material. Thus we don't add `shape` to `shapes` at
-        // this time.
-        // just clear `faceGroup` after `exportGroupsToShape()` call.
-        exportGroupsToShape(&shape, prim_group, tags, material, name,
-                            triangulate, v);
-        prim_group.faceGroup.clear();
-        material = newMaterialId;
-      }
-
-      continue;
+    if (!parseObjCommand(token, line_num,
+                         static_cast<int>(state.v.size() / 3),
+                         static_cast<int>(state.vn.size() / 3),
+                         static_cast<int>(state.vt.size() / 2), triangulate,
+                         &state, shapes, materials, readMatFn, warn, err)) {
+      return false;
     }
+  }
 
-    // load mtl
-    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-      if (readMatFn) {
-        token += 7;
+  finishObj(attrib, shapes, &state, line_num, triangulate,
+            default_vcols_fallback, warn);
 
-        std::vector<std::string> filenames;
-        SplitString(std::string(token), ' ', filenames);
+  if (err) {
+    (*err) += errss.str();
+  }
 
-        if (filenames.empty()) {
-          if (warn) {
-            std::stringstream ss;
-            ss << "Looks like empty filename for mtllib. Use default "
-                  "material (line "
-               << line_num << ".)\n";
+  return true;
+}
 
-            (*warn) += ss.str();
-          }
-        } else {
-          bool found = false;
-          for (size_t s = 0; s < filenames.size(); s++) {
-            std::string warn_mtl;
-            std::string err_mtl;
-            bool ok = (*readMatFn)(filenames[s].c_str(), materials,
-                                   &material_map, &warn_mtl, &err_mtl);
-            if (warn && (!warn_mtl.empty())) {
-              (*warn) += warn_mtl;
-            }
+#ifdef TINYOBJLOADER_HAS_THREADS
+// A command other than `v', `vn', `vt' and `f', replayed in file order after
+// the chunks have been parsed.
+struct obj_command_t {
+  const char *token;
+  size_t line_num;   // line number within the chunk
+  size_t num_faces;  // faces of the chunk preceding this command
+  int num_v;         // attributes of the chunk preceding this command
+  int num_vn;
+  int num_vt;
+};
 
-            if (err && (!err_mtl.empty())) {
-              (*err) += err_mtl;
-            }
+// Attributes, faces and commands of one line-aligned chunk of .obj text.
+struct obj_chunk_t {
+  char *begin;
+  char *end;
+  size_t num_lines;
 
-            if (ok) {
-              found = true;
-              break;
-            }
-          }
+  std::vector<real_t> v;
+  std::vector<real_t> vn;
+  std::vector<real_t> vt;
+  std::vector<real_t> vc;
+  bool found_all_colors;
 
-          if (!found) {
-            if (warn) {
-              (*warn) +=
-                  "Failed to load material file(s). Use default "
-                  "material.\n";
-            }
-          }
-        }
-      }
+  // v/vt/vn index triple per face vertex. Relative indices are resolved
+  // against the attributes of this chunk and their slots are recorded in
+  // `relative_indices`, to be rebased once the preceding chunks are known.
+  std::vector<int> face_indices;
+  std::vector<unsigned int> face_num_verts;
+  std::vector<size_t> relative_indices;
 
-      continue;
-    }
+  std::vector<obj_command_t> commands;
 
-    // group name
-    if (token[0] == 'g' && IS_SPACE((token[1]))) {
-      // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v);
-      (void)ret;  // return value not used.
+  size_t error_line;  // line of a malformed `f' line, 0 = no error.
 
-      if (shape.mesh.indices.size() > 0) {
-        shapes->push_back(shape);
-      }
+  obj_chunk_t()
+      : begin(NULL),
+        end(NULL),
+        num_lines(0),
+        found_all_colors(true),
+        error_line(0) {}
+};
 
-      shape = shape_t();
+// Parses the attributes and faces of a chunk. Lines are terminated in place,
+// so the recorded commands can point into the text.
+static void parseObjChunk(obj_chunk_t *chunk) {
+  char *p = chunk->begin;
+  while (p < chunk->end) {
+    char *linebuf = p;
+    while ((p < chunk->end) && (p[0] != '\n') && (p[0] != '\r')) p++;
+    if (p < chunk->end) {
+      if ((p[0] == '\r') && ((p + 1) < chunk->end) && (p[1] == '\n')) {
+        *p++ = '\0';
+      }
+      *p++ = '\0';
+    }
 
-      // material = -1;
-      prim_group.clear();
+    chunk->num_lines++;
 
-      std::vector<std::string> names;
+    // Skip leading space.
+    const char *token = linebuf;
+    token += strspn(token, " \t");
 
-      while (!IS_NEW_LINE(token[0])) {
-        std::string str = parseString(&token);
-        names.push_back(str);
-        token += strspn(token, " \t\r");  // skip tag
-      }
+    if (token[0] == '\0') continue;  // empty line
 
-      // names[0] must be 'g'
+    if (token[0] == '#') continue;  // comment line
 
-      if (names.size() < 2) {
-        // 'g' with empty names
-        if (warn) {
-          std::stringstream ss;
-          ss << "Empty group name. line: " << line_num << "\n";
-          (*warn) += ss.str();
-          name = "";
-        }
-      } else {
-        std::stringstream ss;
-        ss << names[1];
+    // vertex
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+      token += 2;
+      real_t x, y, z;
+      real_t r, g, b;
 
-        // tinyobjloader does not support multiple groups for a primitive.
-        // Currently we concatinate multiple group names with a space to get
-        // single group name.
+      // Colors are always kept here, finishObj() drops them if needed.
+      chunk->found_all_colors &=
+          parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
 
-        for (size_t i = 2; i < names.size(); i++) {
-          ss << " " << names[i];
-        }
+      chunk->v.push_back(x);
+      chunk->v.push_back(y);
+      chunk->v.push_back(z);
 
-        name = ss.str();
-      }
+      chunk->vc.push_back(r);
+      chunk->vc.push_back(g);
+      chunk->vc.push_back(b);
 
       continue;
     }
 
-    // object name
-    if (token[0] == 'o' && IS_SPACE((token[1]))) {
-      // flush previous face group.
-      bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                     triangulate, v);
-      (void)ret;  // return value not used.
-
-      if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 ||
-          shape.points.indices.size() > 0) {
-        shapes->push_back(shape);
-      }
-
-      // material = -1;
-      prim_group.clear();
-      shape = shape_t();
-
-      // @todo { multiple object name? }
-      token += 2;
-      std::stringstream ss;
-      ss << token;
-      name = ss.str();
-
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+      token += 3;
+      real_t x, y, z;
+      parseReal3(&x, &y, &z, &token);
+      chunk->vn.push_back(x);
+      chunk->vn.push_back(y);
+      chunk->vn.push_back(z);
       continue;
     }
 
-    if (token[0] == 't' && IS_SPACE(token[1])) {
-      const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
-      tag_t tag;
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+      token += 3;
+      real_t x, y;
+      parseReal2(&x, &y, &token);
+      chunk->vt.push_back(x);
+      chunk->vt.push_back(y);
+      continue;
+    }
 
+    // face
+    if (token[0] == 'f' && IS_SPACE((token[1]))) {
       token += 2;
+      token += strspn(token, " \t");
 
-      tag.name = parseString(&token);
-
-      tag_sizes ts = parseTagTriple(&token);
-
-      if (ts.num_ints < 0) {
-        ts.num_ints = 0;
-      }
-      if (ts.num_ints > max_tag_nums) {
-        ts.num_ints = max_tag_nums;
-      }
+      unsigned int num_verts = 0;
 
-      if (ts.num_reals < 0) {
-        ts.num_reals = 0;
-      }
-      if (ts.num_reals > max_tag_nums) {
-        ts.num_reals = max_tag_nums;
-      }
+      while (!IS_NEW_LINE(token[0])) {
+        vertex_index_t vi;
+        unsigned int relative = 0;
+        if (!parseTriple(&token, static_cast<int>(chunk->v.size() / 3),
+                         static_cast<int>(chunk->vn.size() / 3),
+                         static_cast<int>(chunk->vt.size() / 2), &vi,
+                         &relative)) {
+          chunk->error_line = chunk->num_lines;
+          return;
+        }
 
-      if (ts.num_strings < 0) {
-        ts.num_strings = 0;
-      }
-      if (ts.num_strings > max_tag_nums) {
-        ts.num_strings = max_tag_nums;
+        size_t slot = chunk->face_indices.size();
+        chunk->face_indices.push_back(vi.v_idx);
+        chunk->face_indices.push_back(vi.vt_idx);
+        chunk->face_indices.push_back(vi.vn_idx);
+        if (relative & RELATIVE_V_IDX)
+          chunk->relative_indices.push_back(slot);
+        if (relative & RELATIVE_VT_IDX)
+          chunk->relative_indices.push_back(slot + 1);
+        if (relative & RELATIVE_VN_IDX)
+          chunk->relative_indices.push_back(slot + 2);
+
+        num_verts++;
+        size_t n = strspn(token, " \t\r");
+        token += n;
       }
 
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
-
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = parseInt(&token);
-      }
+      chunk->face_num_verts.push_back(num_verts);
 
-      tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
-        tag.floatValues[i] = parseReal(&token);
-      }
+      continue;
+    }
 
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        tag.stringValues[i] = parseString(&token);
-      }
+    obj_command_t command;
+    command.token = token;
+    command.line_num = chunk->num_lines;
+    command.num_faces = chunk->face_num_verts.size();
+    command.num_v = static_cast<int>(chunk->v.size() / 3);
+    command.num_vn = static_cast<int>(chunk->vn.size() / 3);
+    command.num_vt = static_cast<int>(chunk->vt.size() / 2);
+    chunk->commands.push_back(command);
+  }
+}
 
-      tags.push_back(tag);
+// Parallel version of LoadObj. `text` is split into line-aligned chunks
+// which are parsed concurrently(and modified in place), then the chunks are
+// merged in file order, which gives the same result as the serial parser.
+static bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                            std::vector<material_t> *materials,
+                            std::string *warn, std::string *err,
+                            std::string *text, MaterialReader *readMatFn,
+                            bool triangulate, bool default_vcols_fallback,
+                            unsigned int num_threads) {
+  attrib->vertices.clear();
+  attrib->normals.clear();
+  attrib->texcoords.clear();
+  attrib->colors.clear();
+  shapes->clear();
 
-      continue;
-    }
+  size_t len = text->size();
+  size_t num_chunks = len / TINYOBJLOADER_PARALLEL_MIN_CHUNK_SIZE;
+  if (num_chunks > num_threads) num_chunks = num_threads;
+  if (num_chunks < 1) num_chunks = 1;
 
-    if (token[0] == 's' && IS_SPACE(token[1])) {
-      // smoothing group id
-      token += 2;
+  std::vector<obj_chunk_t> chunks(num_chunks);
+  char *buf = len ? &(*text)[0] : NULL;
+  char *buf_end = buf + len;
+  char *p = buf;
+  for (size_t i = 0; i < num_chunks; i++) {
+    char *end = (i + 1 == num_chunks) ? buf_end
+                                      : buf + (len / num_chunks) * (i + 1);
+    if (end < p) end = p;
+    // Move the split point just past the next '\n'.
+    while ((end < buf_end) && (end > buf) && (end[-1] != '\n')) end++;
+    chunks[i].begin = p;
+    chunks[i].end = end;
+    p = end;
+  }
 
-      // skip space.
-      token += strspn(token, " \t");  // skip space
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < num_chunks; i++) {
+    workers.push_back(std::thread(parseObjChunk, &chunks[i]));
+  }
+  parseObjChunk(&chunks[0]);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
 
-      if (token[0] == '\0') {
-        continue;
-      }
+  obj_state_t state;
 
-      if (token[0] == '\r' || token[1] == '\n') {
-        continue;
+  size_t line_num = 0;
+  size_t num_v = 0, num_vn = 0, num_vt = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    if (chunks[i].error_line > 0) {
+      if (err) {
+        std::stringstream ss;
+        ss << "Failed parse `f' line(e.g. zero value for face index. line "
+           << line_num + chunks[i].error_line << ".)\n";
+        (*err) += ss.str();
       }
-
-      if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
-          token[2] == 'f') {
-        current_smoothing_id = 0;
-      } else {
-        // assume number
-        int smGroupId = parseInt(&token);
-        if (smGroupId < 0) {
-          // parse error. force set to 0.
-          // FIXME(syoyo): Report warning.
-          current_smoothing_id = 0;
-        } else {
-          current_smoothing_id = static_cast<unsigned int>(smGroupId);
+      return false;
+    }
+    line_num += chunks[i].num_lines;
+    num_v += chunks[i].v.size();
+    num_vn += chunks[i].vn.size();
+    num_vt += chunks[i].vt.size();
+  }
+
+  state.v.reserve(num_v);
+  state.vc.reserve(num_v);
+  state.vn.reserve(num_vn);
+  state.vt.reserve(num_vt);
+
+  line_num = 0;
+  for (size_t i = 0; i < num_chunks; i++) {
+    obj_chunk_t &chunk = chunks[i];
+
+    // Rebase the relative indices of the chunk on the preceding chunks.
+    int v_base = static_cast<int>(state.v.size() / 3);
+    int vn_base = static_cast<int>(state.vn.size() / 3);
+    int vt_base = static_cast<int>(state.vt.size() / 2);
+    for (size_t r = 0; r < chunk.relative_indices.size(); r++) {
+      size_t slot = chunk.relative_indices[r];
+      const int bases[3] = {v_base, vt_base, vn_base};
+      chunk.face_indices[slot] += bases[slot % 3];
+    }
+
+    state.v.insert(state.v.end(), chunk.v.begin(), chunk.v.end());
+    state.vn.insert(state.vn.end(), chunk.vn.begin(), chunk.vn.end());
+    state.vt.insert(state.vt.end(), chunk.vt.begin(), chunk.vt.end());
+    state.vc.insert(state.vc.end(), chunk.vc.begin(), chunk.vc.end());
+    state.found_all_colors &= chunk.found_all_colors;
+    std::vector<real_t>().swap(chunk.v);
+    std::vector<real_t>().swap(chunk.vn);
+    std::vector<real_t>().swap(chunk.vt);
+    std::vector<real_t>().swap(chunk.vc);
+
+    // Interleave the faces with the other commands in file order.
+    size_t face = 0;
+    size_t offset = 0;
+    for (size_t c = 0; c <= chunk.commands.size(); c++) {
+      size_t num_faces = (c < chunk.commands.size())
+                             ? chunk.commands[c].num_faces
+                             : chunk.face_num_verts.size();
+      for (; face < num_faces; face++) {
+        face_t f;
+        f.smoothing_group_id = state.current_smoothing_id;
+        f.vertex_indices.resize(chunk.face_num_verts[face]);
+        for (size_t k = 0; k < f.vertex_indices.size(); k++) {
+          vertex_index_t vi(chunk.face_indices[offset],
+                            chunk.face_indices[offset + 1],
+                            chunk.face_indices[offset + 2]);
+          offset += 3;
+
+          state.greatest_v_idx = state.greatest_v_idx > vi.v_idx
+                                     ? state.greatest_v_idx
+                                     : vi.v_idx;
+          state.greatest_vn_idx = state.greatest_vn_idx > vi.vn_idx
+                                      ? state.greatest_vn_idx
+                                      : vi.vn_idx;
+          state.greatest_vt_idx = state.greatest_vt_idx > vi.vt_idx
+                                      ? state.greatest_vt_idx
+                                      : vi.vt_idx;
+
+          f.vertex_indices[k] = vi;
         }
+        state.prim_group.faceGroup.push_back(f);
       }
 
-      continue;
-    }  // smoothing group id
+      if (c == chunk.commands.size()) break;
 
-    // Ignore unknown command.
-  }
-
-  // not all vertices have colors, no default colors desired? -> clear colors
-  if (!found_all_colors && !default_vcols_fallback) {
-    vc.clear();
-  }
-
-  if (greatest_v_idx >= static_cast<int>(v.size() / 3)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex indices out of bounds (line " << line_num << ".)\n"
-         << std::endl;
-      (*warn) += ss.str();
-    }
-  }
-  if (greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex normal indices out of bounds (line " << line_num << ".)\n"
-         << std::endl;
-      (*warn) += ss.str();
-    }
-  }
-  if (greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
-    if (warn) {
-      std::stringstream ss;
-      ss << "Vertex texcoord indices out of bounds (line " << line_num << ".)\n"
-         << std::endl;
-      (*warn) += ss.str();
+      const obj_command_t &command = chunk.commands[c];
+      if (!parseObjCommand(command.token, line_num + command.line_num,
+                           v_base + command.num_v, vn_base + command.num_vn,
+                           vt_base + command.num_vt, triangulate, &state,
+                           shapes, materials, readMatFn, warn, err)) {
+        return false;
+      }
     }
-  }
 
-  bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name,
-                                 triangulate, v);
-  // exportGroupsToShape return false when `usemtl` is called in the last
-  // line.
-  // we also add `shape` to `shapes` when `shape.mesh` has already some
-  // faces(indices)
-  if (ret || shape.mesh.indices
-                 .size()) {  // FIXME(syoyo): Support other prims(e.g. lines)
-    shapes->push_back(shape);
+    line_num += chunk.num_lines;
   }
-  prim_group.clear();  // for safety
 
-  if (err) {
-    (*err) += errss.str();
-  }
-
-  attrib->vertices.swap(v);
-  attrib->vertex_weights.swap(v);
-  attrib->normals.swap(vn);
-  attrib->texcoords.swap(vt);
-  attrib->texcoord_ws.swap(vt);
-  attrib->colors.swap(vc);
+  finishObj(attrib, shapes, &state, line_num, triangulate,
+            default_vcols_fallback, warn);
 
   return true;
 }
+#endif  // TINYOBJLOADER_HAS_THREADS
 
 bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
                          void *user_data /*= NULL*/,
@@ -2963,6 +3366,35 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
   return true;
 }
 
+#ifdef TINYOBJLOADER_HAS_THREADS
+static unsigned int ResolveNumThreads(unsigned int num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  return num_threads;
+}
+
+static bool ReadWholeFile(const std::string &filename, std::string *text) {
+  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+
+  ifs.seekg(0, std::ios::end);
+  std::streamoff size = ifs.tellg();
+  ifs.seekg(0, std::ios::beg);
+  if (size < 0) {
+    return false;
+  }
+
+  text->resize(static_cast<size_t>(size));
+  if (size > 0) {
+    ifs.read(&(*text)[0], size);
+  }
+  return ifs.good() || ifs.eof();
+}
+#endif
+
 bool ObjReader::ParseFromFile(const std::string &filename,
                               const ObjReaderConfig &config) {
   std::string mtl_search_path;
@@ -2980,6 +3412,35 @@ bool ObjReader::ParseFromFile(const std::string &filename,
     mtl_search_path = config.mtl_search_path;
   }
 
+#ifdef TINYOBJLOADER_HAS_THREADS
+  unsigned int num_threads = ResolveNumThreads(config.num_threads);
+  if (num_threads > 1) {
+    std::string obj_text;
+    if (!ReadWholeFile(filename, &obj_text)) {
+      error_ = "Cannot open file [" + filename + "]\n";
+      valid_ = false;
+      return valid_;
+    }
+
+    std::string baseDir = mtl_search_path;
+    if (!baseDir.empty()) {
+#ifndef _WIN32
+      const char dirsep = '/';
+#else
+      const char dirsep = '\\';
+#endif
+      if (baseDir[baseDir.length() - 1] != dirsep) baseDir += dirsep;
+    }
+    MaterialFileReader matFileReader(baseDir);
+
+    valid_ = LoadObjParallel(&attrib_, &shapes_, &materials_, &warning_,
+                             &error_, &obj_text, &matFileReader,
+                             config.triangulate, config.vertex_color,
+                             num_threads);
+    return valid_;
+  }
+#endif
+
   valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
                    filename.c_str(), mtl_search_path.c_str(),
                    config.triangulate, config.vertex_color);
@@ -2998,6 +3459,17 @@ bool ObjReader::ParseFromString(const std::string &obj_text,
 
   MaterialStreamReader mtl_ss(mtl_ifs);
 
+#ifdef TINYOBJLOADER_HAS_THREADS
+  unsigned int num_threads = ResolveNumThreads(config.num_threads);
+  if (num_threads > 1) {
+    std::string text(obj_text);
+    valid_ = LoadObjParallel(&attrib_, &shapes_, &materials_, &warning_,
+                             &error_, &text, &mtl_ss, config.triangulate,
+                             config.vertex_color, num_threads);
+    return valid_;
+  }
+#endif
+
   valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_,
                    &obj_ifs, &mtl_ss, config.triangulate, config.vertex_color);
 
@@ -0,0 +1,90 @@
+#include "CommandLine.h"
+
+#include <cstdio>
+#include <iostream>
+
+// false, after saying which apps have it, for an option outside supported
+static bool Supported(const char *option, unsigned supported, unsigned flag, const char *apps)
+{
+    if (supported & flag)
+        return true;
+    std::cout << "CommandLine: " << option << " needs " << apps << std::endl;
+    return false;
+}
+
+bool ParseCommandLine(int argc, char **argv, CommandLineOptions &options, unsigned supported)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg.compare(0, 11, "--headless=") == 0)
+        {
+            options.headless = true;
+            options.backend = arg.substr(11);
+            if (options.backend == "software" && !Supported("--headless=software", supported, OPTION_SOFTWARE, "HW2"))
+                return false;
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            options.output = argv[++i];
+        }
+        else if (arg == "--size" && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &options.width, &options.height) == 2 &&
+                 options.width > 0 && options.height > 0)
+        {
+            i++;
+        }
+        else if (arg == "--benchmark")
+        {
+            options.benchmark = true;
+        }
+        else if (arg.compare(0, 12, "--benchmark=") == 0 && sscanf(arg.c_str() + 12, "%d", &options.frames) == 1 &&
+                 options.frames > 0)
+        {
+            options.benchmark = true;
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            options.report = argv[++i];
+        }
+        else if (arg == "--lights" && i + 1 < argc && sscanf(argv[i + 1], "%d", &options.lights) == 1 && options.lights > 0)
+        {
+            if (!Supported("--lights", supported, OPTION_LIGHTS, "HW2"))
+                return false;
+            i++;
+        }
+        else if (arg == "--deferred")
+        {
+            if (!Supported("--deferred", supported, OPTION_DEFERRED, "HW2 and HW3"))
+                return false;
+            options.deferred = true;
+        }
+        else if (arg == "--prepass")
+        {
+            if (!Supported("--prepass", supported, OPTION_PREPASS, "HW2 and HW3"))
+                return false;
+            options.prepass = true;
+        }
+        else if (arg == "--single-pass")
+        {
+            if (!Supported("--single-pass", supported, OPTION_SINGLE_PASS, "HW2 and HW3"))
+                return false;
+            options.single_pass = true;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--headless[=egl|osmesa" << ((supported & OPTION_SOFTWARE) ? "|software" : "")
+                      << "]] [--output prefix] [--size WxH]"
+                      << " [--benchmark[=frames]] [--report path]"
+                      << ((supported & OPTION_LIGHTS) ? " [--lights count]" : "")
+                      << ((supported & OPTION_DEFERRED) ? " [--deferred]" : "")
+                      << ((supported & OPTION_PREPASS) ? " [--prepass]" : "")
+                      << ((supported & OPTION_SINGLE_PASS) ? " [--single-pass]" : "") << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,376 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static uint64_t HashVertex(size_t vertex, const VertexStream *streams, int stream_count)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (int s = 0; s < stream_count; s++)
+    {
+        const float *value = streams[s].data + vertex * streams[s].components;
+        for (int c = 0; c < streams[s].components; c++)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value[c], sizeof(bits));
+            h = (h ^ bits) * 1099511628211ull;
+        }
+    }
+    return h ^ (h >> 32);
+}
+
+size_t WeldVertices(size_t vertex_count, const VertexStream *streams, int stream_count,
+                    std::vector<float> *welded, std::vector<uint32_t> &indices)
+{
+    const uint32_t EMPTY = ~0u;
+
+    // open addressing table of welded vertex ids, kept at most 2/3 full
+    size_t table_size = 1;
+    while (table_size < vertex_count + vertex_count / 2)
+        table_size *= 2;
+    std::vector<uint32_t> table(table_size, EMPTY);
+
+    for (int s = 0; s < stream_count; s++)
+        welded[s].clear();
+    indices.resize(vertex_count);
+
+    uint32_t unique = 0;
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        size_t slot = HashVertex(v, streams, stream_count) & (table_size - 1);
+        for (;;)
+        {
+            uint32_t id = table[slot];
+            if (id == EMPTY)
+            {
+                table[slot] = unique;
+                for (int s = 0; s < stream_count; s++)
+                {
+                    const float *value = streams[s].data + v * streams[s].components;
+                    welded[s].insert(welded[s].end(), value, value + streams[s].components);
+                }
+                indices[v] = unique++;
+                break;
+            }
+
+            bool equal = true;
+            for (int s = 0; s < stream_count && equal; s++)
+            {
+                size_t size = streams[s].components * sizeof(float);
+                equal = memcmp(streams[s].data + v * streams[s].components,
+                               welded[s].data() + size_t(id) * streams[s].components, size) == 0;
+            }
+            if (equal)
+            {
+                indices[v] = id;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+    }
+    return unique;
+}
+
+// FIFO vertex cache simulated with time stamps: a vertex is cached while fewer than
+// cache_size misses happened since it was loaded
+struct VertexCache
+{
+    std::vector<size_t> loaded;
+    size_t time;
+    size_t size;
+
+    VertexCache(size_t vertex_count, unsigned int cache_size) : loaded(vertex_count, 0), time(cache_size + 1), size(cache_size) {}
+
+    bool cached(uint32_t v) const { return time - loaded[v] <= size; }
+
+    // returns the number of misses
+    unsigned int access(uint32_t v)
+    {
+        if (cached(v))
+            return 0;
+        loaded[v] = time++;
+        return 1;
+    }
+
+    void flush() { time += size + 1; }
+};
+
+float ComputeACMR(const uint32_t *indices, size_t index_count, size_t vertex_count, unsigned int cache_size)
+{
+    if (index_count < 3)
+        return 0.0f;
+
+    VertexCache cache(vertex_count, cache_size);
+    size_t misses = 0;
+    for (size_t i = 0; i < index_count; i++)
+        misses += cache.access(indices[i]);
+    return float(misses) / float(index_count / 3);
+}
+
+void OptimizeVertexCache(uint32_t *indices, size_t index_count, size_t vertex_count, unsigned int cache_size)
+{
+    size_t face_count = index_count / 3;
+    if (face_count == 0 || vertex_count == 0)
+        return;
+
+    // triangles around each vertex, and how many of them are not emitted yet
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < face_count * 3; i++)
+        live[indices[i]]++;
+    std::vector<uint32_t> first(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+        first[v + 1] = first[v] + live[v];
+    std::vector<uint32_t> adjacency(face_count * 3);
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < face_count * 3; i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint32_t> input(indices, indices + face_count * 3);
+    std::vector<char> emitted(face_count, 0);
+    std::vector<uint32_t> dead_end; // recently used vertices, to restart from when a fan runs dry
+    std::vector<uint32_t> candidates;
+    VertexCache cache(vertex_count, cache_size);
+
+    size_t out = 0;
+    size_t cursor = 0; // vertices before cursor have no live triangles left
+    int64_t fanning = 0;
+    while (fanning >= 0)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = first[fanning]; a < first[fanning + 1]; a++)
+        {
+            uint32_t t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            for (int c = 0; c < 3; c++)
+            {
+                uint32_t v = input[t * 3 + c];
+                indices[out++] = v;
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                cache.access(v);
+            }
+        }
+
+        // next fanning vertex: the candidate that stays in the cache the longest after its fan is emitted
+        fanning = -1;
+        size_t best = 0;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            size_t priority = 0;
+            if (cache.time - cache.loaded[v] + 2 * live[v] <= cache.size)
+                priority = cache.time - cache.loaded[v];
+            if (fanning < 0 || priority > best)
+            {
+                fanning = v;
+                best = priority;
+            }
+        }
+
+        // dead end: restart from a recently used vertex, or from the next vertex in input order
+        while (fanning < 0 && !dead_end.empty())
+        {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+        while (fanning < 0 && cursor < vertex_count)
+        {
+            if (live[cursor] > 0)
+                fanning = static_cast<int64_t>(cursor);
+            cursor++;
+        }
+    }
+}
+
+void OptimizeOverdraw(uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+                      float threshold, unsigned int cache_size)
+{
+    size_t face_count = index_count / 3;
+    if (face_count == 0 || vertex_count == 0)
+        return;
+
+    // hard boundaries: triangles missing the cache with all three vertices
+    std::vector<size_t> hard;
+    {
+        VertexCache cache(vertex_count, cache_size);
+        for (size_t t = 0; t < face_count; t++)
+        {
+            unsigned int misses = cache.access(indices[t * 3 + 0]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (misses == 3 || t == 0)
+                hard.push_back(t);
+        }
+    }
+    hard.push_back(face_count);
+
+    // soft boundaries: split a cluster as soon as its own ACMR gets close to the ACMR of the whole cluster
+    std::vector<size_t> clusters;
+    VertexCache cache(vertex_count, cache_size);
+    for (size_t h = 0; h + 1 < hard.size(); h++)
+    {
+        size_t start = hard[h], end = hard[h + 1];
+
+        cache.flush();
+        size_t cluster_misses = 0;
+        for (size_t i = start * 3; i < end * 3; i++)
+            cluster_misses += cache.access(indices[i]);
+        float cluster_threshold = threshold * float(cluster_misses) / float(end - start);
+
+        clusters.push_back(start);
+        cache.flush();
+        size_t running_misses = 0, running_faces = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            running_misses += cache.access(indices[t * 3 + 0]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            running_faces++;
+            if (float(running_misses) / float(running_faces) <= cluster_threshold && t + 1 < end)
+            {
+                clusters.push_back(t + 1);
+                cache.flush();
+                running_misses = running_faces = 0;
+            }
+        }
+
+        // a short tail after the last split would have a very high ACMR, merge it into the previous cluster
+        if (running_faces > 0 && clusters.back() != start)
+            clusters.pop_back();
+    }
+    clusters.push_back(face_count);
+
+    // centroid of the mesh, then the area weighted centroid and normal of every cluster
+    float center[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t i = 0; i < face_count * 3; i++)
+        for (int c = 0; c < 3; c++)
+            center[c] += positions[indices[i] * 3 + c];
+    for (int c = 0; c < 3; c++)
+        center[c] /= float(face_count * 3);
+
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> sort_key(cluster_count);
+    for (size_t k = 0; k < cluster_count; k++)
+    {
+        float area = 0.0f;
+        float centroid[3] = {0.0f, 0.0f, 0.0f};
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        for (size_t t = clusters[k]; t < clusters[k + 1]; t++)
+        {
+            const float *p0 = positions + indices[t * 3 + 0] * 3;
+            const float *p1 = positions + indices[t * 3 + 1] * 3;
+            const float *p2 = positions + indices[t * 3 + 2] * 3;
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int c = 0; c < 3; c++)
+            {
+                centroid[c] += (p0[c] + p1[c] + p2[c]) / 3.0f * a;
+                normal[c] += n[c];
+            }
+            area += a;
+        }
+
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (area <= 0.0f || length <= 0.0f)
+        {
+            sort_key[k] = -FLT_MAX;
+            continue;
+        }
+        float dp = 0.0f;
+        for (int c = 0; c < 3; c++)
+            dp += (centroid[c] / area - center[c]) * normal[c] / length;
+        sort_key[k] = dp;
+    }
+
+    std::vector<size_t> order(cluster_count);
+    for (size_t k = 0; k < cluster_count; k++)
+        order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&sort_key](size_t a, size_t b) { return sort_key[a] > sort_key[b]; });
+
+    std::vector<uint32_t> input(indices, indices + face_count * 3);
+    size_t out = 0;
+    for (size_t k : order)
+    {
+        for (size_t i = clusters[k] * 3; i < clusters[k + 1] * 3; i++)
+            indices[out++] = input[i];
+    }
+}
+
+void OptimizeTriangleOrder(uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+                           float *acmr_before, float *acmr_after)
+{
+    *acmr_before = ComputeACMR(indices, index_count, vertex_count);
+    OptimizeVertexCache(indices, index_count, vertex_count);
+    OptimizeOverdraw(indices, index_count, positions, vertex_count);
+    *acmr_after = ComputeACMR(indices, index_count, vertex_count);
+}
+
+void PackUnorm8(const float *rgb, uint8_t *rgba)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        float v = rgb[c] < 0.0f ? 0.0f : (rgb[c] > 1.0f ? 1.0f : rgb[c]);
+        rgba[c] = static_cast<uint8_t>(v * 255.0f + 0.5f);
+    }
+    rgba[3] = 255;
+}
+
+uint32_t PackSnorm10(const float *xyz)
+{
+    float length = std::sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+    uint32_t packed = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        float v = xyz[c] * scale;
+        v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+        int32_t q = static_cast<int32_t>(std::floor(v * 511.0f + 0.5f));
+        packed |= (static_cast<uint32_t>(q) & 0x3ff) << (10 * c);
+    }
+    return packed;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) // inf, nan
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+    int e = static_cast<int>(exponent) - 127 + 15;
+    if (e >= 31) // overflow
+        return sign | 0x7c00;
+
+    if (e <= 0) // half denormal or zero
+    {
+        if (e < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - e);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // may carry into the exponent, up to infinity, which is the correct rounding
+    return sign | static_cast<uint16_t>(half);
+}
@@ -0,0 +1,335 @@
+#ifdef _WIN32
+// before glad, which defines APIENTRY otherwise
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "Offscreen.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// The parts of egl.h and osmesa.h used below, so neither header is needed to build.
+typedef void (*OffscreenProc)(void);
+
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+typedef int32_t EGLint;
+typedef void *EGLDisplay;
+typedef void *EGLConfig;
+typedef void *EGLContext;
+typedef void *EGLSurface;
+
+constexpr EGLint EGL_NONE = 0x3038;
+constexpr EGLint EGL_RENDERABLE_TYPE = 0x3040;
+constexpr EGLint EGL_OPENGL_BIT = 0x0008;
+constexpr EGLint EGL_CONTEXT_MAJOR_VERSION = 0x3098;
+constexpr EGLint EGL_CONTEXT_MINOR_VERSION = 0x30FB;
+constexpr EGLint EGL_CONTEXT_OPENGL_PROFILE_MASK = 0x30FD;
+constexpr EGLint EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT = 0x0001;
+constexpr EGLenum EGL_OPENGL_API = 0x30A2;
+constexpr EGLenum EGL_PLATFORM_SURFACELESS_MESA = 0x31DD;
+
+typedef void *OSMesaContext;
+
+constexpr int OSMESA_FORMAT = 0x22;
+constexpr int OSMESA_DEPTH_BITS = 0x30;
+constexpr int OSMESA_STENCIL_BITS = 0x31;
+constexpr int OSMESA_PROFILE = 0x33;
+constexpr int OSMESA_CORE_PROFILE = 0x34;
+constexpr int OSMESA_CONTEXT_MAJOR_VERSION = 0x36;
+constexpr int OSMESA_CONTEXT_MINOR_VERSION = 0x37;
+
+// entry points of the opened library, there is at most one OffscreenContext
+static struct
+{
+    OffscreenProc (APIENTRY *getProcAddress)(const char *name);
+
+    EGLDisplay (APIENTRY *eglGetDisplay)(void *native_display);
+    EGLDisplay (APIENTRY *eglGetPlatformDisplayEXT)(EGLenum platform, void *native_display, const EGLint *attrib_list);
+    EGLBoolean (APIENTRY *eglInitialize)(EGLDisplay display, EGLint *major, EGLint *minor);
+    EGLBoolean (APIENTRY *eglTerminate)(EGLDisplay display);
+    EGLBoolean (APIENTRY *eglBindAPI)(EGLenum api);
+    EGLBoolean (APIENTRY *eglChooseConfig)(EGLDisplay display, const EGLint *attrib_list, EGLConfig *configs, EGLint config_size, EGLint *num_config);
+    EGLContext (APIENTRY *eglCreateContext)(EGLDisplay display, EGLConfig config, EGLContext share_context, const EGLint *attrib_list);
+    EGLBoolean (APIENTRY *eglDestroyContext)(EGLDisplay display, EGLContext context);
+    EGLBoolean (APIENTRY *eglMakeCurrent)(EGLDisplay display, EGLSurface draw, EGLSurface read, EGLContext context);
+
+    OSMesaContext (APIENTRY *OSMesaCreateContextAttribs)(const int *attrib_list, OSMesaContext sharelist);
+    void (APIENTRY *OSMesaDestroyContext)(OSMesaContext context);
+    GLboolean (APIENTRY *OSMesaMakeCurrent)(OSMesaContext context, void *buffer, GLenum type, GLsizei width, GLsizei height);
+} api;
+
+static void *OpenLibrary(const char *const *names)
+{
+    for (; *names != NULL; names++)
+    {
+#ifdef _WIN32
+        void *library = LoadLibraryA(*names);
+#else
+        void *library = dlopen(*names, RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (library != NULL)
+            return library;
+    }
+    return NULL;
+}
+
+static void CloseLibrary(void *library)
+{
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+
+// casts the symbol to the type of the function pointer it is stored in
+template <typename T>
+static bool LoadSymbol(void *library, const char *name, T &function)
+{
+#ifdef _WIN32
+    function = reinterpret_cast<T>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+    function = reinterpret_cast<T>(dlsym(library, name));
+#endif
+    if (function == NULL)
+        std::cout << "OffscreenContext: missing " << name << std::endl;
+    return function != NULL;
+}
+
+static void *LoadGLProc(const char *name)
+{
+    return reinterpret_cast<void *>(api.getProcAddress(name));
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    destroy();
+}
+
+bool OffscreenContext::create(const std::string &backend, int width, int height)
+{
+    destroy();
+    backend_ = backend;
+    width_ = width;
+    height_ = height;
+
+    bool created = false;
+    if (backend == "egl")
+        created = createEGL();
+    else if (backend == "osmesa")
+        created = createOSMesa();
+    else
+        std::cout << "OffscreenContext: unknown backend " << backend << std::endl;
+
+    if (created && !gladLoadGLLoader(LoadGLProc))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        created = false;
+    }
+    if (created)
+        created = createFramebuffer();
+    if (!created)
+        destroy();
+    return created;
+}
+
+// a surfaceless display (Mesa), or the default display of drivers rendering without a window system
+bool OffscreenContext::createEGL()
+{
+#ifdef _WIN32
+    const char *names[] = {"libEGL.dll", NULL};
+#else
+    const char *names[] = {"libEGL.so.1", "libEGL.so", NULL};
+#endif
+    library_ = OpenLibrary(names);
+    if (library_ == NULL)
+    {
+        std::cout << "OffscreenContext: cannot open the EGL library" << std::endl;
+        return false;
+    }
+
+    if (!LoadSymbol(library_, "eglGetProcAddress", api.getProcAddress) ||
+        !LoadSymbol(library_, "eglGetDisplay", api.eglGetDisplay) ||
+        !LoadSymbol(library_, "eglInitialize", api.eglInitialize) ||
+        !LoadSymbol(library_, "eglTerminate", api.eglTerminate) ||
+        !LoadSymbol(library_, "eglBindAPI", api.eglBindAPI) ||
+        !LoadSymbol(library_, "eglChooseConfig", api.eglChooseConfig) ||
+        !LoadSymbol(library_, "eglCreateContext", api.eglCreateContext) ||
+        !LoadSymbol(library_, "eglDestroyContext", api.eglDestroyContext) ||
+        !LoadSymbol(library_, "eglMakeCurrent", api.eglMakeCurrent))
+        return false;
+
+    api.eglGetPlatformDisplayEXT = reinterpret_cast<decltype(api.eglGetPlatformDisplayEXT)>(api.getProcAddress("eglGetPlatformDisplayEXT"));
+    if (api.eglGetPlatformDisplayEXT != NULL)
+    {
+        display_ = api.eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+        if (display_ != NULL && !api.eglInitialize(display_, NULL, NULL))
+            display_ = NULL;
+    }
+    if (display_ == NULL)
+    {
+        display_ = api.eglGetDisplay(NULL);
+        if (display_ != NULL && !api.eglInitialize(display_, NULL, NULL))
+            display_ = NULL;
+    }
+    if (display_ == NULL)
+    {
+        std::cout << "OffscreenContext: cannot initialize an EGL display" << std::endl;
+        return false;
+    }
+
+    // no surface is ever created, a config is only needed by drivers without EGL_KHR_no_config_context
+    const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config = NULL;
+    EGLint config_count = 0;
+    if (!api.eglChooseConfig(display_, config_attribs, &config, 1, &config_count) || config_count == 0)
+        config = NULL;
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    api.eglBindAPI(EGL_OPENGL_API);
+    context_ = api.eglCreateContext(display_, config, NULL, context_attribs);
+    if (context_ == NULL || !api.eglMakeCurrent(display_, NULL, NULL, context_))
+    {
+        std::cout << "OffscreenContext: cannot create an OpenGL 3.3 core context through EGL" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool OffscreenContext::createOSMesa()
+{
+#ifdef _WIN32
+    const char *names[] = {"osmesa.dll", NULL};
+#else
+    const char *names[] = {"libOSMesa.so.8", "libOSMesa.so.6", "libOSMesa.so", NULL};
+#endif
+    library_ = OpenLibrary(names);
+    if (library_ == NULL)
+    {
+        std::cout << "OffscreenContext: cannot open the OSMesa library" << std::endl;
+        return false;
+    }
+
+    if (!LoadSymbol(library_, "OSMesaGetProcAddress", api.getProcAddress) ||
+        !LoadSymbol(library_, "OSMesaCreateContextAttribs", api.OSMesaCreateContextAttribs) ||
+        !LoadSymbol(library_, "OSMesaDestroyContext", api.OSMesaDestroyContext) ||
+        !LoadSymbol(library_, "OSMesaMakeCurrent", api.OSMesaMakeCurrent))
+        return false;
+
+    const int attribs[] = {
+        OSMESA_FORMAT, GL_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_STENCIL_BITS, 8,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0};
+    context_ = api.OSMesaCreateContextAttribs(attribs, NULL);
+    osmesa_buffer_.resize(size_t(width_) * size_t(height_) * 4);
+    if (context_ == NULL || !api.OSMesaMakeCurrent(context_, osmesa_buffer_.data(), GL_UNSIGNED_BYTE, width_, height_))
+    {
+        std::cout << "OffscreenContext: cannot create an OpenGL 3.3 core context through OSMesa" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the same render target with both backends, so the images do not depend on the default framebuffer
+bool OffscreenContext::createFramebuffer()
+{
+    glGenRenderbuffers(1, &color_);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    glGenRenderbuffers(1, &depth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "OffscreenContext: incomplete framebuffer" << std::endl;
+        return false;
+    }
+
+    glViewport(0, 0, width_, height_);
+    return true;
+}
+
+void OffscreenContext::destroy()
+{
+    if (context_ != NULL)
+    {
+        if (fbo_ != 0)
+        {
+            glDeleteFramebuffers(1, &fbo_);
+            glDeleteRenderbuffers(1, &color_);
+            glDeleteRenderbuffers(1, &depth_);
+        }
+
+        if (backend_ == "egl")
+        {
+            api.eglMakeCurrent(display_, NULL, NULL, NULL);
+            api.eglDestroyContext(display_, context_);
+        }
+        else
+        {
+            api.OSMesaDestroyContext(context_);
+        }
+    }
+    if (display_ != NULL)
+        api.eglTerminate(display_);
+    if (library_ != NULL)
+        CloseLibrary(library_);
+
+    library_ = NULL;
+    display_ = NULL;
+    context_ = NULL;
+    fbo_ = color_ = depth_ = 0;
+    osmesa_buffer_.clear();
+}
+
+bool OffscreenContext::writeImage(const std::string &path) const
+{
+    std::vector<unsigned char> pixels(size_t(width_) * size_t(height_) * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return WriteImagePPM(path, width_, height_, pixels.data());
+}
+
+bool WriteImagePPM(const std::string &path, int width, int height, const unsigned char *rgba)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        std::cout << "WriteImagePPM: cannot write " << path << std::endl;
+        return false;
+    }
+
+    // PPM rows go top to bottom, GL rows bottom to top
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(size_t(width) * 3);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        const unsigned char *src = &rgba[size_t(y) * size_t(width) * 4];
+        for (int x = 0; x < width; x++)
+            memcpy(&row[size_t(x) * 3], &src[size_t(x) * 4], 3);
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    bool written = !ferror(file);
+    fclose(file);
+    return written;
+}
@@ -0,0 +1,31 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+// Binary cache of a linked shader program, built on glGetProgramBinary / glProgramBinary.
+// A binary only loads into the driver that produced it, so the key hashes the shader sources
+// together with GL_VENDOR, GL_RENDERER and GL_VERSION. Without GL 4.1 or a binary format,
+// or whenever the driver rejects a binary, programs are linked from source as before.
+//
+// Layout (native endian): magic, version, key (64 bit), binary format, binary length, binary
+
+constexpr uint32_t PROGRAM_CACHE_MAGIC = 0x47525043; // "CPRG"
+constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// key of a program linked from these sources by the current context
+uint64_t ProgramCacheKey(const char *vertex_source, const char *fragment_source);
+
+// Links program from the cache file. Returns false, leaving program unlinked for a build from
+// source, if the cache is missing, stale or rejected. Hits and misses are logged.
+bool LoadProgramBinary(const std::string &cache_path, uint64_t key, GLuint program);
+
+// call before glLinkProgram, so the driver keeps the binary of program for SaveProgramBinary
+void PrepareProgramBinary(GLuint program);
+
+bool SaveProgramBinary(const std::string &cache_path, uint64_t key, GLuint program);
+
+#endif
@@ -26,36 +26,36 @@ struct Vector2
     float y;
 
     // ctors
-    Vector2() : x(0), y(0) {};
-    Vector2(float x, float y) : x(x), y(y) {};
+    constexpr Vector2() : x(0), y(0) {};
+    constexpr Vector2(float x, float y) : x(x), y(y) {};
 
     // utils functions
-    void        set(float x, float y);
-    float       length() const;                         //
-    float       distance(const Vector2& vec) const;     // distance between two vectors
-    Vector2&    normalize();                            //
-    float       dot(const Vector2& vec) const;          // dot product
+    constexpr void        set(float x, float y);
+    float       length() const;                           //
+    float       distance(const Vector2& vec) const;       // distance between two vectors
+    Vector2&    normalize();                              //
+    constexpr float       dot(const Vector2& vec) const;  // dot product
     bool        equal(const Vector2& vec, float e) const; // compare with epsilon
 
     // operators
-    Vector2     operator-() const;                      // unary operator (negate)
-    Vector2     operator+(const Vector2& rhs) const;    // add rhs
-    Vector2     operator-(const Vector2& rhs) const;    // subtract rhs
-    Vector2&    operator+=(const Vector2& rhs);         // add rhs and update this object
-    Vector2&    operator-=(const Vector2& rhs);         // subtract rhs and update this object
-    Vector2     operator*(const float scale) const;     // scale
-    Vector2     operator*(const Vector2& rhs) const;    // multiply each element
-    Vector2&    operator*=(const float scale);          // scale and update this object
-    Vector2&    operator*=(const Vector2& rhs);         // multiply each element and update this object
-    Vector2     operator/(const float scale) const;     // inverse scale
-    Vector2&    operator/=(const float scale);          // scale and update this object
-    bool        operator==(const Vector2& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Vector2& rhs) const;   // exact compare, no epsilon
-    bool        operator<(const Vector2& rhs) const;    // comparison for sort
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Vector2 operator*(const float a, const Vector2 vec);
+    constexpr Vector2     operator-() const;                    // unary operator (negate)
+    constexpr Vector2     operator+(const Vector2& rhs) const;  // add rhs
+    constexpr Vector2     operator-(const Vector2& rhs) const;  // subtract rhs
+    constexpr Vector2&    operator+=(const Vector2& rhs);       // add rhs and update this object
+    constexpr Vector2&    operator-=(const Vector2& rhs);       // subtract rhs and update this object
+    constexpr Vector2     operator*(const float scale) const;   // scale
+    constexpr Vector2     operator*(const Vector2& rhs) const;  // multiply each element
+    constexpr Vector2&    operator*=(const float scale);        // scale and update this object
+    constexpr Vector2&    operator*=(const Vector2& rhs);       // multiply each element and update this object
+    constexpr Vector2     operator/(const float scale) const;   // inverse scale
+    constexpr Vector2&    operator/=(const float scale);        // scale and update this object
+    constexpr bool        operator==(const Vector2& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Vector2& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator<(const Vector2& rhs) const;  // comparison for sort
+    float       operator[](int index) const;                    // subscript operator v[0], v[1]
+    float&      operator[](int index);                          // subscript operator v[0], v[1]
+
+    friend constexpr Vector2 operator*(const float a, const Vector2 vec);
     friend std::ostream& operator<<(std::ostream& os, const Vector2& vec);
 };
 
@@ -71,37 +71,37 @@ struct Vector3
     float z;
 
     // ctors
-    Vector3() : x(0), y(0), z(0) {};
-    Vector3(float x, float y, float z) : x(x), y(y), z(z) {};
+    constexpr Vector3() : x(0), y(0), z(0) {};
+    constexpr Vector3(float x, float y, float z) : x(x), y(y), z(z) {};
 
     // utils functions
-    void        set(float x, float y, float z);
-    float       length() const;                         //
-    float       distance(const Vector3& vec) const;     // distance between two vectors
-    Vector3&    normalize();                            //
-    float       dot(const Vector3& vec) const;          // dot product
-    Vector3     cross(const Vector3& vec) const;        // cross product
-    bool        equal(const Vector3& vec, float e) const; // compare with epsilon
+    constexpr void        set(float x, float y, float z);
+    float       length() const;                            //
+    float       distance(const Vector3& vec) const;        // distance between two vectors
+    Vector3&    normalize();                               //
+    constexpr float       dot(const Vector3& vec) const;   // dot product
+    constexpr Vector3     cross(const Vector3& vec) const; // cross product
+    bool        equal(const Vector3& vec, float e) const;  // compare with epsilon
 
     // operators
-    Vector3     operator-() const;                      // unary operator (negate)
-    Vector3     operator+(const Vector3& rhs) const;    // add rhs
-    Vector3     operator-(const Vector3& rhs) const;    // subtract rhs
-    Vector3&    operator+=(const Vector3& rhs);         // add rhs and update this object
-    Vector3&    operator-=(const Vector3& rhs);         // subtract rhs and update this object
-    Vector3     operator*(const float scale) const;     // scale
-    Vector3     operator*(const Vector3& rhs) const;    // multiplay each element
-    Vector3&    operator*=(const float scale);          // scale and update this object
-    Vector3&    operator*=(const Vector3& rhs);         // product each element and update this object
-    Vector3     operator/(const float scale) const;     // inverse scale
-    Vector3&    operator/=(const float scale);          // scale and update this object
-    bool        operator==(const Vector3& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Vector3& rhs) const;   // exact compare, no epsilon
-    bool        operator<(const Vector3& rhs) const;    // comparison for sort
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Vector3 operator*(const float a, const Vector3 vec);
+    constexpr Vector3     operator-() const;                    // unary operator (negate)
+    constexpr Vector3     operator+(const Vector3& rhs) const;  // add rhs
+    constexpr Vector3     operator-(const Vector3& rhs) const;  // subtract rhs
+    constexpr Vector3&    operator+=(const Vector3& rhs);       // add rhs and update this object
+    constexpr Vector3&    operator-=(const Vector3& rhs);       // subtract rhs and update this object
+    constexpr Vector3     operator*(const float scale) const;   // scale
+    constexpr Vector3     operator*(const Vector3& rhs) const;  // multiplay each element
+    constexpr Vector3&    operator*=(const float scale);        // scale and update this object
+    constexpr Vector3&    operator*=(const Vector3& rhs);       // product each element and update this object
+    constexpr Vector3     operator/(const float scale) const;   // inverse scale
+    constexpr Vector3&    operator/=(const float scale);        // scale and update this object
+    constexpr bool        operator==(const Vector3& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Vector3& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator<(const Vector3& rhs) const;  // comparison for sort
+    float       operator[](int index) const;                    // subscript operator v[0], v[1]
+    float&      operator[](int index);                          // subscript operator v[0], v[1]
+
+    friend constexpr Vector3 operator*(const float a, const Vector3 vec);
     friend std::ostream& operator<<(std::ostream& os, const Vector3& vec);
 };
 
@@ -118,36 +118,36 @@ struct Vector4
     float w;
 
     // ctors
-    Vector4() : x(0), y(0), z(0), w(0) {};
-    Vector4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {};
+    constexpr Vector4() : x(0), y(0), z(0), w(0) {};
+    constexpr Vector4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {};
 
     // utils functions
-    void        set(float x, float y, float z, float w);
-    float       length() const;                         //
-    float       distance(const Vector4& vec) const;     // distance between two vectors
-    Vector4&    normalize();                            //
-    float       dot(const Vector4& vec) const;          // dot product
+    constexpr void        set(float x, float y, float z, float w);
+    float       length() const;                           //
+    float       distance(const Vector4& vec) const;       // distance between two vectors
+    Vector4&    normalize();                              //
+    constexpr float       dot(const Vector4& vec) const;  // dot product
     bool        equal(const Vector4& vec, float e) const; // compare with epsilon
 
     // operators
-    Vector4     operator-() const;                      // unary operator (negate)
-    Vector4     operator+(const Vector4& rhs) const;    // add rhs
-    Vector4     operator-(const Vector4& rhs) const;    // subtract rhs
-    Vector4&    operator+=(const Vector4& rhs);         // add rhs and update this object
-    Vector4&    operator-=(const Vector4& rhs);         // subtract rhs and update this object
-    Vector4     operator*(const float scale) const;     // scale
-    Vector4     operator*(const Vector4& rhs) const;    // multiply each element
-    Vector4&    operator*=(const float scale);          // scale and update this object
-    Vector4&    operator*=(const Vector4& rhs);         // multiply each element and update this object
-    Vector4     operator/(const float scale) const;     // inverse scale
-    Vector4&    operator/=(const float scale);          // scale and update this object
-    bool        operator==(const Vector4& rhs) const;   // exact compare, no epsilon
-    bool        operator!=(const Vector4& rhs) const;   // exact compare, no epsilon
-    bool        operator<(const Vector4& rhs) const;    // comparison for sort
-    float       operator[](int index) const;            // subscript operator v[0], v[1]
-    float&      operator[](int index);                  // subscript operator v[0], v[1]
-
-    friend Vector4 operator*(const float a, const Vector4 vec);
+    constexpr Vector4     operator-() const;                    // unary operator (negate)
+    constexpr Vector4     operator+(const Vector4& rhs) const;  // add rhs
+    constexpr Vector4     operator-(const Vector4& rhs) const;  // subtract rhs
+    constexpr Vector4&    operator+=(const Vector4& rhs);       // add rhs and update this object
+    constexpr Vector4&    operator-=(const Vector4& rhs);       // subtract rhs and update this object
+    constexpr Vector4     operator*(const float scale) const;   // scale
+    constexpr Vector4     operator*(const Vector4& rhs) const;  // multiply each element
+    constexpr Vector4&    operator*=(const float scale);        // scale and update this object
+    constexpr Vector4&    operator*=(const Vector4& rhs);       // multiply each element and update this object
+    constexpr Vector4     operator/(const float scale) const;   // inverse scale
+    constexpr Vector4&    operator/=(const float scale);        // scale and update this object
+    constexpr bool        operator==(const Vector4& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator!=(const Vector4& rhs) const; // exact compare, no epsilon
+    constexpr bool        operator<(const Vector4& rhs) const;  // comparison for sort
+    float       operator[](int index) const;                    // subscript operator v[0], v[1]
+    float&      operator[](int index);                          // subscript operator v[0], v[1]
+
+    friend constexpr Vector4 operator*(const float a, const Vector4 vec);
     friend std::ostream& operator<<(std::ostream& os, const Vector4& vec);
 };
 
@@ -169,59 +169,59 @@ inline float invSqrt(float x)
 ///////////////////////////////////////////////////////////////////////////////
 // inline functions for Vector2
 ///////////////////////////////////////////////////////////////////////////////
-inline Vector2 Vector2::operator-() const {
+constexpr Vector2 Vector2::operator-() const {
     return Vector2(-x, -y);
 }
 
-inline Vector2 Vector2::operator+(const Vector2& rhs) const {
+constexpr Vector2 Vector2::operator+(const Vector2& rhs) const {
     return Vector2(x+rhs.x, y+rhs.y);
 }
 
-inline Vector2 Vector2::operator-(const Vector2& rhs) const {
+constexpr Vector2 Vector2::operator-(const Vector2& rhs) const {
     return Vector2(x-rhs.x, y-rhs.y);
 }
 
-inline Vector2& Vector2::operator+=(const Vector2& rhs) {
+constexpr Vector2& Vector2::operator+=(const Vector2& rhs) {
     x += rhs.x; y += rhs.y; return *this;
 }
 
-inline Vector2& Vector2::operator-=(const Vector2& rhs) {
+constexpr Vector2& Vector2::operator-=(const Vector2& rhs) {
     x -= rhs.x; y -= rhs.y; return *this;
 }
 
-inline Vector2 Vector2::operator*(const float a) const {
+constexpr Vector2 Vector2::operator*(const float a) const {
     return Vector2(x*a, y*a);
 }
 
-inline Vector2 Vector2::operator*(const Vector2& rhs) const {
+constexpr Vector2 Vector2::operator*(const Vector2& rhs) const {
     return Vector2(x*rhs.x, y*rhs.y);
 }
 
-inline Vector2& Vector2::operator*=(const float a) {
+constexpr Vector2& Vector2::operator*=(const float a) {
     x *= a; y *= a; return *this;
 }
 
-inline Vector2& Vector2::operator*=(const Vector2& rhs) {
+constexpr Vector2& Vector2::operator*=(const Vector2& rhs) {
     x *= rhs.x; y *= rhs.y; return *this;
 }
 
-inline Vector2 Vector2::operator/(const float a) const {
+constexpr Vector2 Vector2::operator/(const float a) const {
     return Vector2(x/a, y/a);
 }
 
-inline Vector2& Vector2::operator/=(const float a) {
+constexpr Vector2& Vector2::operator/=(const float a) {
     x /= a; y /= a; return *this;
 }
 
-inline bool Vector2::operator==(const Vector2& rhs) const {
+constexpr bool Vector2::operator==(const Vector2& rhs) const {
     return (x == rhs.x) && (y == rhs.y);
 }
 
-inline bool Vector2::operator!=(const Vector2& rhs) const {
+constexpr bool Vector2::operator!=(const Vector2& rhs) const {
     return (x != rhs.x) || (y != rhs.y);
 }
 
-inline bool Vector2::operator<(const Vector2& rhs) const {
+constexpr bool Vector2::operator<(const Vector2& rhs) const {
     if(x < rhs.x) return true;
     if(x > rhs.x) return false;
     if(y < rhs.y) return true;
@@ -237,7 +237,7 @@ inline float& Vector2::operator[](int index) {
     return (&x)[index];
 }
 
-inline void Vector2::set(float x, float y) {
+constexpr void Vector2::set(float x, float y) {
     this->x = x; this->y = y;
 }
 
@@ -262,7 +262,7 @@ inline Vector2& Vector2::normalize() {
     return *this;
 }
 
-inline float Vector2::dot(const Vector2& rhs) const {
+constexpr float Vector2::dot(const Vector2& rhs) const {
     return (x*rhs.x + y*rhs.y);
 }
 
@@ -270,7 +270,7 @@ inline bool Vector2::equal(const Vector2& rhs, float epsilon) const {
     return fabs(x - rhs.x) < epsilon && fabs(y - rhs.y) < epsilon;
 }
 
-inline Vector2 operator*(const float a, const Vector2 vec) {
+constexpr Vector2 operator*(const float a, const Vector2 vec) {
     return Vector2(a*vec.x, a*vec.y);
 }
 
@@ -286,59 +286,59 @@ inline std::ostream& operator<<(std::ostream& os, const Vector2& vec) {
 ///////////////////////////////////////////////////////////////////////////////
 // inline functions for Vector3
 ///////////////////////////////////////////////////////////////////////////////
-inline Vector3 Vector3::operator-() const {
+constexpr Vector3 Vector3::operator-() const {
     return Vector3(-x, -y, -z);
 }
 
-inline Vector3 Vector3::operator+(const Vector3& rhs) const {
+constexpr Vector3 Vector3::operator+(const Vector3& rhs) const {
     return Vector3(x+rhs.x, y+rhs.y, z+rhs.z);
 }
 
-inline Vector3 Vector3::operator-(const Vector3& rhs) const {
+constexpr Vector3 Vector3::operator-(const Vector3& rhs) const {
     return Vector3(x-rhs.x, y-rhs.y, z-rhs.z);
 }
 
-inline Vector3& Vector3::operator+=(const Vector3& rhs) {
+constexpr Vector3& Vector3::operator+=(const Vector3& rhs) {
     x += rhs.x; y += rhs.y; z += rhs.z; return *this;
 }
 
-inline Vector3& Vector3::operator-=(const Vector3& rhs) {
+constexpr Vector3& Vector3::operator-=(const Vector3& rhs) {
     x -= rhs.x; y -= rhs.y; z -= rhs.z; return *this;
 }
 
-inline Vector3 Vector3::operator*(const float a) const {
+constexpr Vector3 Vector3::operator*(const float a) const {
     return Vector3(x*a, y*a, z*a);
 }
 
-inline Vector3 Vector3::operator*(const Vector3& rhs) const {
+constexpr Vector3 Vector3::operator*(const Vector3& rhs) const {
     return Vector3(x*rhs.x, y*rhs.y, z*rhs.z);
 }
 
-inline Vector3& Vector3::operator*=(const float a) {
+constexpr Vector3& Vector3::operator*=(const float a) {
     x *= a; y *= a; z *= a; return *this;
 }
 
-inline Vector3& Vector3::operator*=(const Vector3& rhs) {
+constexpr Vector3& Vector3::operator*=(const Vector3& rhs) {
     x *= rhs.x; y *= rhs.y; z *= rhs.z; return *this;
 }
 
-inline Vector3 Vector3::operator/(const float a) const {
+constexpr Vector3 Vector3::operator/(const float a) const {
     return Vector3(x/a, y/a, z/a);
 }
 
-inline Vector3& Vector3::operator/=(const float a) {
+constexpr Vector3& Vector3::operator/=(const float a) {
     x /= a; y /= a; z /= a; return *this;
 }
 
-inline bool Vector3::operator==(const Vector3& rhs) const {
+constexpr bool Vector3::operator==(const Vector3& rhs) const {
     return (x == rhs.x) && (y == rhs.y) && (z == rhs.z);
 }
 
-inline bool Vector3::operator!=(const Vector3& rhs) const {
+constexpr bool Vector3::operator!=(const Vector3& rhs) const {
     return (x != rhs.x) || (y != rhs.y) || (z != rhs.z);
 }
 
-inline bool Vector3::operator<(const Vector3& rhs) const {
+constexpr bool Vector3::operator<(const Vector3& rhs) const {
     if(x < rhs.x) return true;
     if(x > rhs.x) return false;
     if(y < rhs.y) return true;
@@ -356,7 +356,7 @@ inline float& Vector3::operator[](int index) {
     return (&x)[index];
 }
 
-inline void Vector3::set(float x, float y, float z) {
+constexpr void Vector3::set(float x, float y, float z) {
     this->x = x; this->y = y; this->z = z;
 }
 
@@ -382,11 +382,11 @@ inline Vector3& Vector3::normalize() {
     return *this;
 }
 
-inline float Vector3::dot(const Vector3& rhs) const {
+constexpr float Vector3::dot(const Vector3& rhs) const {
     return (x*rhs.x + y*rhs.y + z*rhs.z);
 }
 
-inline Vector3 Vector3::cross(const Vector3& rhs) const {
+constexpr Vector3 Vector3::cross(const Vector3& rhs) const {
     return Vector3(y*rhs.z - z*rhs.y, z*rhs.x - x*rhs.z, x*rhs.y - y*rhs.x);
 }
 
@@ -394,7 +394,7 @@ inline bool Vector3::equal(const Vector3& rhs, float epsilon) const {
     return fabs(x - rhs.x) < epsilon && fabs(y - rhs.y) < epsilon && fabs(z - rhs.z) < epsilon;
 }
 
-inline Vector3 operator*(const float a, const Vector3 vec) {
+constexpr Vector3 operator*(const float a, const Vector3 vec) {
     return Vector3(a*vec.x, a*vec.y, a*vec.z);
 }
 
@@ -409,59 +409,59 @@ inline std::ostream& operator<<(std::ostream& os, const Vector3& vec) {
 ///////////////////////////////////////////////////////////////////////////////
 // inline functions for Vector4
 ///////////////////////////////////////////////////////////////////////////////
-inline Vector4 Vector4::operator-() const {
+constexpr Vector4 Vector4::operator-() const {
     return Vector4(-x, -y, -z, -w);
 }
 
-inline Vector4 Vector4::operator+(const Vector4& rhs) const {
+constexpr Vector4 Vector4::operator+(const Vector4& rhs) const {
     return Vector4(x+rhs.x, y+rhs.y, z+rhs.z, w+rhs.w);
 }
 
-inline Vector4 Vector4::operator-(const Vector4& rhs) const {
+constexpr Vector4 Vector4::operator-(const Vector4& rhs) const {
     return Vector4(x-rhs.x, y-rhs.y, z-rhs.z, w-rhs.w);
 }
 
-inline Vector4& Vector4::operator+=(const Vector4& rhs) {
+constexpr Vector4& Vector4::operator+=(const Vector4& rhs) {
     x += rhs.x; y += rhs.y; z += rhs.z; w += rhs.w; return *this;
 }
 
-inline Vector4& Vector4::operator-=(const Vector4& rhs) {
+constexpr Vector4& Vector4::operator-=(const Vector4& rhs) {
     x -= rhs.x; y -= rhs.y; z -= rhs.z; w -= rhs.w; return *this;
 }
 
-inline Vector4 Vector4::operator*(const float a) const {
+constexpr Vector4 Vector4::operator*(const float a) const {
     return Vector4(x*a, y*a, z*a, w*a);
 }
 
-inline Vector4 Vector4::operator*(const Vector4& rhs) const {
+constexpr Vector4 Vector4::operator*(const Vector4& rhs) const {
     return Vector4(x*rhs.x, y*rhs.y, z*rhs.z, w*rhs.w);
 }
 
-inline Vector4& Vector4::operator*=(const float a) {
+constexpr Vector4& Vector4::operator*=(const float a) {
     x *= a; y *= a; z *= a; w *= a; return *this;
 }
 
-inline Vector4& Vector4::operator*=(const Vector4& rhs) {
+constexpr Vector4& Vector4::operator*=(const Vector4& rhs) {
     x *= rhs.x; y *= rhs.y; z *= rhs.z; w *= rhs.w; return *this;
 }
 
-inline Vector4 Vector4::operator/(const float a) const {
+constexpr Vector4 Vector4::operator/(const float a) const {
     return Vector4(x/a, y/a, z/a, w/a);
 }
 
-inline Vector4& Vector4::operator/=(const float a) {
+constexpr Vector4& Vector4::operator/=(const float a) {
     x /= a; y /= a; z /= a; w /= a; return *this;
 }
 
-inline bool Vector4::operator==(const Vector4& rhs) const {
+constexpr bool Vector4::operator==(const Vector4& rhs) const {
     return (x == rhs.x) && (y == rhs.y) && (z == rhs.z) && (w == rhs.w);
 }
 
-inline bool Vector4::operator!=(const Vector4& rhs) const {
+constexpr bool Vector4::operator!=(const Vector4& rhs) const {
     return (x != rhs.x) || (y != rhs.y) || (z != rhs.z) || (w != rhs.w);
 }
 
-inline bool Vector4::operator<(const Vector4& rhs) const {
+constexpr bool Vector4::operator<(const Vector4& rhs) const {
     if(x < rhs.x) return true;
     if(x > rhs.x) return false;
     if(y < rhs.y) return true;
@@ -481,7 +481,7 @@ inline float& Vector4::operator[](int index) {
     return (&x)[index];
 }
 
-inline void Vector4::set(float x, float y, float z, float w) {
+constexpr void Vector4::set(float x, float y, float z, float w) {
     this->x = x; this->y = y; this->z = z; this->w = w;
 }
 
@@ -508,7 +508,7 @@ inline Vector4& Vector4::normalize() {
     return *this;
 }
 
-inline float Vector4::dot(const Vector4& rhs) const {
+constexpr float Vector4::dot(const Vector4& rhs) const {
     return (x*rhs.x + y*rhs.y + z*rhs.z + w*rhs.w);
 }
 
@@ -517,7 +517,7 @@ inline bool Vector4::equal(const Vector4& rhs, float epsilon) const {
            fabs(z - rhs.z) < epsilon && fabs(w - rhs.w) < epsilon;
 }
 
-inline Vector4 operator*(const float a, const Vector4 vec) {
+constexpr Vector4 operator*(const float a, const Vector4 vec) {
     return Vector4(a*vec.x, a*vec.y, a*vec.z, a*vec.w);
 }
 
@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <math.h>
@@ -7,6 +8,11 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "textfile.h"
+#include "MeshOptimizer.h"
+#include "Benchmark.h"
+#include "CommandLine.h"
+#include "Offscreen.h"
+#include "ProgramCache.h"
 
 #include "Matrices.h"
 #include "Vectors.h"
@@ -70,10 +76,17 @@ struct model
     Vector3 position = Vector3(0, 0, 0);
     Vector3 scale = Vector3(1, 1, 1);
     Vector3 rotation = Vector3(0, 0, 0); // Euler form
+
+    // translate(position) * rotate(rotation) * scaling(scale), rebuilt by UpdateModelMatrix()
+    // after the callbacks marked it dirty
+    Matrix4 matrix;
+    bool dirty = true;
 };
 vector<model> models;
 int cur_idx = 0; // represent which model should be rendered now
 
+vector<string> model_list{"../ColorModels/bunny5KC.obj", "../ColorModels/dragon10KC.obj", "../ColorModels/lucy25KC.obj", "../ColorModels/teapot4KC.obj", "../ColorModels/dolphinC.obj"};
+
 struct camera
 {
     Vector3 position;
@@ -112,7 +125,7 @@ static GLvoid Cross(GLfloat u[3], GLfloat v[3], GLfloat n[3])
 }
 
 // [TODO] given a translation vector then output a Matrix4 (Translation Matrix)
-Matrix4 translate(Vector3 vec)
+constexpr Matrix4 translate(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -127,7 +140,7 @@ Matrix4 translate(Vector3 vec)
 }
 
 // [TODO] given a scaling vector then output a Matrix4 (Scaling Matrix)
-Matrix4 scaling(Vector3 vec)
+constexpr Matrix4 scaling(Vector3 vec)
 {
     Matrix4 mat;
 
@@ -196,6 +209,32 @@ Matrix4 rotate(Vector3 vec)
     return rotateX(vec.x) * rotateY(vec.y) * rotateZ(vec.z);
 }
 
+// translate * rotate * scaling written out, one sine and cosine per axis instead of three matrix products
+void UpdateModelMatrix(model &m)
+{
+    if (!m.dirty)
+        return;
+
+    float sx = sinf(m.rotation.x), cx = cosf(m.rotation.x);
+    float sy = sinf(m.rotation.y), cy = cosf(m.rotation.y);
+    float sz = sinf(m.rotation.z), cz = cosf(m.rotation.z);
+    float R[9] = {
+                        cy * cz,                -cy * sz,       sy,
+         sx * sy * cz + cx * sz, -sx * sy * sz + cx * cz, -sx * cy,
+        -cx * sy * cz + sx * sz,  cx * sy * sz + sx * cz,  cx * cy
+    };
+
+    const Vector3 &s = m.scale;
+    const Vector3 &t = m.position;
+    m.matrix.set(
+        R[0] * s.x, R[1] * s.y, R[2] * s.z, t.x,
+        R[3] * s.x, R[4] * s.y, R[5] * s.z, t.y,
+        R[6] * s.x, R[7] * s.y, R[8] * s.z, t.z,
+                 0,          0,          0,   1
+    );
+    m.dirty = false;
+}
+
 // [TODO] compute viewing matrix accroding to the setting of main_camera
 void setViewingMatrix()
 {
@@ -312,19 +351,14 @@ void drawPlane()
 
     /* modify from "RenderScene" */
     Matrix4 MVP;
-    GLfloat mvp[16];
 
     MVP = project_matrix * view_matrix;
 
-    mvp[0] = MVP[0];  mvp[4] = MVP[1];  mvp[8] = MVP[2];   mvp[12] = MVP[3];
-    mvp[1] = MVP[4];  mvp[5] = MVP[5];  mvp[9] = MVP[6];   mvp[13] = MVP[7];
-    mvp[2] = MVP[8];  mvp[6] = MVP[9];  mvp[10] = MVP[10]; mvp[14] = MVP[11];
-    mvp[3] = MVP[12]; mvp[7] = MVP[13]; mvp[11] = MVP[14]; mvp[15] = MVP[15];
-
     /* let plane be solid */
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    glUniformMatrix4fv(iLocMVP, 1, GL_FALSE, mvp);
+    // row-major, GL transposes it on upload
+    glUniformMatrix4fv(iLocMVP, 1, GL_TRUE, MVP.get());
     glBindVertexArray(quad.vao);
     glDrawArrays(GL_TRIANGLES, 0, quad.vertex_count);
 }
@@ -335,23 +369,11 @@ void RenderScene(void)
     // clear canvas
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    Matrix4 T, R, S;
     // [TODO] update translation, rotation and scaling
-    T = translate(models.at(cur_idx).position);
-    R = rotate(models.at(cur_idx).rotation);
-    S = scaling(models.at(cur_idx).scale);
-
-    Matrix4 MVP;
-    GLfloat mvp[16];
+    UpdateModelMatrix(models.at(cur_idx));
 
     // [TODO] multiply all the matrix
-    MVP = project_matrix * view_matrix * T * R * S;
-
-    // [TODO] row-major ---> column-major
-    mvp[0] = MVP[0];  mvp[4] = MVP[1];  mvp[8] = MVP[2];   mvp[12] = MVP[3];
-    mvp[1] = MVP[4];  mvp[5] = MVP[5];  mvp[9] = MVP[6];   mvp[13] = MVP[7];
-    mvp[2] = MVP[8];  mvp[6] = MVP[9];  mvp[10] = MVP[10]; mvp[14] = MVP[11];
-    mvp[3] = MVP[12]; mvp[7] = MVP[13]; mvp[11] = MVP[14]; mvp[15] = MVP[15];
+    Matrix4 MVP = project_matrix * view_matrix * models.at(cur_idx).matrix;
 
     /* let model be solid or be wireframe */
     if (is_wireframe)
@@ -359,10 +381,10 @@ void RenderScene(void)
     else
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    // use uniform to send mvp to vertex shader
-    glUniformMatrix4fv(iLocMVP, 1, GL_FALSE, mvp);
+    // use uniform to send mvp to vertex shader, row-major ---> column-major by GL
+    glUniformMatrix4fv(iLocMVP, 1, GL_TRUE, MVP.get());
     glBindVertexArray(m_shape_list[cur_idx].vao);
-    glDrawArrays(GL_TRIANGLES, 0, m_shape_list[cur_idx].vertex_count);
+    glDrawElements(GL_TRIANGLES, m_shape_list[cur_idx].indexCount, GL_UNSIGNED_INT, 0);
     drawPlane();
 }
 
@@ -433,12 +455,15 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     {
     case TransMode::GeoTranslation:
         models.at(cur_idx).position.z += diff / 10;
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::GeoScaling:
         models.at(cur_idx).scale.z += diff / 10;
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::GeoRotation:
         models.at(cur_idx).rotation.z += degree2radian(diff);
+        models.at(cur_idx).dirty = true;
         break;
     case TransMode::ViewEye:
         main_camera.position.z -= diff / 10;
@@ -481,14 +506,17 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
         case TransMode::GeoTranslation:
             models.at(cur_idx).position.x += diff_x / 100;
             models.at(cur_idx).position.y -= diff_y / 100;
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::GeoScaling:
             models.at(cur_idx).scale.x -= diff_x / 100;
             models.at(cur_idx).scale.y -= diff_y / 100;
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::GeoRotation:
             models.at(cur_idx).rotation.x -= degree2radian(diff_y);
             models.at(cur_idx).rotation.y -= degree2radian(diff_x);
+            models.at(cur_idx).dirty = true;
             break;
         case TransMode::ViewEye:
             main_camera.position.x -= diff_x / 100;
@@ -513,23 +541,16 @@ static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos)
     last_y = ypos;
 }
 
-void setShaders()
+// compile both shaders and link them into p, printing any errors
+static GLint CompileAndLink(GLuint p, const char *vs, const char *fs)
 {
-    GLuint v, f, p;
-    char *vs = NULL;
-    char *fs = NULL;
+    GLuint v, f;
 
     v = glCreateShader(GL_VERTEX_SHADER);
     f = glCreateShader(GL_FRAGMENT_SHADER);
 
-    vs = textFileRead("shader.vs");
-    fs = textFileRead("shader.fs");
-
-    glShaderSource(v, 1, (const GLchar **)&vs, NULL);
-    glShaderSource(f, 1, (const GLchar **)&fs, NULL);
-
-    free(vs);
-    free(fs);
+    glShaderSource(v, 1, &vs, NULL);
+    glShaderSource(f, 1, &fs, NULL);
 
     GLint success;
     char infoLog[1000];
@@ -555,14 +576,12 @@ void setShaders()
                   << infoLog << std::endl;
     }
 
-    // create program object
-    p = glCreateProgram();
-
     // attach shaders to program object
     glAttachShader(p, f);
     glAttachShader(p, v);
 
-    // link program
+    // link program, keeping its binary for the program cache
+    PrepareProgramBinary(p);
     glLinkProgram(p);
     // check for linking errors
     glGetProgramiv(p, GL_LINK_STATUS, &success);
@@ -576,6 +595,34 @@ void setShaders()
     glDeleteShader(v);
     glDeleteShader(f);
 
+    return success;
+}
+
+void setShaders()
+{
+    GLuint p;
+    char *vs = NULL;
+    char *fs = NULL;
+
+    vs = textFileRead("shader.vs");
+    fs = textFileRead("shader.fs");
+
+    // create program object
+    p = glCreateProgram();
+
+    // warm launches link the program from the binary of the last one and skip compiling
+    uint64_t key = ProgramCacheKey(vs, fs);
+    GLint success = LoadProgramBinary("shader.programcache", key, p);
+    if (!success)
+    {
+        success = CompileAndLink(p, vs, fs);
+        if (success)
+            SaveProgramBinary("shader.programcache", key, p);
+    }
+
+    free(vs);
+    free(fs);
+
     iLocMVP = glGetUniformLocation(p, "mvp");
 
     if (success)
@@ -752,7 +799,13 @@ void LoadModels(string model_path)
     string err;
     string warn;
 
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model_path.c_str());
+    tinyobj::ObjReaderConfig reader_config;
+    reader_config.num_threads = 0; // split the parse across all hardware threads
+
+    tinyobj::ObjReader reader;
+    bool ret = reader.ParseFromFile(model_path, reader_config);
+    warn = reader.Warning();
+    err = reader.Error();
 
     if (!warn.empty())
     {
@@ -769,10 +822,27 @@ void LoadModels(string model_path)
         exit(1);
     }
 
+    attrib = reader.TakeAttrib();
+    shapes = reader.TakeShapes();
+    materials = reader.TakeMaterials();
+
     printf("Load Models Success ! Shapes size %d Maerial size %d\n", shapes.size(), materials.size());
 
     normalization(&attrib, vertices, colors, &shapes[0]);
 
+    // merge the duplicated face corners into unique vertices and an index list
+    VertexStream soup[2] = {{vertices.data(), 3}, {colors.data(), 3}};
+    vector<GLfloat> welded[2];
+    vector<uint32_t> indices;
+    WeldVertices(vertices.size() / 3, soup, 2, welded, indices);
+    vertices.swap(welded[0]);
+    colors.swap(welded[1]);
+
+    // reorder the triangles for the vertex cache and then for overdraw
+    float before, after;
+    OptimizeTriangleOrder(indices.data(), indices.size(), vertices.data(), vertices.size() / 3, &before, &after);
+    printf("Optimize Models Success ! ACMR %.3f -> %.3f\n", before, after);
+
     Shape tmp_shape;
     glGenVertexArrays(1, &tmp_shape.vao);
     glBindVertexArray(tmp_shape.vao);
@@ -788,6 +858,11 @@ void LoadModels(string model_path)
     glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GL_FLOAT), &colors.at(0), GL_STATIC_DRAW);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
+    glGenBuffers(1, &tmp_shape.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tmp_shape.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices.at(0), GL_STATIC_DRAW);
+    tmp_shape.indexCount = indices.size();
+
     m_shape_list.push_back(tmp_shape);
     model tmp_model;
     models.push_back(tmp_model);
@@ -826,7 +901,6 @@ void setupRC()
 
     // OpenGL States and Values
     glClearColor(0.2, 0.2, 0.2, 1.0);
-    vector<string> model_list{"../ColorModels/bunny5KC.obj", "../ColorModels/dragon10KC.obj", "../ColorModels/lucy25KC.obj", "../ColorModels/teapot4KC.obj", "../ColorModels/dolphinC.obj"};
     // [TODO] Load five model at here
     for (const auto &model_path : model_list)
         LoadModels(model_path);
@@ -851,8 +925,95 @@ void glPrintContextInfo(bool printExtension)
     }
 }
 
+// benchmark camera path: frame i of n on one orbit around the center, at the distance of start
+void SetBenchmarkCamera(const camera &start, int i, int n)
+{
+    float angle = static_cast<float>(2 * PI * i / n);
+    Vector3 offset = start.position - start.center;
+    main_camera = start;
+    main_camera.position = start.center + Vector3(offset.x * cos(angle) + offset.z * sin(angle), offset.y, offset.z * cos(angle) - offset.x * sin(angle));
+    setViewingMatrix();
+}
+
+// render options.frames frames of every model on the benchmark camera path and write the report,
+// window is NULL when rendering offscreen
+int RunBenchmark(const CommandLineOptions &options, GLFWwindow *window)
+{
+    if (window != NULL)
+        glfwSwapInterval(0); // measure the frames, not the display refresh
+
+    camera start = main_camera;
+    vector<BenchmarkResult> results(models.size());
+    FrameTimer timer;
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        for (int i = -BENCHMARK_WARMUP_FRAMES; i < options.frames; i++)
+        {
+            SetBenchmarkCamera(start, i, options.frames);
+            if (i >= 0)
+                timer.begin();
+
+            RenderScene();
+            if (window != NULL)
+            {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            else
+            {
+                glFlush();
+            }
+
+            if (i >= 0)
+                timer.end();
+        }
+        results[cur_idx].model = model_list[cur_idx];
+        timer.finish(results[cur_idx]);
+    }
+
+    main_camera = start;
+    setViewingMatrix();
+    cur_idx = 0;
+    return WriteBenchmarkReport(options.report, "HW1", options.frames, results) ? 0 : -1;
+}
+
+// render every model once into an image file, without any window
+int RenderHeadless(const CommandLineOptions &options)
+{
+    OffscreenContext context;
+    if (!context.create(options.backend, options.width, options.height))
+        return -1;
+
+    glEnable(GL_DEPTH_TEST);
+    setupRC();
+    ChangeSize(NULL, context.width(), context.height());
+    if (options.benchmark)
+        return RunBenchmark(options, NULL);
+
+    for (cur_idx = 0; cur_idx < static_cast<int>(models.size()); cur_idx++)
+    {
+        RenderScene();
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s_%03d.ppm", options.output.c_str(), cur_idx);
+        if (!context.writeImage(path))
+            return -1;
+        cout << "Headless: wrote " << path << endl;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
+    CommandLineOptions options;
+    options.width = WINDOW_WIDTH;
+    options.height = WINDOW_HEIGHT;
+    // none of the CommandLineOption ones apply to HW1
+    if (!ParseCommandLine(argc, argv, options, 0))
+        return -1;
+    if (options.headless)
+        return RenderHeadless(options);
+
     // initial glfw
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -891,6 +1052,9 @@ int main(int argc, char **argv)
     // Setup render context
     setupRC();
 
+    if (options.benchmark)
+        return RunBenchmark(options, window);
+
     // main loop
     while (!glfwWindowShouldClose(window))
     {